@@ -0,0 +1,67 @@
+#pragma once
+
+// Timing helpers for the benchmark harness. Every benchmark, including the
+// app's render benchmark, reports through printTimings() so the numbers are
+// directly comparable between runs and between changes.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+struct TimingStats
+{
+    size_t samples = 0;
+    double total = 0.0;     // seconds
+    double mean = 0.0;
+    double median = 0.0;
+    double p99 = 0.0;
+    double worst = 0.0;
+};
+
+inline double benchmarkClock()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline TimingStats summarizeTimings(std::vector<double> seconds)
+{
+    TimingStats stats;
+    if (seconds.empty())
+        return stats;
+    std::sort(seconds.begin(), seconds.end());
+    stats.samples = seconds.size();
+    for (double s : seconds)
+        stats.total += s;
+    stats.mean = stats.total / seconds.size();
+    stats.median = seconds[seconds.size() / 2];
+    stats.p99 = seconds[std::min(seconds.size() - 1, seconds.size() * 99 / 100)];
+    stats.worst = seconds.back();
+    return stats;
+}
+
+// Calls body iterations times and times each call separately
+template <typename Body>
+inline TimingStats timeIterations(int iterations, Body body)
+{
+    std::vector<double> seconds;
+    seconds.reserve(iterations);
+    for (int i = 0; i < iterations; ++i)
+    {
+        double start = benchmarkClock();
+        body(i);
+        seconds.push_back(benchmarkClock() - start);
+    }
+    return summarizeTimings(seconds);
+}
+
+// One line per benchmark. With work > 0 it also prints the throughput, work
+// being how many units (steps, rays, pixels...) one iteration processes.
+inline void printTimings(const char* name, const TimingStats& stats, double work = 0.0, const char* unit = "")
+{
+    printf("%-16s %5zu x  mean %9.3f ms  median %9.3f ms  p99 %9.3f ms  max %9.3f ms",
+        name, stats.samples, stats.mean * 1e3, stats.median * 1e3, stats.p99 * 1e3, stats.worst * 1e3);
+    if (work > 0.0 && stats.mean > 0.0)
+        printf("  %9.2f M %s/s", work / stats.mean * 1e-6, unit);
+    printf("\n");
+}
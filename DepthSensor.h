@@ -0,0 +1,132 @@
+#pragma once
+
+// Depth image linearisation and point-cloud unprojection for the head camera.
+// No GL in here: the sensor hands over raw depth-buffer values read back from
+// the GPU and these kernels turn them into metric depth and robot-frame
+// points. Both work on row ranges so they can be split across the JobSystem,
+// and process four pixels at a time with SSE.
+
+#include "RobotWorld.h"
+#include "SimMath.h"
+
+#include <cmath>
+#include <limits>
+
+// Pinhole model of the head camera, with its pose in the robot frame
+struct DepthCameraModel
+{
+    int width, height;
+    float nearPlane, farPlane;
+    float fx, fy, cx, cy;
+    Vec3 position;              // camera origin in the robot frame
+    Vec3 right, up, forward;    // camera axes in the robot frame
+};
+
+// Same pose as computeHeadCamera(), but relative to the robot body rather than
+// the world so mapping doesn't have to undo the robot's motion
+inline DepthCameraModel makeDepthCameraModel(const World& world, int width, int height, float fovY, float nearPlane, float farPlane)
+{
+    DepthCameraModel model;
+    model.width = width;
+    model.height = height;
+    model.nearPlane = nearPlane;
+    model.farPlane = farPlane;
+    model.fy = 0.5f * height / std::tan(toRadians(fovY) * 0.5f);
+    model.fx = model.fy;
+    model.cx = 0.5f * width;
+    model.cy = 0.5f * height;
+
+    float yaw = toRadians(world.headCamYaw), pitch = toRadians(world.headCamPitch);
+    model.position = vec3(world.secCamX, world.secCamY, world.secCamZ);
+    model.forward = vec3(std::sin(yaw) * std::cos(pitch), std::sin(pitch), -std::cos(yaw) * std::cos(pitch));
+    model.right = normalize(cross(model.forward, vec3(0.0f, 1.0f, 0.0f)));
+    model.up = cross(model.right, model.forward);
+    return model;
+}
+
+// Converts depth-buffer values in [0, 1] to distance along the view axis.
+// For a standard perspective projection that's n * f / (f - d * (f - n)).
+// Background pixels (d == 1) become NaN. raw is bottom-up as glReadPixels
+// returns it, linear is written top-down.
+inline void linearizeDepthRows(const DepthCameraModel& model, const float* raw, float* linear, int rowBegin, int rowEnd)
+{
+    const float n = model.nearPlane, f = model.farPlane;
+    const float numerator = n * f, range = f - n;
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+
+    for (int y = rowBegin; y < rowEnd; ++y)
+    {
+        const float* src = raw + (size_t)(model.height - 1 - y) * model.width;
+        float* dst = linear + (size_t)y * model.width;
+        int x = 0;
+#ifdef ROBOT_SIMD_SSE
+        const __m128 vNumerator = _mm_set1_ps(numerator), vRange = _mm_set1_ps(range), vFar = _mm_set1_ps(f);
+        const __m128 vOne = _mm_set1_ps(1.0f), vNan = _mm_set1_ps(nan);
+        for (; x + 4 <= model.width; x += 4)
+        {
+            __m128 d = _mm_loadu_ps(src + x);
+            __m128 z = _mm_div_ps(vNumerator, _mm_sub_ps(vFar, _mm_mul_ps(d, vRange)));
+            __m128 background = _mm_cmpge_ps(d, vOne);
+            _mm_storeu_ps(dst + x, _mm_or_ps(_mm_and_ps(background, vNan), _mm_andnot_ps(background, z)));
+        }
+#endif
+        for (; x < model.width; ++x)
+            dst[x] = src[x] >= 1.0f ? nan : numerator / (f - src[x] * range);
+    }
+}
+
+// Unprojects top-down linear depth into robot-frame points, three floats per
+// pixel. Pixels without depth become NaN points.
+inline void unprojectDepthRows(const DepthCameraModel& model, const float* linear, float* points, int rowBegin, int rowEnd)
+{
+    const float invFx = 1.0f / model.fx, invFy = 1.0f / model.fy;
+
+    for (int y = rowBegin; y < rowEnd; ++y)
+    {
+        const float* depth = linear + (size_t)y * model.width;
+        float* out = points + (size_t)y * model.width * 3;
+
+        // Image rows run downwards, camera up runs upwards
+        float cameraY = (model.cy - (y + 0.5f)) * invFy;
+        Vec3 rowBase = model.forward + model.up * cameraY;
+
+        int x = 0;
+#ifdef ROBOT_SIMD_SSE
+        const __m128 baseX = _mm_set1_ps(rowBase.x), baseY = _mm_set1_ps(rowBase.y), baseZ = _mm_set1_ps(rowBase.z);
+        const __m128 rightX = _mm_set1_ps(model.right.x), rightY = _mm_set1_ps(model.right.y), rightZ = _mm_set1_ps(model.right.z);
+        const __m128 posX = _mm_set1_ps(model.position.x), posY = _mm_set1_ps(model.position.y), posZ = _mm_set1_ps(model.position.z);
+        const __m128 step = _mm_set1_ps(4.0f * invFx);
+        __m128 cameraX = _mm_mul_ps(_mm_sub_ps(_mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f), _mm_set1_ps(model.cx)), _mm_set1_ps(invFx));
+        for (; x + 4 <= model.width; x += 4)
+        {
+            __m128 z = _mm_loadu_ps(depth + x);
+            __m128 px = _mm_add_ps(posX, _mm_mul_ps(z, _mm_add_ps(baseX, _mm_mul_ps(rightX, cameraX))));
+            __m128 py = _mm_add_ps(posY, _mm_mul_ps(z, _mm_add_ps(baseY, _mm_mul_ps(rightY, cameraX))));
+            __m128 pz = _mm_add_ps(posZ, _mm_mul_ps(z, _mm_add_ps(baseZ, _mm_mul_ps(rightZ, cameraX))));
+
+            // Transpose the SoA lanes into interleaved xyz triples
+            alignas(16) float lx[4], ly[4], lz[4];
+            _mm_store_ps(lx, px);
+            _mm_store_ps(ly, py);
+            _mm_store_ps(lz, pz);
+            float* o = out + (size_t)x * 3;
+            for (int i = 0; i < 4; ++i)
+            {
+                o[i * 3 + 0] = lx[i];
+                o[i * 3 + 1] = ly[i];
+                o[i * 3 + 2] = lz[i];
+            }
+            cameraX = _mm_add_ps(cameraX, step);
+        }
+#endif
+        for (; x < model.width; ++x)
+        {
+            float cameraX = (x + 0.5f - model.cx) * invFx;
+            Vec3 p = model.position + (rowBase + model.right * cameraX) * depth[x];
+            float* o = out + (size_t)x * 3;
+            o[0] = p.x;
+            o[1] = p.y;
+            o[2] = p.z;
+        }
+    }
+}
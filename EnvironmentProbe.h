@@ -0,0 +1,117 @@
+#pragma once
+
+// Dynamic environment cubemap seen from one point of the scene, for
+// reflective objects. Each update re-renders a single face at low
+// resolution, so a full refresh is spread over six frames and moving objects
+// nearby show up in the reflection for a fraction of the cost of drawing all
+// six faces every frame. The face rate can be capped further.
+
+#include <GL/glew.h>
+
+#include <functional>
+
+class EnvironmentProbe
+{
+public:
+    bool init(int faceSize)
+    {
+        shutdown();
+        size = faceSize;
+
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+        for (int face = 0; face < 6; ++face)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, texture, 0);
+
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        if (!complete)
+        {
+            shutdown();
+            return false;
+        }
+
+        nextFace = 0;
+        facesRendered = 0;
+        lastUpdate = -1e9;
+        return true;
+    }
+
+    void shutdown()
+    {
+        if (fbo == 0)
+            return;
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        glDeleteTextures(1, &texture);
+        fbo = depthBuffer = texture = 0;
+    }
+
+    bool isActive() const { return fbo != 0; }
+
+    // Every face has been rendered at least once
+    bool ready() const { return isActive() && facesRendered >= 6; }
+
+    // View direction and up vector of a face in GL's order (+X, -X, +Y, -Y,
+    // +Z, -Z), chosen so the rendered image lands in the face the right way up
+    static void faceBasis(int face, float direction[3], float up[3])
+    {
+        static const float kDirections[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+        static const float kUps[6][3] = { { 0, -1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 0, -1, 0 }, { 0, -1, 0 } };
+        for (int i = 0; i < 3; ++i)
+        {
+            direction[i] = kDirections[face][i];
+            up[i] = kUps[face][i];
+        }
+    }
+
+    // A rate of zero or less renders a face every frame; so does a probe
+    // that isn't ready() yet
+    bool due(double now) const { return isActive() && (rate <= 0.0f || !ready() || now - lastUpdate >= 1.0 / rate); }
+
+    // Renders the next face in turn. drawFace gets the face index and a
+    // cleared square viewport, and sets up its own 90 degree view.
+    void update(double now, const std::function<void(int face)>& drawFace)
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + nextFace, texture, 0);
+        glViewport(0, 0, size, size);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawFace(nextFace);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        nextFace = (nextFace + 1) % 6;
+        ++facesRendered;
+        lastUpdate = now;
+    }
+
+    GLuint texture = 0;
+    int size = 0;
+    float rate = 0.0f;      // faces per second
+    unsigned long long facesRendered = 0;
+
+private:
+    GLuint fbo = 0, depthBuffer = 0;
+    int nextFace = 0;
+    double lastUpdate = -1e9;
+};
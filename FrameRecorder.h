@@ -0,0 +1,110 @@
+#pragma once
+
+// Main-view recorder.
+// Reads the finished frame back from the window every frame (or every Nth)
+// into a ring of pixel buffer objects. A frame's PBO is only mapped when
+// the ring comes back round to it, by which time the copy has long landed, so
+// the render loop never waits on the GPU. The pixels then go to a
+// VideoEncoder, which converts and writes them on its own thread, so the
+// render loop never waits on the disk either.
+
+#include <GL/glew.h>
+
+#include "VideoEncoder.h"
+
+class FrameRecorder
+{
+public:
+    // Every interval-th frame of a display running at fps is recorded. The
+    // rate only goes into the file header.
+    bool start(const char* path, int frameWidth, int frameHeight, int frameInterval, int fps)
+    {
+        stop();
+        interval = frameInterval > 0 ? frameInterval : 1;
+        if (!encoder.open(path, frameWidth, frameHeight, fps, interval))
+            return false;
+
+        width = frameWidth;
+        height = frameHeight;
+        frameCounter = 0;
+
+        glGenBuffers(kPboCount, pbo);
+        for (int i = 0; i < kPboCount; ++i)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, NULL, GL_STREAM_READ);
+            pending[i] = false;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        current = 0;
+        return true;
+    }
+
+    // Hands the frames still in flight to the encoder and closes the file
+    void stop()
+    {
+        if (pbo[0] == 0)
+            return;
+        for (int i = 1; i <= kPboCount; ++i)
+            submitPending((current + i) % kPboCount);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glDeleteBuffers(kPboCount, pbo);
+        for (int i = 0; i < kPboCount; ++i)
+            pbo[i] = 0;
+        encoder.close();
+    }
+
+    bool isRecording() const { return pbo[0] != 0; }
+
+    // Call after the frame is drawn and before the buffers are swapped.
+    // Returns false if the window no longer matches the video size, in which
+    // case the caller should stop().
+    bool capture(int windowWidth, int windowHeight)
+    {
+        if (windowWidth != width || windowHeight != height)
+            return false;
+        if (frameCounter++ % interval != 0)
+            return true;
+
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadBuffer(GL_BACK);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[current]);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        pending[current] = true;
+
+        // The next PBO in the ring is the oldest one, queued kPboCount - 1 captures ago
+        current = (current + 1) % kPboCount;
+        submitPending(current);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return true;
+    }
+
+    uint64_t framesWritten() const { return encoder.framesWritten; }
+    uint64_t framesDropped() const { return encoder.framesDropped; }
+
+    int width = 0, height = 0;
+    int interval = 1;
+
+private:
+    static const int kPboCount = 3;
+
+    void submitPending(int index)
+    {
+        if (!pending[index])
+            return;
+        pending[index] = false;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[index]);
+        const uint8_t* pixels = (const uint8_t*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+        if (pixels == NULL)
+            return;
+        encoder.submit(pixels);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+
+    VideoEncoder encoder;
+    GLuint pbo[kPboCount] = { 0, 0, 0 };
+    bool pending[kPboCount] = { false, false, false };
+    int current = 0;
+    uint64_t frameCounter = 0;
+};
@@ -0,0 +1,227 @@
+#pragma once
+
+// Head-camera sensor stream.
+// Renders the head camera into its own offscreen framebuffer at a fixed
+// sensor resolution and rate, reads it back asynchronously through pairs of
+// pixel buffer objects and publishes the frames into SharedFrameRings that
+// other local processes can map:
+//   <name>         RGBA8 colour, top-down
+//   <name>_depth   float metres along the view axis, NaN for background
+//   <name>_points  float xyz per pixel in the robot frame, NaN for background
+//
+// Readback is pipelined one capture deep: the glReadPixels issued for
+// capture N only lands in its PBO, and is mapped and published when capture
+// N + 1 is taken, by which time the GPU has long finished the copy. Depth
+// linearisation and unprojection run on the shared JobSystem straight from the
+// mapped PBO into the ring slots.
+
+#include <GL/glew.h>
+
+#include "DepthSensor.h"
+#include "SharedFrameRing.h"
+#include "JobSystem.h"
+
+#include <functional>
+#include <string>
+
+class HeadCameraSensor
+{
+public:
+    // GL objects die with the context, only the shared memory needs cleaning
+    // up if the process exits without calling shutdown()
+    ~HeadCameraSensor()
+    {
+        colorRing.destroy();
+        depthRing.destroy();
+        pointRing.destroy();
+    }
+
+    bool init(int sensorWidth, int sensorHeight, float sensorRate, const char* ringName, bool withDepth, bool withPoints, int ringSlots = 4)
+    {
+        shutdown();
+        width = sensorWidth;
+        height = sensorHeight;
+        rate = sensorRate;
+        depthEnabled = withDepth || withPoints;
+        pointsEnabled = withPoints;
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+        glGenRenderbuffers(1, &colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        if (!complete)
+        {
+            shutdown();
+            return false;
+        }
+
+        glGenBuffers(2, colorPbo);
+        glGenBuffers(2, depthPbo);
+        for (int i = 0; i < 2; ++i)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, colorPbo[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, NULL, GL_STREAM_READ);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, depthPbo[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, depthEnabled ? (GLsizeiptr)width * height * sizeof(float) : 0, NULL, GL_STREAM_READ);
+            pending[i] = false;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        current = 0;
+        lastCapture = -1e9;
+
+        std::string name = ringName;
+        bool ringsOk = colorRing.create(name.c_str(), width, height, 4, ringSlots);
+        if (ringsOk && depthEnabled)
+            ringsOk = depthRing.create((name + "_depth").c_str(), width, height, sizeof(float), ringSlots);
+        if (ringsOk && pointsEnabled)
+            ringsOk = pointRing.create((name + "_points").c_str(), width, height, 3 * sizeof(float), ringSlots);
+        if (!ringsOk)
+        {
+            shutdown();
+            return false;
+        }
+        return true;
+    }
+
+    void shutdown()
+    {
+        if (fbo != 0)
+        {
+            glDeleteFramebuffers(1, &fbo);
+            glDeleteRenderbuffers(1, &colorBuffer);
+            glDeleteRenderbuffers(1, &depthBuffer);
+            fbo = colorBuffer = depthBuffer = 0;
+        }
+        if (colorPbo[0] != 0)
+        {
+            glDeleteBuffers(2, colorPbo);
+            glDeleteBuffers(2, depthPbo);
+            colorPbo[0] = colorPbo[1] = depthPbo[0] = depthPbo[1] = 0;
+        }
+        colorRing.destroy();
+        depthRing.destroy();
+        pointRing.destroy();
+    }
+
+    bool isActive() const { return fbo != 0 && colorRing.isOpen(); }
+
+    bool due(double now) const { return isActive() && now - lastCapture >= 1.0 / rate; }
+
+    // Renders one sensor frame with drawView into the offscreen target and
+    // publishes the frame captured on the previous call. model describes the
+    // camera for this capture and is kept with it until it's published.
+    void capture(double now, const DepthCameraModel& model, const std::function<void()>& drawView)
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, width, height);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawView();
+
+        // Queue the copies into this capture's PBOs, the calls return immediately
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, colorPbo[current]);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        if (depthEnabled)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, depthPbo[current]);
+            glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+        }
+        pending[current] = true;
+        captureTime[current] = now;
+        captureModel[current] = model;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+        // Publish the previous capture, whose copy has had a whole frame to land
+        int previous = current ^ 1;
+        if (pending[previous])
+        {
+            publishColor(previous);
+            if (depthEnabled)
+                publishDepth(previous);
+            pending[previous] = false;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        current = previous;
+        lastCapture = now;
+    }
+
+    uint64_t framesPublished() const { return colorRing.framesWritten(); }
+
+    int width = 0, height = 0;
+    float rate = 30.0f;
+    float fovY = 45.0f;
+    float nearPlane = 0.1f, farPlane = 100.0f;  // depth range of the sensor
+    bool depthEnabled = false, pointsEnabled = false;
+
+private:
+    // Copies a mapped PBO straight into the next ring slot, flipping rows so
+    // consumers get a top-down image
+    void publishColor(int index)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, colorPbo[index]);
+        const uint8_t* pixels = (const uint8_t*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+        if (pixels == NULL)
+            return;
+
+        size_t rowBytes = (size_t)width * 4;
+        uint8_t* slot = colorRing.beginWrite();
+        for (int y = 0; y < height; ++y)
+            std::memcpy(slot + (size_t)y * rowBytes, pixels + (size_t)(height - 1 - y) * rowBytes, rowBytes);
+        colorRing.endWrite(captureTime[index]);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+
+    // Linearises the depth straight out of the mapped PBO into the depth ring
+    // and, when enabled, unprojects that into the point ring
+    void publishDepth(int index)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, depthPbo[index]);
+        const float* raw = (const float*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+        if (raw == NULL)
+            return;
+
+        const DepthCameraModel& model = captureModel[index];
+        float* depth = (float*)depthRing.beginWrite();
+        float* points = pointsEnabled ? (float*)pointRing.beginWrite() : NULL;
+
+        JobSystem::shared().parallelFor((size_t)height, [&](size_t begin, size_t end)
+        {
+            linearizeDepthRows(model, raw, depth, (int)begin, (int)end);
+            if (points != NULL)
+                unprojectDepthRows(model, depth, points, (int)begin, (int)end);
+        }, 1);
+
+        depthRing.endWrite(captureTime[index]);
+        if (points != NULL)
+            pointRing.endWrite(captureTime[index]);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+
+    GLuint fbo = 0, colorBuffer = 0, depthBuffer = 0;
+    GLuint colorPbo[2] = { 0, 0 };
+    GLuint depthPbo[2] = { 0, 0 };
+    bool pending[2] = { false, false };
+    double captureTime[2] = { 0.0, 0.0 };
+    DepthCameraModel captureModel[2];
+    int current = 0;
+    double lastCapture = -1e9;
+    SharedFrameWriter colorRing, depthRing, pointRing;
+};
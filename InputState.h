@@ -0,0 +1,128 @@
+#pragma once
+
+// Input gathered between simulation ticks.
+// GLUT delivers input as events; these classes only record them, and the
+// simulation samples the result once per tick, so movement no longer depends
+// on the OS key-repeat rate and a fast mouse can't flood the loop with work.
+// Events arrive on GLUT's thread and ticks run on the simulation's, so the
+// recorded state is atomic. LatencyTracker times how long an input takes to
+// reach the screen, from the event to the buffer swap of the first frame
+// that includes it; it lives on GLUT's thread.
+
+#include "RobotSim.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+
+// Seconds on a monotonic clock, for timestamping input
+inline double inputClock()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class KeyboardState
+{
+public:
+    // Returns true if the key is a movement key
+    bool keyDown(unsigned char key)
+    {
+        unsigned bit = moveBit(key);
+        held |= bit;
+        return bit != 0;
+    }
+
+    bool keyUp(unsigned char key)
+    {
+        unsigned bit = moveBit(key);
+        held &= ~bit;
+        return bit != 0;
+    }
+
+    // Movement keys currently held, as MoveInput bits
+    unsigned sample() const { return held.load(std::memory_order_relaxed); }
+
+private:
+    static unsigned moveBit(unsigned char key)
+    {
+        Direction direction;
+        return keyToDirection((unsigned char)std::tolower(key), direction) ? 1u << direction : 0u;
+    }
+
+    std::atomic<unsigned> held{ 0 };
+};
+
+// Mouse motion summed between ticks. Events only add to the running offset;
+// the tick takes the total once and applies it, however many events arrived.
+class MouseDelta
+{
+public:
+    void moved(int x, int y)
+    {
+        if (tracking)
+        {
+            dx += x - lastX;
+            dy += lastY - y;
+        }
+        lastX = x;
+        lastY = y;
+        tracking = true;
+    }
+
+    // Pixels moved since the last call, +y up. Returns false if none.
+    bool take(float& x, float& y)
+    {
+        x = (float)dx.exchange(0);
+        y = (float)dy.exchange(0);
+        return x != 0.0f || y != 0.0f;
+    }
+
+private:
+    bool tracking = false;
+    int lastX = 0, lastY = 0;       // event thread only
+    std::atomic<int> dx{ 0 }, dy{ 0 };
+};
+
+class LatencyTracker
+{
+public:
+    // An input event arrived; only the oldest one not yet sampled is timed
+    void eventArrived(double time)
+    {
+        if (pending < 0.0)
+            pending = time;
+    }
+
+    // A simulation tick that sampled the input at time has reached the
+    // renderer; events up to then are in it
+    void sampled(double time)
+    {
+        if (pending >= 0.0 && pending <= time && inFlight < 0.0)
+        {
+            inFlight = pending;
+            pending = -1.0;
+        }
+    }
+
+    // A frame showing the sampled state has been handed to the display
+    void presented(double time)
+    {
+        if (inFlight < 0.0)
+            return;
+        last = time - inFlight;
+        average = samples == 0 ? last : average + (last - average) * 0.1;
+        worst = std::max(worst, last);
+        ++samples;
+        inFlight = -1.0;
+    }
+
+    double last = 0.0;      // seconds
+    double average = 0.0;   // exponential moving average
+    double worst = 0.0;
+    unsigned long long samples = 0;
+
+private:
+    double pending = -1.0;
+    double inFlight = -1.0;
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+// Picture-in-picture inset.
+// Renders a second view of the scene into its own offscreen framebuffer at
+// a reduced resolution, and at most `rate` times per second. Every frame the
+// last rendered image is scaled into a corner of the window with a single
+// framebuffer blit, so frames where the inset isn't due cost next to nothing.
+// The main view uses one too when it renders below the window's resolution.
+
+#include <GL/glew.h>
+
+#include <functional>
+
+class InsetView
+{
+public:
+    bool init(int viewWidth, int viewHeight, float viewRate)
+    {
+        shutdown();
+        width = viewWidth;
+        height = viewHeight;
+        rate = viewRate;
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+        glGenRenderbuffers(1, &colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+
+        // Stencil as well, the reflection pass marks the floor with it
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        if (!complete)
+        {
+            shutdown();
+            return false;
+        }
+
+        lastRender = -1e9;
+        rendered = false;
+        return true;
+    }
+
+    void shutdown()
+    {
+        if (fbo == 0)
+            return;
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        fbo = colorBuffer = depthBuffer = 0;
+    }
+
+    bool isActive() const { return fbo != 0; }
+
+    // A rate of zero or less re-renders every frame
+    bool due(double now) const { return isActive() && (rate <= 0.0f || now - lastRender >= 1.0 / rate); }
+
+    // Renders the inset with drawView into the offscreen target
+    void render(double now, const std::function<void()>& drawView)
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, width, height);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        drawView();
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        lastRender = now;
+        rendered = true;
+        ++framesRendered;
+    }
+
+    // Scales the last rendered image into the given window rectangle
+    // (bottom-left origin), with a thin border around it unless it fills the
+    // window
+    void present(int x, int y, int presentWidth, int presentHeight, bool border = true)
+    {
+        if (!rendered)
+            return;
+
+        if (border)
+        {
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(x - 2, y - 2, presentWidth + 4, presentHeight + 4);
+            glClearColor(0.8f, 0.8f, 0.8f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glDisable(GL_SCISSOR_TEST);
+        }
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, width, height, x, y, x + presentWidth, y + presentHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    int width = 0, height = 0;
+    float rate = 15.0f;
+    unsigned long long framesRendered = 0;
+
+private:
+    GLuint fbo = 0, colorBuffer = 0, depthBuffer = 0;
+    double lastRender = -1e9;
+    bool rendered = false;
+};
@@ -0,0 +1,405 @@
+#pragma once
+
+// Work-stealing job system shared by every CPU-side subsystem, so the
+// sensors, the software rasterizer, the path tracer, the lightmap baker and
+// the batch stepper all run on one set of worker threads instead of each
+// starting a thread per core. Every worker has its own deque: it pushes and
+// pops jobs at the back, and when that runs dry it steals from the front of
+// another worker's. Jobs signal a JobCounter when they finish, a job can be
+// held back until a counter reaches zero, and a worker that waits on a
+// counter runs other jobs in the meantime. Long-running jobs go on a
+// separate queue that only idle workers take from, so a wait never picks up
+// a whole bake. Each worker keeps its busy time, for utilisation().
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts unfinished jobs. Wait on it with JobSystem::wait(); it may be reused
+// once it's back at zero.
+class JobCounter
+{
+public:
+    JobCounter() {}
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool done() const { return pending.load() == 0; }
+
+private:
+    friend class JobSystem;
+
+    struct Job
+    {
+        std::function<void()> func;
+        JobCounter* counter;
+    };
+
+    std::atomic<int> pending{ 0 };
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::vector<Job> continuations;     // held back until pending reaches zero
+};
+
+class JobSystem
+{
+public:
+    typedef std::function<void()> JobFunc;
+    typedef std::function<void(size_t begin, size_t end)> RangeFunc;
+
+    struct WorkerStats
+    {
+        double busySeconds;
+        unsigned long long jobs;        // run by this worker, nested ones included
+        unsigned long long steals;      // taken from another worker's deque
+    };
+
+    // workerCount 0 picks cores - 1, but there is always at least one worker
+    // so background jobs have somewhere to run
+    explicit JobSystem(unsigned workerCount = 0)
+    {
+        if (workerCount == 0)
+        {
+            unsigned cores = std::thread::hardware_concurrency();
+            workerCount = cores > 1 ? cores - 1 : 1;
+        }
+        for (unsigned i = 0; i < workerCount; ++i)
+            workers.emplace_back(new Worker());
+        for (unsigned i = 0; i < workerCount; ++i)
+            workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+        sampleTime = Clock::now();
+        sampleBusy.assign(workerCount, 0);
+    }
+
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            quit = true;
+        }
+        wake.notify_all();
+        for (std::unique_ptr<Worker>& worker : workers)
+            worker->thread.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // The instance every subsystem schedules on. It is never destroyed, so
+    // destructors that run at exit can still stop their jobs.
+    static JobSystem& shared()
+    {
+        static JobSystem* instance = new JobSystem();
+        return *instance;
+    }
+
+    unsigned workerCount() const { return (unsigned)workers.size(); }
+
+    // Threads a parallelFor runs on: the workers and the caller
+    unsigned threadCount() const { return workerCount() + 1; }
+
+    // Queues func. counter, if given, counts it until it has finished.
+    void run(JobFunc func, JobCounter* counter = NULL)
+    {
+        if (counter)
+            ++counter->pending;
+        push(JobCounter::Job{ std::move(func), counter });
+    }
+
+    // Queues func once dependency reaches zero; counter counts it from now
+    void runAfter(JobCounter& dependency, JobFunc func, JobCounter* counter = NULL)
+    {
+        if (counter)
+            ++counter->pending;
+        JobCounter::Job job{ std::move(func), counter };
+        {
+            std::lock_guard<std::mutex> lock(dependency.mutex);
+            if (dependency.pending.load() != 0)
+            {
+                dependency.continuations.push_back(std::move(job));
+                return;
+            }
+        }
+        push(std::move(job));
+    }
+
+    // Queues a job that runs for a long time, like a bake or a progressive
+    // render. Only idle workers start these, never one that is waiting.
+    void runBackground(JobFunc func, JobCounter* counter = NULL)
+    {
+        if (counter)
+            ++counter->pending;
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            background.push_back(JobCounter::Job{ std::move(func), counter });
+        }
+        wake.notify_one();
+    }
+
+    // Returns once counter is at zero. A worker runs queued jobs while it
+    // waits; any other thread sleeps.
+    void wait(JobCounter& counter)
+    {
+        int self = currentWorker();
+        while (counter.pending.load() != 0)
+        {
+            if (self < 0)
+            {
+                std::unique_lock<std::mutex> lock(counter.mutex);
+                counter.finished.wait(lock, [&] { return counter.pending.load() == 0; });
+                return;
+            }
+            JobCounter::Job job;
+            if (take(self, job))
+                execute(job, *workers[self]);
+            else
+                std::this_thread::yield();
+        }
+        // The last job out drops the counter to zero under the lock; take it
+        // once so that job is done with the counter before the caller is
+        std::lock_guard<std::mutex> lock(counter.mutex);
+    }
+
+    // Runs func over [0, count) and returns once all of it has run. The range
+    // is cut into a few chunks per thread, rounded to multiples of grain so
+    // threads never write to the same cache line of a tightly packed output
+    // array. Chunks are handed out from one counter; the caller takes them
+    // too, and helper jobs that start after the last one is taken just end.
+    void parallelFor(size_t count, const RangeFunc& func, size_t grain = 16)
+    {
+        if (count == 0)
+            return;
+        grain = std::max<size_t>(grain, 1);
+        size_t chunkSize = grain;
+        size_t chunks = (count + grain - 1) / grain;
+        size_t most = (size_t)threadCount() * kChunksPerThread;
+        if (chunks > most)
+        {
+            chunkSize = ((count + most - 1) / most + grain - 1) / grain * grain;
+            chunks = (count + chunkSize - 1) / chunkSize;
+        }
+        if (chunks == 1)
+        {
+            func(0, count);
+            return;
+        }
+
+        // Shared with the helpers, which may outlive this call
+        std::shared_ptr<Loop> loop = std::make_shared<Loop>();
+        loop->func = &func;
+        loop->count = count;
+        loop->chunkSize = chunkSize;
+        loop->chunks = chunks;
+        size_t helpers = std::min(chunks - 1, workers.size());
+        for (size_t i = 0; i < helpers; ++i)
+            run([this, loop]()
+            {
+                ++loop->active.pending;
+                loop->work();
+                finish(&loop->active);
+            });
+
+        loop->work();
+        wait(loop->active);
+    }
+
+    // Totals since the system started
+    void stats(std::vector<WorkerStats>& out) const
+    {
+        out.resize(workers.size());
+        for (size_t i = 0; i < workers.size(); ++i)
+        {
+            const Worker& worker = *workers[i];
+            out[i].busySeconds = worker.busyNanoseconds.load() * 1e-9;
+            out[i].jobs = worker.jobs.load();
+            out[i].steals = worker.steals.load();
+        }
+    }
+
+    // Fraction of the time since the last call each worker spent running
+    // jobs. Call it from one thread, e.g. once a frame.
+    void utilisation(std::vector<float>& out)
+    {
+        Clock::time_point now = Clock::now();
+        double elapsed = std::chrono::duration<double, std::nano>(now - sampleTime).count();
+        sampleTime = now;
+        out.resize(workers.size());
+        for (size_t i = 0; i < workers.size(); ++i)
+        {
+            unsigned long long busy = workers[i]->busyNanoseconds.load();
+            out[i] = elapsed > 0.0 ? std::min((float)((busy - sampleBusy[i]) / elapsed), 1.0f) : 0.0f;
+            sampleBusy[i] = busy;
+        }
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    static constexpr size_t kChunksPerThread = 4;
+
+    struct alignas(64) Worker
+    {
+        std::thread thread;
+        std::mutex mutex;
+        std::deque<JobCounter::Job> queue;
+        std::atomic<unsigned long long> busyNanoseconds{ 0 };
+        std::atomic<unsigned long long> jobs{ 0 }, steals{ 0 };
+    };
+
+    struct Loop
+    {
+        const RangeFunc* func = NULL;
+        size_t count = 0, chunkSize = 0, chunks = 0;
+        std::atomic<size_t> next{ 0 };
+        JobCounter active;      // helpers inside work()
+
+        void work()
+        {
+            for (size_t chunk = next++; chunk < chunks; chunk = next++)
+                (*func)(chunk * chunkSize, std::min((chunk + 1) * chunkSize, count));
+        }
+    };
+
+    // Index of the calling thread if it's one of this system's workers, else -1
+    int currentWorker() const
+    {
+        return current.system == this ? current.index : -1;
+    }
+
+    void push(JobCounter::Job job)
+    {
+        int self = currentWorker();
+        size_t target = self >= 0 ? (size_t)self : nextQueue++ % workers.size();
+        {
+            std::lock_guard<std::mutex> lock(workers[target]->mutex);
+            workers[target]->queue.push_back(std::move(job));
+        }
+        ++queued;
+        // A worker about to sleep counts itself in sleepers before checking
+        // queued, so either it sees the job or this sees it and wakes it
+        if (sleepers.load() > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+            }
+            wake.notify_one();
+        }
+    }
+
+    // The newest job of our own deque, else the oldest of someone else's
+    bool take(int self, JobCounter::Job& job)
+    {
+        if (queued.load() == 0)
+            return false;
+        {
+            Worker& worker = *workers[self];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            if (!worker.queue.empty())
+            {
+                job = std::move(worker.queue.back());
+                worker.queue.pop_back();
+                --queued;
+                return true;
+            }
+        }
+        size_t count = workers.size();
+        size_t start = (size_t)self + 1 + victimSeed++ % count;
+        for (size_t i = 0; i < count; ++i)
+        {
+            size_t victim = (start + i) % count;
+            if (victim == (size_t)self)
+                continue;
+            Worker& worker = *workers[victim];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            if (!worker.queue.empty())
+            {
+                job = std::move(worker.queue.front());
+                worker.queue.pop_front();
+                --queued;
+                ++workers[self]->steals;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void execute(JobCounter::Job& job, Worker& worker)
+    {
+        job.func();
+        ++worker.jobs;
+        finish(job.counter);
+    }
+
+    void finish(JobCounter* counter)
+    {
+        if (counter == NULL)
+            return;
+        std::vector<JobCounter::Job> released;
+        {
+            std::lock_guard<std::mutex> lock(counter->mutex);
+            if (--counter->pending != 0)
+                return;
+            released.swap(counter->continuations);
+            counter->finished.notify_all();
+        }
+        for (JobCounter::Job& job : released)
+            push(std::move(job));
+    }
+
+    void workerLoop(unsigned index)
+    {
+        current.system = this;
+        current.index = (int)index;
+        Worker& worker = *workers[index];
+        for (;;)
+        {
+            JobCounter::Job job;
+            bool found = take((int)index, job);
+            if (!found)
+            {
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                ++sleepers;
+                wake.wait(lock, [this] { return quit || queued.load() > 0 || !background.empty(); });
+                --sleepers;
+                if (quit)
+                    return;
+                if (queued.load() > 0)
+                    continue;
+                job = std::move(background.front());
+                background.pop_front();
+            }
+
+            // Time spent waiting inside a job counts as busy, since the
+            // worker can't start anything new meanwhile
+            Clock::time_point begin = Clock::now();
+            execute(job, worker);
+            worker.busyNanoseconds += (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+        }
+    }
+
+    struct CurrentWorker
+    {
+        const JobSystem* system;
+        int index;
+    };
+    static inline thread_local CurrentWorker current = { NULL, -1 };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<size_t> queued{ 0 }, nextQueue{ 0 }, victimSeed{ 0 };
+
+    std::mutex sleepMutex;              // guards background and quit
+    std::condition_variable wake;
+    std::atomic<int> sleepers{ 0 };
+    std::deque<JobCounter::Job> background;
+    bool quit = false;
+
+    Clock::time_point sampleTime;
+    std::vector<unsigned long long> sampleBusy;
+};
@@ -0,0 +1,446 @@
+#pragma once
+
+// Simulated spinning LiDAR mounted on the robot's head.
+// Casts channels x columns rays per sweep on the CPU against the floor plane,
+// the props and every robot's link capsules. The primitives sit in a BVH that
+// is rebuilt per sweep, rays are traced in packets of four vertically
+// adjacent beams that share an origin and nearly a direction, and columns are
+// spread across the shared JobSystem. No GL anywhere, so it runs headless too.
+
+#include "RayCast.h"
+#include "RobotCollision.h"
+#include "RobotLinks.h"
+#include "JobSystem.h"
+#include "SimMath.h"
+
+#include <cfloat>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Scene
+// ---------------------------------------------------------------------------
+
+enum LidarPrimitiveType
+{
+    LIDAR_SPHERE,
+    LIDAR_BOX,
+    LIDAR_CAPSULE
+};
+
+struct LidarPrimitive
+{
+    LidarPrimitiveType type;
+    Vec3 a, b;          // sphere: centre in a; box: min/max; capsule: end points
+    float radius;
+    float reflectivity; // 0..1, scales the returned intensity
+};
+
+inline Aabb lidarPrimitiveBounds(const LidarPrimitive& p)
+{
+    if (p.type == LIDAR_BOX)
+    {
+        Aabb box = { p.a, p.b };
+        return box;
+    }
+    Capsule c = { p.a, p.type == LIDAR_SPHERE ? p.a : p.b, p.radius };
+    return capsuleBounds(c);
+}
+
+struct LidarHit
+{
+    float t;
+    Vec3 normal;
+    float reflectivity;
+};
+
+inline bool intersectPrimitive(const LidarPrimitive& p, const Vec3& o, const Vec3& d, const Vec3& invD, float& t, Vec3& normal)
+{
+    switch (p.type)
+    {
+    case LIDAR_SPHERE:
+        if (!intersectSphere(o, d, p.a, p.radius, t))
+            return false;
+        normal = normalize(o + d * t - p.a);
+        return true;
+    case LIDAR_CAPSULE:
+    {
+        if (!intersectCapsule(o, d, p.a, p.b, p.radius, t))
+            return false;
+        Vec3 hit = o + d * t, ba = p.b - p.a;
+        float baba = dot(ba, ba);
+        float h = baba > 0.0f ? std::min(std::max(dot(hit - p.a, ba) / baba, 0.0f), 1.0f) : 0.0f;
+        normal = normalize(hit - (p.a + ba * h));
+        return true;
+    }
+    case LIDAR_BOX:
+        return intersectBox(o, invD, p.a, p.b, t, normal);
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Sensor
+// ---------------------------------------------------------------------------
+
+struct LidarConfig
+{
+    int channels = 32;                  // vertical beams, multiple of 4
+    int columns = 1024;                 // azimuth steps per sweep
+    float minElevation = -15.0f;        // degrees
+    float maxElevation = 15.0f;
+    float maxRange = 100.0f;            // metres
+    float rangeResolution = 0.004f;     // metres per range unit in the encoded scan
+    float mountHeight = 2.3f;           // above the robot origin, clear of the head sphere
+    float rate = 10.0f;                 // sweeps per second
+    float floorHeight = -0.9f;
+    float floorReflectivity = 0.5f;
+};
+
+// One sweep, column-major: the channels of column 0, then column 1, ...
+struct LidarScan
+{
+    int channels = 0, columns = 0;
+    double timestamp = 0.0;
+    float poseX = 0.0f, poseY = 0.0f, poseZ = 0.0f, poseYaw = 0.0f;
+    std::vector<float> ranges;          // metres, 0 for no return
+    std::vector<uint8_t> intensities;
+};
+
+// Encoded scan layout, every field little endian:
+//   LidarScanHeader, uint16 ranges[channels * columns] in rangeResolution
+//   units (0 = no return), uint8 intensities[channels * columns]
+#pragma pack(push, 1)
+struct LidarScanHeader
+{
+    char magic[4];          // "LDR1"
+    uint16_t channels, columns;
+    float minElevation, maxElevation;
+    float rangeResolution;
+    double timestamp;
+    float poseX, poseY, poseZ, poseYaw;
+};
+#pragma pack(pop)
+
+class LidarSensor
+{
+public:
+    explicit LidarSensor(const LidarConfig& config = LidarConfig()) { configure(config); }
+
+    void configure(const LidarConfig& newConfig)
+    {
+        config = newConfig;
+        config.channels = (config.channels + 3) & ~3;
+
+        // Beam directions in the sensor frame, per channel and per column
+        elevationSin.resize(config.channels);
+        elevationCos.resize(config.channels);
+        for (int c = 0; c < config.channels; ++c)
+        {
+            float f = config.channels > 1 ? (float)c / (config.channels - 1) : 0.5f;
+            float elevation = toRadians(config.minElevation + f * (config.maxElevation - config.minElevation));
+            elevationSin[c] = std::sin(elevation);
+            elevationCos[c] = std::cos(elevation);
+        }
+        azimuthSin.resize(config.columns);
+        azimuthCos.resize(config.columns);
+        for (int c = 0; c < config.columns; ++c)
+        {
+            float azimuth = 2.0f * 3.14159265f * c / config.columns;
+            azimuthSin[c] = std::sin(azimuth);
+            azimuthCos[c] = std::cos(azimuth);
+        }
+    }
+
+    // Collects the scene: static props plus every robot's links. The scanning
+    // robot's head is left out since the sensor is mounted on top of it.
+    void setScene(const CollisionScene& scene, const std::vector<RobotLinks>& robots, int selfIndex)
+    {
+        primitives.clear();
+        for (const Prop& prop : scene.props)
+        {
+            LidarPrimitive p;
+            if (prop.shape == PROP_SPHERE)
+            {
+                p.type = LIDAR_SPHERE;
+                p.a = p.b = prop.center;
+                p.radius = prop.radius;
+            }
+            else
+            {
+                p.type = LIDAR_BOX;
+                p.a = prop.center - prop.halfExtents;
+                p.b = prop.center + prop.halfExtents;
+                p.radius = 0.0f;
+            }
+            p.reflectivity = 0.6f;
+            primitives.push_back(p);
+        }
+
+        for (size_t r = 0; r < robots.size(); ++r)
+            for (int link = 0; link < kRobotLinkCount; ++link)
+            {
+                if ((int)r == selfIndex && link == LINK_HEAD)
+                    continue;
+                const Capsule& c = robots[r].links[link];
+                LidarPrimitive p = { LIDAR_CAPSULE, c.a, c.b, c.radius, 0.8f };
+                primitives.push_back(p);
+            }
+
+        // Reorder the primitives to match the tree so leaves index them directly
+        std::vector<Aabb> bounds(primitives.size());
+        for (size_t i = 0; i < primitives.size(); ++i)
+            bounds[i] = lidarPrimitiveBounds(primitives[i]);
+        bvh.build(bounds);
+        std::vector<LidarPrimitive> sorted(primitives.size());
+        for (size_t i = 0; i < primitives.size(); ++i)
+            sorted[i] = primitives[bvh.order[i]];
+        primitives.swap(sorted);
+    }
+
+    bool due(double now) const { return now - lastSweep >= 1.0 / config.rate; }
+
+    // Casts a full sweep from the given robot pose into scan
+    void sweep(const RobotKinematics& robot, double now, LidarScan& scan)
+    {
+        scan.channels = config.channels;
+        scan.columns = config.columns;
+        scan.timestamp = now;
+        scan.poseX = robot.x;
+        scan.poseY = robot.y;
+        scan.poseZ = robot.z;
+        scan.poseYaw = robot.rotation;
+        scan.ranges.resize((size_t)config.channels * config.columns);
+        scan.intensities.resize(scan.ranges.size());
+
+        Vec3 origin = vec3(robot.x, robot.y + config.mountHeight, robot.z);
+        Mat3 yaw = rotationY(robot.rotation);
+
+        JobSystem::shared().parallelFor((size_t)config.columns, [&](size_t begin, size_t end)
+        {
+            for (size_t column = begin; column < end; ++column)
+            {
+                // Azimuth 0 is the robot's -Z axis, turning with the robot
+                Vec3 horizontal = yaw * vec3(azimuthSin[column], 0.0f, -azimuthCos[column]);
+                size_t base = column * config.channels;
+                for (int channel = 0; channel < config.channels; channel += 4)
+                    tracePacket(origin, horizontal, channel, &scan.ranges[base + channel], &scan.intensities[base + channel]);
+            }
+        }, 8);
+
+        lastSweep = now;
+    }
+
+    // Appends the compact binary form of scan to out
+    void encode(const LidarScan& scan, std::vector<uint8_t>& out) const
+    {
+        size_t count = scan.ranges.size();
+        size_t offset = out.size();
+        out.resize(offset + sizeof(LidarScanHeader) + count * 3);
+
+        // Field by field in LidarScanHeader order, so the header is little
+        // endian like the ranges whatever the host's byte order
+        uint8_t* write = &out[offset];
+        auto put = [&write](uint64_t bits, int bytes)
+        {
+            for (int i = 0; i < bytes; ++i)
+                *write++ = (uint8_t)(bits >> (i * 8));
+        };
+        auto putFloat = [&put](float value)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            put(bits, 4);
+        };
+        put('L' | 'D' << 8 | 'R' << 16 | (uint32_t)'1' << 24, 4);
+        put((uint16_t)scan.channels, 2);
+        put((uint16_t)scan.columns, 2);
+        putFloat(config.minElevation);
+        putFloat(config.maxElevation);
+        putFloat(config.rangeResolution);
+        uint64_t timestamp;
+        std::memcpy(&timestamp, &scan.timestamp, sizeof(timestamp));
+        put(timestamp, 8);
+        putFloat(scan.poseX);
+        putFloat(scan.poseY);
+        putFloat(scan.poseZ);
+        putFloat(scan.poseYaw);
+
+        uint8_t* ranges = &out[offset + sizeof(LidarScanHeader)];
+        float scale = 1.0f / config.rangeResolution;
+        for (size_t i = 0; i < count; ++i)
+        {
+            float units = std::min(scan.ranges[i] * scale + 0.5f, 65535.0f);
+            uint16_t value = (uint16_t)units;
+            ranges[i * 2] = (uint8_t)(value & 0xFF);
+            ranges[i * 2 + 1] = (uint8_t)(value >> 8);
+        }
+        std::memcpy(ranges + count * 2, scan.intensities.data(), count);
+    }
+
+    const LidarConfig& settings() const { return config; }
+
+    // Moves the ground plane, e.g. to the terrain under the robot
+    void setFloorHeight(float height) { config.floorHeight = height; }
+    size_t primitiveCount() const { return primitives.size(); }
+
+private:
+    // Traces four vertically adjacent beams of one column together. The
+    // packet is tested against each BVH node's box in one SSE slab test and
+    // only descends where at least one beam still hits.
+    void tracePacket(const Vec3& origin, const Vec3& horizontal, int channel, float* ranges, uint8_t* intensities) const
+    {
+        Vec3 dir[4], invDir[4];
+        float tMax[4];
+        LidarHit hit[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            dir[i] = horizontal * elevationCos[channel + i];
+            dir[i].y = elevationSin[channel + i];
+            invDir[i] = reciprocal(dir[i]);
+            tMax[i] = config.maxRange;
+            hit[i].t = FLT_MAX;
+
+            // The floor is an infinite plane, handled outside the BVH
+            if (dir[i].y < 0.0f)
+            {
+                float t = (config.floorHeight - origin.y) / dir[i].y;
+                if (t > 0.0f && t < tMax[i])
+                {
+                    tMax[i] = t;
+                    hit[i].t = t;
+                    hit[i].normal = vec3(0.0f, 1.0f, 0.0f);
+                    hit[i].reflectivity = config.floorReflectivity;
+                }
+            }
+        }
+
+        if (!bvh.nodes.empty())
+            traverse(origin, dir, invDir, tMax, hit);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            if (hit[i].t < FLT_MAX)
+            {
+                // Lambertian return, fading with range
+                float cosine = std::fabs(dot(dir[i], hit[i].normal));
+                float falloff = 1.0f / (1.0f + 0.02f * hit[i].t);
+                ranges[i] = hit[i].t;
+                intensities[i] = (uint8_t)std::min(255.0f, 255.0f * hit[i].reflectivity * cosine * falloff + 0.5f);
+            }
+            else
+            {
+                ranges[i] = 0.0f;
+                intensities[i] = 0;
+            }
+        }
+    }
+
+    void traverse(const Vec3& origin, const Vec3* dir, const Vec3* invDir, float* tMax, LidarHit* hit) const
+    {
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+
+#ifdef ROBOT_SIMD_SSE
+        const __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+        const __m128 ix = _mm_setr_ps(invDir[0].x, invDir[1].x, invDir[2].x, invDir[3].x);
+        const __m128 iy = _mm_setr_ps(invDir[0].y, invDir[1].y, invDir[2].y, invDir[3].y);
+        const __m128 iz = _mm_setr_ps(invDir[0].z, invDir[1].z, invDir[2].z, invDir[3].z);
+#endif
+
+        while (top > 0)
+        {
+            const Bvh::Node& node = bvh.nodes[stack[--top]];
+
+#ifdef ROBOT_SIMD_SSE
+            __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds.min.x), ox), ix);
+            __m128 tx2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds.max.x), ox), ix);
+            __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds.min.y), oy), iy);
+            __m128 ty2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds.max.y), oy), iy);
+            __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds.min.z), oz), iz);
+            __m128 tz2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds.max.z), oz), iz);
+            __m128 tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2)), _mm_max_ps(_mm_min_ps(tz1, tz2), _mm_setzero_ps()));
+            __m128 tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2)), _mm_min_ps(_mm_max_ps(tz1, tz2), _mm_loadu_ps(tMax)));
+            if (_mm_movemask_ps(_mm_cmple_ps(tNear, tFar)) == 0)
+                continue;
+#else
+            bool any = false;
+            for (int i = 0; i < 4 && !any; ++i)
+                any = rayHitsAabb(origin, invDir[i], node.bounds, tMax[i]);
+            if (!any)
+                continue;
+#endif
+
+            if (node.count == 0)
+            {
+                if (top + 2 <= 64)
+                {
+                    stack[top++] = node.rightOrFirst;
+                    stack[top++] = (int)(&node - &bvh.nodes[0]) + 1;
+                }
+                continue;
+            }
+
+            for (int p = node.rightOrFirst; p < node.rightOrFirst + node.count; ++p)
+                for (int i = 0; i < 4; ++i)
+                {
+                    float t;
+                    Vec3 normal;
+                    if (intersectPrimitive(primitives[p], origin, dir[i], invDir[i], t, normal) && t < tMax[i])
+                    {
+                        tMax[i] = t;
+                        hit[i].t = t;
+                        hit[i].normal = normal;
+                        hit[i].reflectivity = primitives[p].reflectivity;
+                    }
+                }
+        }
+    }
+
+    LidarConfig config;
+    std::vector<float> elevationSin, elevationCos;
+    std::vector<float> azimuthSin, azimuthCos;
+    std::vector<LidarPrimitive> primitives;
+    Bvh bvh;
+    double lastSweep = -1e9;
+};
+
+// Appends encoded scans to a file, one after another
+class LidarScanWriter
+{
+public:
+    ~LidarScanWriter() { close(); }
+
+    bool open(const char* path)
+    {
+        close();
+        file = fopen(path, "wb");
+        return file != NULL;
+    }
+
+    void close()
+    {
+        if (file != NULL)
+            fclose(file);
+        file = NULL;
+    }
+
+    bool isOpen() const { return file != NULL; }
+
+    void write(const LidarSensor& sensor, const LidarScan& scan)
+    {
+        buffer.clear();
+        sensor.encode(scan, buffer);
+        fwrite(buffer.data(), 1, buffer.size(), file);
+        ++scansWritten;
+    }
+
+    uint64_t scansWritten = 0;
+
+private:
+    FILE* file = NULL;
+    std::vector<uint8_t> buffer;
+};
@@ -0,0 +1,321 @@
+#pragma once
+
+// Static lighting baked on the CPU for geometry that never moves. Every
+// texel gets what fixed-function lighting gives its ambient and diffuse
+// terms, with the light's diffuse term shadowed and the ambient terms scaled
+// by ambient occlusion, both traced against a scene loaded into a
+// PathTracer. Specular is left out since it depends on the viewer. Rows of
+// texels are spread over the shared JobSystem and a whole bake can run as a
+// background job. The results are RGBA8 images ready for glTexImage2D,
+// and can be cached in a file under a key describing the light and
+// materials. No GL in here.
+
+#include "PathTracer.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+struct LightmapTarget
+{
+    enum Kind
+    {
+        PLANE,          // a rectangle facing normal
+        NORMAL_CUBE     // a convex prop, looked up by its world-space normal
+    };
+
+    Kind kind = PLANE;
+
+    // PLANE: texel (x, y) covers origin + uEdge * (x + [0, 1]) / width + vEdge * (y + [0, 1]) / height
+    Vec3 origin, uEdge, vEdge, normal;
+
+    // NORMAL_CUBE: a texel facing direction n (RasterCubemap::kFaceAxes)
+    // is lit as the point center + radius * n with normal n. Exact for a
+    // sphere, and for a box's face centres.
+    Vec3 center;
+    float radius = 0.0f;
+
+    int width = 0, height = 0;      // cube faces are width x width
+    RasterMaterial material;
+    std::vector<uint32_t> texels;   // packRgba(), rows in upload order, cube faces one after another
+
+    static LightmapTarget plane(const Vec3& origin, const Vec3& uEdge, const Vec3& vEdge, int width, int height, const RasterMaterial& material)
+    {
+        LightmapTarget target;
+        target.kind = PLANE;
+        target.origin = origin;
+        target.uEdge = uEdge;
+        target.vEdge = vEdge;
+        target.normal = normalize(cross(vEdge, uEdge));
+        target.width = width;
+        target.height = height;
+        target.material = material;
+        return target;
+    }
+
+    static LightmapTarget normalCube(const Vec3& center, float radius, int faceSize, const RasterMaterial& material)
+    {
+        LightmapTarget target;
+        target.kind = NORMAL_CUBE;
+        target.center = center;
+        target.radius = radius;
+        target.width = target.height = faceSize;
+        target.material = material;
+        return target;
+    }
+
+    int rows() const { return kind == PLANE ? height : height * 6; }
+    size_t texelCount() const { return (size_t)width * rows(); }
+};
+
+class LightmapBaker
+{
+public:
+    // The occluders, in world space; build() it before baking
+    PathTracer scene;
+
+    std::vector<LightmapTarget> targets;
+
+    int aoRays = 64;            // per texel
+    float aoDistance = 4.0f;    // occluders farther away than this don't darken
+    int planeSamples = 4;       // jittered positions per plane texel, for soft shadow edges
+
+    ~LightmapBaker() { stop(); }
+
+    // Bakes every target on all cores and returns when done. The light is in
+    // world space, with its sky ambient matrices too if it has them.
+    void bake(const RasterLight& light)
+    {
+        stop();
+        quit = false;
+        bakeTargets(light);
+    }
+
+    // Bakes as a background job. Nothing else may touch the scene or the
+    // targets until running() is false.
+    void start(const RasterLight& light, uint64_t key)
+    {
+        stop();
+        quit = false;
+        busy = true;
+        completedKey = 0;
+        JobSystem::shared().runBackground([this, light, key]()
+        {
+            if (bakeTargets(light))
+                completedKey = key;
+            busy = false;
+        }, &baking);
+    }
+
+    void stop()
+    {
+        if (baking.done())
+            return;
+        quit = true;
+        JobSystem::shared().wait(baking);
+    }
+
+    bool running() const { return busy; }
+
+    // Key of the finished background bake, 0 while one is running or stopped
+    uint64_t finishedKey() const { return busy ? 0 : completedKey.load(); }
+
+    // Fraction of rows done in the current or last bake
+    float progress() const
+    {
+        int rows = totalRows;
+        return rows > 0 ? (float)rowsDone / rows : 0.0f;
+    }
+
+    // Texels per second of the current or last bake
+    double texelsPerSecond() const { return rate; }
+
+    // The cache file holds the key and every target's size and texels; it
+    // only loads into targets laid out the same way
+    bool load(const char* path, uint64_t key)
+    {
+        FILE* file = fopen(path, "rb");
+        if (file == NULL)
+            return false;
+        char magic[4];
+        uint64_t storedKey = 0;
+        uint32_t count = 0;
+        bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, "LMB1", 4) == 0 &&
+            fread(&storedKey, sizeof(storedKey), 1, file) == 1 && storedKey == key &&
+            fread(&count, sizeof(count), 1, file) == 1 && count == targets.size();
+        for (size_t i = 0; ok && i < targets.size(); ++i)
+        {
+            LightmapTarget& target = targets[i];
+            int32_t header[3];
+            ok = fread(header, sizeof(header), 1, file) == 1 &&
+                header[0] == (int32_t)target.kind && header[1] == target.width && header[2] == target.height;
+            if (ok)
+            {
+                target.texels.resize(target.texelCount());
+                ok = fread(target.texels.data(), sizeof(uint32_t), target.texels.size(), file) == target.texels.size();
+            }
+        }
+        fclose(file);
+        return ok;
+    }
+
+    bool save(const char* path, uint64_t key) const
+    {
+        FILE* file = fopen(path, "wb");
+        if (file == NULL)
+            return false;
+        uint32_t count = (uint32_t)targets.size();
+        bool ok = fwrite("LMB1", 1, 4, file) == 4 && fwrite(&key, sizeof(key), 1, file) == 1 && fwrite(&count, sizeof(count), 1, file) == 1;
+        for (const LightmapTarget& target : targets)
+        {
+            int32_t header[3] = { (int32_t)target.kind, target.width, target.height };
+            ok = ok && fwrite(header, sizeof(header), 1, file) == 1 &&
+                fwrite(target.texels.data(), sizeof(uint32_t), target.texels.size(), file) == target.texels.size();
+        }
+        return fclose(file) == 0 && ok;
+    }
+
+private:
+    static constexpr float kRayOffset = 1e-3f;
+
+    // Rows of all targets are handed out from one counter, so a thread that
+    // finishes a cheap row moves straight on to the next. False if stopped.
+    bool bakeTargets(const RasterLight& light)
+    {
+        JobSystem& jobs = JobSystem::shared();
+        auto begin = std::chrono::steady_clock::now();
+
+        std::vector<int> firstRow(targets.size() + 1, 0);
+        for (size_t i = 0; i < targets.size(); ++i)
+        {
+            targets[i].texels.assign(targets[i].texelCount(), 0);
+            firstRow[i + 1] = firstRow[i] + targets[i].rows();
+        }
+        int rows = firstRow.back();
+        totalRows = rows;
+        rowsDone = 0;
+
+        std::atomic<int> nextRow(0);
+        jobs.parallelFor(jobs.threadCount(), [&](size_t, size_t)
+        {
+            for (int row = nextRow++; row < rows && !quit; row = nextRow++)
+            {
+                size_t target = 0;
+                while (row >= firstRow[target + 1])
+                    ++target;
+                bakeRow(targets[target], row - firstRow[target], light);
+                ++rowsDone;
+            }
+        }, 1);
+
+        size_t texels = 0;
+        for (const LightmapTarget& target : targets)
+            texels += target.texelCount();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        rate = seconds > 0.0 ? texels / seconds : 0.0;
+        return !quit;
+    }
+
+    void bakeRow(LightmapTarget& target, int row, const RasterLight& light) const
+    {
+        PathRandom random(((uint64_t)(&target - targets.data()) << 32) + (uint64_t)row);
+        uint32_t* out = &target.texels[(size_t)row * target.width];
+        for (int x = 0; x < target.width; ++x)
+        {
+            if (target.kind == LightmapTarget::PLANE)
+            {
+                int samples = std::max(planeSamples, 1);
+                float visible = 0.0f, open = 0.0f;
+                for (int i = 0; i < samples; ++i)
+                {
+                    Vec3 p = target.origin + target.uEdge * ((x + random.uniform()) / target.width) + target.vEdge * ((row + random.uniform()) / target.height);
+                    Vec3 origin = p + target.normal * kRayOffset;
+                    visible += lightVisibility(origin, target.normal, light);
+                    open += openness(origin, target.normal, (aoRays + samples - 1) / samples, random);
+                }
+                Vec3 center = target.origin + target.uEdge * ((x + 0.5f) / target.width) + target.vEdge * ((row + 0.5f) / target.height);
+                out[x] = shade(target.material, light, center, target.normal, visible / samples, open / samples);
+            }
+            else
+            {
+                // Rays start a little outside the surface, past the gap between
+                // the true shape and its tessellated mesh
+                int face = row / target.width, y = row % target.width;
+                const float (*axes)[3] = RasterCubemap::kFaceAxes[face];
+                float s = 2.0f * (x + 0.5f) / target.width - 1.0f, t = 2.0f * (y + 0.5f) / target.width - 1.0f;
+                Vec3 n = normalize(vec3(axes[0][0] + s * axes[1][0] + t * axes[2][0],
+                                        axes[0][1] + s * axes[1][1] + t * axes[2][1],
+                                        axes[0][2] + s * axes[1][2] + t * axes[2][2]));
+                Vec3 p = target.center + n * target.radius;
+                Vec3 origin = p + n * (target.radius * 0.05f + kRayOffset);
+                out[x] = shade(target.material, light, p, n, lightVisibility(origin, n, light), openness(origin, n, aoRays, random));
+            }
+        }
+    }
+
+    // 1 if the light reaches origin from in front of the surface, else 0
+    float lightVisibility(const Vec3& origin, const Vec3& n, const RasterLight& light) const
+    {
+        Vec3 l = vec3(light.position[0], light.position[1], light.position[2]);
+        float distance = 1e30f;
+        if (light.position[3] != 0.0f)
+        {
+            l = l * (1.0f / light.position[3]) - origin;
+            distance = length(l);
+            if (distance <= 0.0f)
+                return 1.0f;
+        }
+        l = normalize(l);
+        if (dot(l, n) <= 0.0f)
+            return 0.0f;
+        return scene.occluded(origin, l, distance) ? 0.0f : 1.0f;
+    }
+
+    // Fraction of cosine-weighted rays that leave without hitting anything
+    // within aoDistance
+    float openness(const Vec3& origin, const Vec3& n, int rays, PathRandom& random) const
+    {
+        if (rays <= 0)
+            return 1.0f;
+        Vec3 tangent, bitangent;
+        orthonormalBasis(n, tangent, bitangent);
+        int open = 0;
+        for (int i = 0; i < rays; ++i)
+        {
+            float r = std::sqrt(random.uniform()), phi = 6.28318531f * random.uniform();
+            Vec3 d = tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + n * std::sqrt(std::max(0.0f, 1.0f - r * r));
+            if (!scene.occluded(origin, d, aoDistance))
+                ++open;
+        }
+        return (float)open / rays;
+    }
+
+    // Fixed-function ambient and diffuse with the light's diffuse shadowed
+    // and every ambient term occluded
+    static uint32_t shade(const RasterMaterial& material, const RasterLight& light, const Vec3& p, const Vec3& n, float visible, float open)
+    {
+        RasterMaterial m = material;
+        for (int i = 0; i < 3; ++i)
+            m.specular[i] = 0.0f;
+        RasterLight l = light;
+        for (int i = 0; i < 3; ++i)
+        {
+            l.diffuse[i] *= visible;
+            l.ambient[i] *= open;
+            l.globalAmbient[i] *= open;
+            for (int j = 0; j < 16; ++j)
+                l.ambientMatrices[i][j] *= open;
+        }
+        Vec3 c = lightVertex(l, m, p, n);
+        return packRgba(c.x, c.y, c.z);
+    }
+
+    JobCounter baking;
+    std::atomic<bool> quit{ false }, busy{ false };
+    std::atomic<uint64_t> completedKey{ 0 };
+    std::atomic<int> rowsDone{ 0 };
+    std::atomic<int> totalRows{ 0 };
+    std::atomic<double> rate{ 0.0 };
+};
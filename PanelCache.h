@@ -0,0 +1,179 @@
+#pragma once
+
+// Cached control panel.
+// ImGui's draw lists are copied into a vertex and an index buffer when the
+// panel is rebuilt, and every frame draws them straight from those buffers,
+// so nothing is sent from client memory per frame. While nobody is using
+// the panel it's only rebuilt idleRate times per second (enough to keep the
+// readouts current) and the frames in between just replay the buffers. Any
+// input aimed at the panel, or a widget being held, brings it back to full
+// rate.
+
+#include <GL/glew.h>
+
+#include "imgui.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class PanelCache
+{
+public:
+    void shutdown()
+    {
+        if (vertexBuffer == 0)
+            return;
+        glDeleteBuffers(1, &vertexBuffer);
+        glDeleteBuffers(1, &indexBuffer);
+        vertexBuffer = indexBuffer = 0;
+        valid = false;
+    }
+
+    // Something may have changed the panel's input or layout; rebuild it on
+    // the next frame
+    void touch() { live = true; }
+
+    bool due(double now) const
+    {
+        return !valid || !throttle || live || idleRate <= 0.0f || now - lastBuild >= 1.0 / idleRate;
+    }
+
+    // Copies the finished ImGui frame into the buffers. interacting keeps the
+    // panel at full rate for the next frame, e.g. while a slider is held.
+    void upload(double now, const ImDrawData* drawData, bool interacting)
+    {
+        if (vertexBuffer == 0)
+        {
+            glGenBuffers(1, &vertexBuffer);
+            glGenBuffers(1, &indexBuffer);
+        }
+
+        vertices.clear();
+        indices.clear();
+        commands.clear();
+        displayPos = drawData->DisplayPos;
+        displaySize = drawData->DisplaySize;
+        scale = drawData->FramebufferScale;
+
+        // One vertex array for every list, with 32-bit indices rebased onto it
+        for (int n = 0; n < drawData->CmdListsCount; ++n)
+        {
+            const ImDrawList* list = drawData->CmdLists[n];
+            uint32_t base = (uint32_t)vertices.size();
+            vertices.insert(vertices.end(), list->VtxBuffer.Data, list->VtxBuffer.Data + list->VtxBuffer.Size);
+            for (int c = 0; c < list->CmdBuffer.Size; ++c)
+            {
+                const ImDrawCmd& cmd = list->CmdBuffer[c];
+                if (cmd.UserCallback != NULL || cmd.ElemCount == 0)
+                    continue;
+                Command command;
+                command.clipRect = cmd.ClipRect;
+                command.texture = (GLuint)(intptr_t)cmd.TextureId;
+                command.first = (uint32_t)indices.size();
+                command.count = cmd.ElemCount;
+                for (unsigned int i = 0; i < cmd.ElemCount; ++i)
+                    indices.push_back(base + cmd.VtxOffset + list->IdxBuffer[cmd.IdxOffset + i]);
+                commands.push_back(command);
+            }
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(ImDrawVert), vertices.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        lastBuild = now;
+        live = interacting;
+        valid = true;
+        ++rebuilds;
+    }
+
+    // Draws the last uploaded panel over whatever is in the framebuffer
+    void draw() const
+    {
+        int fbWidth = (int)(displaySize.x * scale.x);
+        int fbHeight = (int)(displaySize.y * scale.y);
+        if (!valid || commands.empty() || fbWidth <= 0 || fbHeight <= 0)
+            return;
+
+        // Same state as the OpenGL2 backend sets up
+        glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_TRANSFORM_BIT | GL_VIEWPORT_BIT | GL_SCISSOR_BIT | GL_POLYGON_BIT | GL_TEXTURE_BIT);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_STENCIL_TEST);
+        glDisable(GL_LIGHTING);
+        glDisable(GL_COLOR_MATERIAL);
+        glEnable(GL_SCISSOR_TEST);
+        glEnable(GL_TEXTURE_2D);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        glViewport(0, 0, fbWidth, fbHeight);
+
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadIdentity();
+        glOrtho(displayPos.x, displayPos.x + displaySize.x, displayPos.y + displaySize.y, displayPos.y, -1.0, 1.0);
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glLoadIdentity();
+
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(2, GL_FLOAT, sizeof(ImDrawVert), (const GLvoid*)offsetof(ImDrawVert, pos));
+        glTexCoordPointer(2, GL_FLOAT, sizeof(ImDrawVert), (const GLvoid*)offsetof(ImDrawVert, uv));
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ImDrawVert), (const GLvoid*)offsetof(ImDrawVert, col));
+
+        for (const Command& command : commands)
+        {
+            float x0 = (command.clipRect.x - displayPos.x) * scale.x;
+            float y0 = (command.clipRect.y - displayPos.y) * scale.y;
+            float x1 = (command.clipRect.z - displayPos.x) * scale.x;
+            float y1 = (command.clipRect.w - displayPos.y) * scale.y;
+            if (x1 <= x0 || y1 <= y0)
+                continue;
+            glScissor((int)x0, (int)(fbHeight - y1), (int)(x1 - x0), (int)(y1 - y0));
+            glBindTexture(GL_TEXTURE_2D, command.texture);
+            glDrawElements(GL_TRIANGLES, (GLsizei)command.count, GL_UNSIGNED_INT, (const GLvoid*)(command.first * sizeof(uint32_t)));
+        }
+
+        glPopClientAttrib();
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glMatrixMode(GL_MODELVIEW);
+        glPopMatrix();
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glPopAttrib();
+    }
+
+    bool throttle = true;
+    float idleRate = 10.0f;     // rebuilds per second while idle
+    unsigned long long rebuilds = 0;
+
+private:
+    struct Command
+    {
+        ImVec4 clipRect;
+        GLuint texture;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    GLuint vertexBuffer = 0, indexBuffer = 0;
+    std::vector<ImDrawVert> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<Command> commands;
+    ImVec2 displayPos, displaySize, scale;
+    double lastBuild = -1e9;
+    bool live = false;
+    bool valid = false;
+};
@@ -0,0 +1,779 @@
+#pragma once
+
+// Offline path tracer for reference frames of the scene. It takes the same
+// meshes, materials and textures the software rasterizer draws, puts every
+// triangle into a BVH in world space and traces paths on all cores, one
+// sample per pixel per pass, so the image refines for as long as it runs.
+// No GL in here.
+//
+// A GL material becomes an energy-conserving mix of a Lambertian lobe (its
+// diffuse colour) and a normalized Phong lobe (its specular colour and
+// shininess); the ambient terms are dropped since indirect light is traced.
+// The point light falls off with the square of the distance and is sampled
+// directly at every bounce. Rays that escape see the skybox. Textures and the
+// sky are treated as sRGB, material colours as linear, and the output is sRGB.
+
+#include "JobSystem.h"
+#include "RayCast.h"
+#include "SoftRasterizer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// PCG32, seeded per pixel and pass so a run always gives the same image
+struct PathRandom
+{
+    uint64_t state;
+
+    explicit PathRandom(uint64_t seed)
+    {
+        // splitmix64, so neighbouring seeds start far apart
+        seed += 0x9E3779B97F4A7C15ull;
+        seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ull;
+        seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBull;
+        state = seed ^ (seed >> 31);
+    }
+
+    uint32_t next()
+    {
+        uint64_t old = state;
+        state = old * 6364136223846793005ull + 1442695040888963407ull;
+        uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+        uint32_t rot = (uint32_t)(old >> 59);
+        return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+
+    // [0, 1)
+    float uniform() { return (next() >> 8) * (1.0f / 16777216.0f); }
+};
+
+// Cheap polynomial fit of the sRGB decode curve
+inline float srgbToLinear(float c) { return c * (c * (c * 0.305306011f + 0.682171111f) + 0.012522878f); }
+
+inline float linearToSrgb(float c)
+{
+    c = std::min(std::max(c, 0.0f), 1.0f);
+    return c <= 0.0031308f ? 12.92f * c : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+// Tangent and bitangent for a unit normal (Duff et al. 2017)
+inline void orthonormalBasis(const Vec3& n, Vec3& tangent, Vec3& bitangent)
+{
+    float sign = std::copysign(1.0f, n.z);
+    float a = -1.0f / (sign + n.z);
+    float b = n.x * n.y * a;
+    tangent = vec3(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+    bitangent = vec3(b, sign + n.y * n.y * a, -n.y);
+}
+
+struct PathMaterial
+{
+    Vec3 diffuse, specular, emission;
+    float shininess;
+    float specularChance;           // probability of sampling the Phong lobe
+    const RasterTexture* texture;   // modulates diffuse, GL_REPEAT
+    Aabb bounds;                    // of the mesh it was added with
+    bool shadows;                   // false for the point light's own fixture
+};
+
+class PathTracer
+{
+public:
+    static const int kTileSize = 16;
+
+    ~PathTracer() { stop(); }
+
+    // Drops the scene; the camera and image are kept
+    void clear()
+    {
+        stop();
+        triangles.clear();
+        shading.clear();
+        materials.clear();
+        nodes.clear();
+        packs.clear();
+        environment = NULL;
+        hasLight = false;
+    }
+
+    // Adds a mesh with its model-to-world transform. The material is
+    // converted and copied, the mesh copied and the texture only referenced.
+    void addMesh(const RasterMesh& mesh, const Mat4& model, const RasterMaterial& material, const RasterTexture* texture)
+    {
+        PathMaterial m;
+        m.diffuse = vec3(material.diffuse[0], material.diffuse[1], material.diffuse[2]);
+        m.specular = vec3(material.specular[0], material.specular[1], material.specular[2]);
+        m.emission = vec3(material.emission[0], material.emission[1], material.emission[2]);
+        m.shininess = std::max(material.shininess, 0.0f);
+        m.texture = texture && !texture->empty() && !mesh.uvs.empty() ? texture : NULL;
+
+        // GL lets diffuse plus specular exceed one; a surface can't reflect more than it receives
+        float total = std::max(m.diffuse.x + m.specular.x, std::max(m.diffuse.y + m.specular.y, m.diffuse.z + m.specular.z));
+        if (total > 1.0f)
+        {
+            m.diffuse = m.diffuse * (1.0f / total);
+            m.specular = m.specular * (1.0f / total);
+        }
+        float d = m.diffuse.x + m.diffuse.y + m.diffuse.z, s = m.specular.x + m.specular.y + m.specular.z;
+        m.specularChance = d + s > 0.0f ? s / (d + s) : 0.0f;
+
+        Mat3 normals = normalMatrix(model);
+        std::vector<Vec3> world(mesh.positions.size());
+        for (size_t i = 0; i < world.size(); ++i)
+            world[i] = transformPoint(model, mesh.positions[i]);
+        m.bounds.min = m.bounds.max = world.empty() ? vec3(0.0f, 0.0f, 0.0f) : world[0];
+        for (const Vec3& p : world)
+        {
+            m.bounds.min = vmin(m.bounds.min, p);
+            m.bounds.max = vmax(m.bounds.max, p);
+        }
+
+        int materialIndex = (int)materials.size();
+        materials.push_back(m);
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            uint32_t index[3] = { mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2] };
+            PathTriangle tri;
+            tri.v0 = world[index[0]];
+            tri.edge1 = world[index[1]] - tri.v0;
+            tri.edge2 = world[index[2]] - tri.v0;
+            if (length(cross(tri.edge1, tri.edge2)) <= 0.0f)
+                continue;
+            PathShading s;
+            for (int j = 0; j < 3; ++j)
+            {
+                s.normals[j] = normalize(normals * mesh.normals[index[j]]);
+                s.uvs[j * 2] = m.texture ? mesh.uvs[index[j] * 2] : 0.0f;
+                s.uvs[j * 2 + 1] = m.texture ? mesh.uvs[index[j] * 2 + 1] : 0.0f;
+            }
+            s.material = materialIndex;
+            triangles.push_back(tri);
+            shading.push_back(s);
+        }
+    }
+
+    // Position in world space, with w = 0 for a directional light like GL.
+    // intensity is the radiant intensity of a point light, or the irradiance
+    // a directional light gives a surface facing it.
+    void setLight(const float position[4], const Vec3& intensity)
+    {
+        hasLight = true;
+        lightDirectional = position[3] == 0.0f;
+        lightPosition = lightDirectional ? normalize(vec3(position[0], position[1], position[2])) : vec3(position[0], position[1], position[2]) * (1.0f / position[3]);
+        lightIntensity = intensity;
+    }
+
+    void setEnvironment(const RasterCubemap* cubemap) { environment = cubemap && !cubemap->empty() ? cubemap : NULL; }
+
+    // Pinhole camera with a vertical field of view in degrees. Resets the image.
+    void setCamera(const Vec3& eye, const Vec3& target, float fovY, int width, int height)
+    {
+        stop();
+        imageWidth = std::max(width, 1);
+        imageHeight = std::max(height, 1);
+        cameraEye = eye;
+        cameraForward = normalize(target - eye);
+        cameraRight = normalize(cross(cameraForward, vec3(0.0f, 1.0f, 0.0f)));
+        cameraUp = cross(cameraRight, cameraForward);
+        float tanHalf = std::tan(toRadians(fovY) * 0.5f);
+        cameraRight = cameraRight * (tanHalf * imageWidth / imageHeight);
+        cameraUp = cameraUp * tanHalf;
+        accumulation.assign((size_t)imageWidth * imageHeight * 3, 0.0f);
+        passes = 0;
+    }
+
+    // Builds the BVH; after the scene and light are set and before rendering.
+    // The binary tree from RayCast.h is collapsed into one with four
+    // children per node and at most four triangles per leaf, so traversal
+    // tests four boxes or four triangles at a time.
+    void build()
+    {
+        stop();
+        nodes.clear();
+        packs.clear();
+        std::vector<Aabb> boxes(triangles.size());
+        for (size_t i = 0; i < triangles.size(); ++i)
+        {
+            const PathTriangle& t = triangles[i];
+            Vec3 v1 = t.v0 + t.edge1, v2 = t.v0 + t.edge2;
+            boxes[i].min = vmin(t.v0, vmin(v1, v2));
+            boxes[i].max = vmax(t.v0, vmax(v1, v2));
+        }
+        Bvh bvh;
+        bvh.build(boxes, 4);
+        if (!bvh.empty())
+        {
+            nodes.push_back(WideNode());
+            collapse(bvh, 0, 0);
+        }
+
+        // The point light sits inside its light box, which would otherwise shadow everything
+        for (PathMaterial& m : materials)
+        {
+            const Vec3& p = lightPosition;
+            m.shadows = !hasLight || lightDirectional ||
+                p.x < m.bounds.min.x || p.y < m.bounds.min.y || p.z < m.bounds.min.z ||
+                p.x > m.bounds.max.x || p.y > m.bounds.max.y || p.z > m.bounds.max.z;
+        }
+    }
+
+    // Adds one sample to every pixel, tiles spread over all cores
+    void renderPass()
+    {
+        if (accumulation.empty())
+            return;
+        JobSystem& jobs = JobSystem::shared();
+        int tilesX = (imageWidth + kTileSize - 1) / kTileSize;
+        size_t tileCount = (size_t)tilesX * ((imageHeight + kTileSize - 1) / kTileSize);
+        int pass = passes;
+        std::atomic<size_t> nextTile(0);
+        jobs.parallelFor(jobs.threadCount(), [&](size_t, size_t)
+        {
+            for (size_t i = nextTile++; i < tileCount; i = nextTile++)
+                renderTile((int)(i % tilesX) * kTileSize, (int)(i / tilesX) * kTileSize, pass);
+        }, 1);
+        passes = pass + 1;
+    }
+
+    // Renders passes as a background job until every pixel has
+    // targetSamples samples or stop() is called. If path isn't empty the
+    // image is written there after 1, 2, 4, 8... passes and when it stops.
+    void start(int targetSamples, const std::string& path)
+    {
+        stop();
+        target = targetSamples;
+        outputPath = path;
+        quit = false;
+        busy = true;
+        JobSystem::shared().runBackground([this]() { refineLoop(); }, &refining);
+    }
+
+    void stop()
+    {
+        if (refining.done())
+            return;
+        quit = true;
+        JobSystem::shared().wait(refining);
+    }
+
+    bool running() const { return busy; }
+    int samples() const { return passes; }
+    int targetSamples() const { return target; }
+
+    // Pixel samples per second of the current or last background run
+    double samplesPerSecond() const { return rate; }
+
+    // The average so far as top-down 8-bit sRGB; not while running
+    void resolve(std::vector<uint8_t>& rgb) const
+    {
+        rgb.resize(accumulation.size());
+        float scale = passes > 0 ? 1.0f / passes : 0.0f;
+        for (size_t i = 0; i < accumulation.size(); ++i)
+            rgb[i] = (uint8_t)(linearToSrgb(accumulation[i] * scale) * 255.0f + 0.5f);
+    }
+
+    bool writePpm(const char* path) const
+    {
+        std::vector<uint8_t> rgb;
+        resolve(rgb);
+        FILE* file = fopen(path, "wb");
+        if (file == NULL)
+            return false;
+        fprintf(file, "P6\n%d %d\n255\n", imageWidth, imageHeight);
+        bool ok = fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+        return fclose(file) == 0 && ok;
+    }
+
+    // Whether anything that casts shadows lies along the ray before tMax;
+    // for visibility queries against the built scene, like baking
+    bool occluded(const Vec3& o, const Vec3& d, float tMax) const
+    {
+        PathHit hit;
+        return intersect(o, d, tMax, hit, true);
+    }
+
+    size_t triangleCount() const { return triangles.size(); }
+    int width() const { return imageWidth; }
+    int height() const { return imageHeight; }
+
+    int maxBounces = 6;
+
+private:
+    struct PathTriangle
+    {
+        Vec3 v0, edge1, edge2;
+    };
+
+    struct PathShading
+    {
+        Vec3 normals[3];
+        float uvs[6];
+        int material;
+    };
+
+    // Four children's boxes, structure of arrays. A child is a node index,
+    // or the bitwise complement of a triangle pack index.
+    struct WideNode
+    {
+        float minX[4], minY[4], minZ[4], maxX[4], maxY[4], maxZ[4];
+        int child[4];
+        int count;
+    };
+
+    // Up to four triangles, structure of arrays; unused lanes are degenerate
+    struct TrianglePack
+    {
+        float v0[3][4], edge1[3][4], edge2[3][4];
+        int triangle[4];
+    };
+
+    struct PathHit
+    {
+        float t, u, v;
+        int triangle;
+    };
+
+    static constexpr float kPi = 3.14159265f;
+    static constexpr float kRayOffset = 1e-3f;
+
+    // Fills wide node index with the binary node's children, opening the
+    // interior child with the largest surface area until there are four
+    void collapse(const Bvh& bvh, int binary, int index)
+    {
+        std::vector<int> children;
+        if (bvh.nodes[binary].count > 0)
+            children.push_back(binary);
+        else
+        {
+            children.push_back(binary + 1);
+            children.push_back(bvh.nodes[binary].rightOrFirst);
+        }
+        while (children.size() < 4)
+        {
+            int largest = -1;
+            float largestArea = -1.0f;
+            for (size_t i = 0; i < children.size(); ++i)
+            {
+                const Bvh::Node& node = bvh.nodes[children[i]];
+                Vec3 e = node.bounds.max - node.bounds.min;
+                float area = e.x * e.y + e.y * e.z + e.z * e.x;
+                if (node.count == 0 && area > largestArea)
+                {
+                    largest = (int)i;
+                    largestArea = area;
+                }
+            }
+            if (largest < 0)
+                break;
+            int opened = children[largest];
+            children[largest] = opened + 1;
+            children.push_back(bvh.nodes[opened].rightOrFirst);
+        }
+
+        nodes[index].count = (int)children.size();
+        for (int i = 0; i < 4; ++i)
+        {
+            const Aabb& bounds = bvh.nodes[children[std::min(i, (int)children.size() - 1)]].bounds;
+            WideNode& node = nodes[index];
+            node.minX[i] = bounds.min.x;
+            node.minY[i] = bounds.min.y;
+            node.minZ[i] = bounds.min.z;
+            node.maxX[i] = bounds.max.x;
+            node.maxY[i] = bounds.max.y;
+            node.maxZ[i] = bounds.max.z;
+            node.child[i] = 0;
+        }
+        for (size_t i = 0; i < children.size(); ++i)
+        {
+            const Bvh::Node& node = bvh.nodes[children[i]];
+            if (node.count > 0)
+            {
+                nodes[index].child[i] = ~(int)packs.size();
+                TrianglePack pack;
+                for (int lane = 0; lane < 4; ++lane)
+                {
+                    bool used = lane < node.count;
+                    int triangle = used ? bvh.order[node.rightOrFirst + lane] : bvh.order[node.rightOrFirst];
+                    const PathTriangle& t = triangles[triangle];
+                    const float* v0 = &t.v0.x;
+                    const float* e1 = &t.edge1.x;
+                    const float* e2 = &t.edge2.x;
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        pack.v0[axis][lane] = v0[axis];
+                        pack.edge1[axis][lane] = used ? e1[axis] : 0.0f;
+                        pack.edge2[axis][lane] = used ? e2[axis] : 0.0f;
+                    }
+                    pack.triangle[lane] = used ? triangle : -1;
+                }
+                packs.push_back(pack);
+            }
+            else
+            {
+                int child = (int)nodes.size();
+                nodes.push_back(WideNode());
+                nodes[index].child[i] = child;
+                collapse(bvh, children[i], child);
+            }
+        }
+    }
+
+    // Slab tests against a node's four boxes. Returns a bit per child the
+    // ray enters before tMax, with the entry distances in tNear.
+    static int enterChildren(const WideNode& node, const Vec3& o, const Vec3& invD, float tMax, float* tNear)
+    {
+#ifdef ROBOT_SIMD_SSE
+        __m128 ox = _mm_set1_ps(o.x), oy = _mm_set1_ps(o.y), oz = _mm_set1_ps(o.z);
+        __m128 ix = _mm_set1_ps(invD.x), iy = _mm_set1_ps(invD.y), iz = _mm_set1_ps(invD.z);
+        __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), ox), ix), tx2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxX), ox), ix);
+        __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), oy), iy), ty2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxY), oy), iy);
+        __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), oz), iz), tz2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxZ), oz), iz);
+        __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2)), _mm_max_ps(_mm_min_ps(tz1, tz2), _mm_setzero_ps()));
+        __m128 leave = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2)), _mm_min_ps(_mm_max_ps(tz1, tz2), _mm_set1_ps(tMax)));
+        _mm_storeu_ps(tNear, enter);
+        return _mm_movemask_ps(_mm_cmple_ps(enter, leave)) & ((1 << node.count) - 1);
+#else
+        int mask = 0;
+        for (int i = 0; i < node.count; ++i)
+        {
+            float tx1 = (node.minX[i] - o.x) * invD.x, tx2 = (node.maxX[i] - o.x) * invD.x;
+            float ty1 = (node.minY[i] - o.y) * invD.y, ty2 = (node.maxY[i] - o.y) * invD.y;
+            float tz1 = (node.minZ[i] - o.z) * invD.z, tz2 = (node.maxZ[i] - o.z) * invD.z;
+            tNear[i] = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), 0.0f));
+            float tFar = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), tMax));
+            if (tNear[i] <= tFar)
+                mask |= 1 << i;
+        }
+        return mask;
+#endif
+    }
+
+    // Moller-Trumbore against a pack's four triangles, both sides. Returns a
+    // bit per lane hit in (0, tMax), with t, u and v per lane.
+    static int intersectPack(const TrianglePack& pack, const Vec3& o, const Vec3& d, float tMax, float* t, float* u, float* v)
+    {
+#ifdef ROBOT_SIMD_SSE
+        __m128 dx = _mm_set1_ps(d.x), dy = _mm_set1_ps(d.y), dz = _mm_set1_ps(d.z);
+        __m128 e1x = _mm_loadu_ps(pack.edge1[0]), e1y = _mm_loadu_ps(pack.edge1[1]), e1z = _mm_loadu_ps(pack.edge1[2]);
+        __m128 e2x = _mm_loadu_ps(pack.edge2[0]), e2y = _mm_loadu_ps(pack.edge2[1]), e2z = _mm_loadu_ps(pack.edge2[2]);
+
+        // p = d x edge2, det = edge1 . p
+        __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+        __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+        __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+        __m128 sx = _mm_sub_ps(_mm_set1_ps(o.x), _mm_loadu_ps(pack.v0[0]));
+        __m128 sy = _mm_sub_ps(_mm_set1_ps(o.y), _mm_loadu_ps(pack.v0[1]));
+        __m128 sz = _mm_sub_ps(_mm_set1_ps(o.z), _mm_loadu_ps(pack.v0[2]));
+        __m128 bu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inv);
+
+        // q = s x edge1
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+        __m128 bv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv);
+        __m128 dist = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv);
+
+        __m128 zero = _mm_setzero_ps();
+        __m128 hit = _mm_and_ps(_mm_cmpgt_ps(absDet, _mm_set1_ps(1e-12f)), _mm_cmpge_ps(bu, zero));
+        hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(bv, zero), _mm_cmple_ps(_mm_add_ps(bu, bv), _mm_set1_ps(1.0f))));
+        hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpgt_ps(dist, zero), _mm_cmplt_ps(dist, _mm_set1_ps(tMax))));
+        _mm_storeu_ps(t, dist);
+        _mm_storeu_ps(u, bu);
+        _mm_storeu_ps(v, bv);
+        return _mm_movemask_ps(hit);
+#else
+        int mask = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            Vec3 e1 = vec3(pack.edge1[0][i], pack.edge1[1][i], pack.edge1[2][i]);
+            Vec3 e2 = vec3(pack.edge2[0][i], pack.edge2[1][i], pack.edge2[2][i]);
+            Vec3 p = cross(d, e2);
+            float det = dot(e1, p);
+            if (std::fabs(det) <= 1e-12f)
+                continue;
+            float inv = 1.0f / det;
+            Vec3 s = o - vec3(pack.v0[0][i], pack.v0[1][i], pack.v0[2][i]);
+            u[i] = dot(s, p) * inv;
+            Vec3 q = cross(s, e1);
+            v[i] = dot(d, q) * inv;
+            t[i] = dot(e2, q) * inv;
+            if (u[i] >= 0.0f && v[i] >= 0.0f && u[i] + v[i] <= 1.0f && t[i] > 0.0f && t[i] < tMax)
+                mask |= 1 << i;
+        }
+        return mask;
+#endif
+    }
+
+    // Closest hit below tMax, or with shadowRay any hit on a shadowing
+    // surface. Children are visited nearest first so close hits prune the
+    // rest, and entries already farther than the closest hit are skipped.
+    bool intersect(const Vec3& o, const Vec3& d, float tMax, PathHit& hit, bool shadowRay) const
+    {
+        if (nodes.empty())
+            return false;
+        Vec3 invD = reciprocal(d);
+        hit.t = tMax;
+        hit.triangle = -1;
+
+        struct Entry
+        {
+            int child;
+            float tNear;
+        };
+        Entry stack[96];
+        int top = 0;
+        stack[top++] = { 0, 0.0f };
+        while (top > 0)
+        {
+            Entry entry = stack[--top];
+            if (entry.tNear > hit.t)
+                continue;
+
+            if (entry.child < 0)
+            {
+                float t[4], u[4], v[4];
+                int mask = intersectPack(packs[~entry.child], o, d, hit.t, t, u, v);
+                for (; mask != 0; mask &= mask - 1)
+                {
+                    int lane = countTrailingZeros(mask);
+                    int triangle = packs[~entry.child].triangle[lane];
+                    if (shadowRay)
+                    {
+                        if (materials[shading[triangle].material].shadows)
+                            return true;
+                        continue;
+                    }
+                    if (t[lane] < hit.t)
+                    {
+                        hit.t = t[lane];
+                        hit.u = u[lane];
+                        hit.v = v[lane];
+                        hit.triangle = triangle;
+                    }
+                }
+                continue;
+            }
+
+            const WideNode& node = nodes[entry.child];
+            float tNear[4];
+            int mask = enterChildren(node, o, invD, hit.t, tNear);
+
+            // Push the farthest first so the nearest is popped next
+            int first = top;
+            for (; mask != 0; mask &= mask - 1)
+            {
+                int i = countTrailingZeros(mask);
+                int j = top++;
+                for (; j > first && stack[j - 1].tNear < tNear[i]; --j)
+                    stack[j] = stack[j - 1];
+                stack[j] = { node.child[i], tNear[i] };
+            }
+        }
+        return hit.triangle >= 0;
+    }
+
+    static int countTrailingZeros(int mask)
+    {
+        int n = 0;
+        while (!(mask & (1 << n)))
+            ++n;
+        return n;
+    }
+
+    Vec3 environmentRadiance(const Vec3& d) const
+    {
+        if (!environment)
+            return vec3(0.0f, 0.0f, 0.0f);
+        float rgba[4];
+        environment->sample(d, rgba);
+        return vec3(srgbToLinear(rgba[0]), srgbToLinear(rgba[1]), srgbToLinear(rgba[2]));
+    }
+
+    // Lambertian plus normalized Phong around the mirror direction
+    static Vec3 brdf(const PathMaterial& m, const Vec3& albedo, const Vec3& reflected, const Vec3& wi)
+    {
+        Vec3 f = albedo * (1.0f / kPi);
+        float c = dot(reflected, wi);
+        if (c > 0.0f && m.specularChance > 0.0f)
+            f = f + m.specular * ((m.shininess + 2.0f) * (0.5f / kPi) * std::pow(c, m.shininess));
+        return f;
+    }
+
+    // Probability density of sampling wi with the material's lobe mix
+    static float lobePdf(const PathMaterial& m, const Vec3& n, const Vec3& reflected, const Vec3& wi)
+    {
+        float pdf = (1.0f - m.specularChance) * std::max(dot(n, wi), 0.0f) * (1.0f / kPi);
+        float c = dot(reflected, wi);
+        if (c > 0.0f && m.specularChance > 0.0f)
+            pdf += m.specularChance * (m.shininess + 1.0f) * (0.5f / kPi) * std::pow(c, m.shininess);
+        return pdf;
+    }
+
+    // Direction around axis with density proportional to cos^exponent
+    static Vec3 sampleLobe(const Vec3& axis, float exponent, PathRandom& random)
+    {
+        float cosTheta = std::pow(random.uniform(), 1.0f / (exponent + 1.0f));
+        float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+        float phi = 2.0f * kPi * random.uniform();
+        Vec3 tangent, bitangent;
+        orthonormalBasis(axis, tangent, bitangent);
+        return tangent * (std::cos(phi) * sinTheta) + bitangent * (std::sin(phi) * sinTheta) + axis * cosTheta;
+    }
+
+    Vec3 trace(Vec3 o, Vec3 d, PathRandom& random) const
+    {
+        Vec3 radiance = vec3(0.0f, 0.0f, 0.0f), throughput = vec3(1.0f, 1.0f, 1.0f);
+        for (int bounce = 0; ; ++bounce)
+        {
+            PathHit hit;
+            if (!intersect(o, d, 1e30f, hit, false))
+            {
+                radiance = radiance + mul(throughput, environmentRadiance(d));
+                break;
+            }
+
+            const PathTriangle& tri = triangles[hit.triangle];
+            const PathShading& s = shading[hit.triangle];
+            const PathMaterial& m = materials[s.material];
+            radiance = radiance + mul(throughput, m.emission);
+            if (bounce == maxBounces)
+                break;
+
+            // Both normals face the incoming ray, since open meshes are seen from either side
+            float w = 1.0f - hit.u - hit.v;
+            Vec3 ng = normalize(cross(tri.edge1, tri.edge2));
+            Vec3 n = normalize(s.normals[0] * w + s.normals[1] * hit.u + s.normals[2] * hit.v);
+            if (dot(ng, d) > 0.0f)
+                ng = -ng;
+            if (dot(n, ng) < 0.0f)
+                n = -n;
+            Vec3 p = o + d * hit.t;
+            Vec3 origin = p + ng * kRayOffset;
+            Vec3 reflected = d - n * (2.0f * dot(d, n));
+
+            Vec3 albedo = m.diffuse;
+            if (m.texture)
+            {
+                float rgba[4];
+                m.texture->sample(s.uvs[0] * w + s.uvs[2] * hit.u + s.uvs[4] * hit.v, s.uvs[1] * w + s.uvs[3] * hit.u + s.uvs[5] * hit.v, 0, true, rgba);
+                albedo = mul(albedo, vec3(srgbToLinear(rgba[0]), srgbToLinear(rgba[1]), srgbToLinear(rgba[2])));
+            }
+
+            // Next event estimation towards the light
+            if (hasLight)
+            {
+                Vec3 wi = lightPosition, incoming = lightIntensity;
+                float distance = 1e30f;
+                if (!lightDirectional)
+                {
+                    Vec3 l = lightPosition - p;
+                    float distance2 = dot(l, l);
+                    distance = std::sqrt(distance2);
+                    wi = l * (1.0f / distance);
+                    incoming = incoming * (1.0f / distance2);
+                }
+                float cosine = dot(n, wi);
+                PathHit blocker;
+                if (cosine > 0.0f && dot(ng, wi) > 0.0f && !intersect(origin, wi, distance, blocker, true))
+                    radiance = radiance + mul(throughput, mul(brdf(m, albedo, reflected, wi), incoming)) * cosine;
+            }
+
+            // Continue the path by sampling one lobe, weighted by the mix's density
+            Vec3 wi = random.uniform() < m.specularChance ? sampleLobe(reflected, m.shininess, random) : sampleLobe(n, 1.0f, random);
+            float cosine = dot(n, wi);
+            if (cosine <= 0.0f || dot(ng, wi) <= 0.0f)
+                break;
+            float pdf = lobePdf(m, n, reflected, wi);
+            if (pdf <= 0.0f)
+                break;
+            throughput = mul(throughput, brdf(m, albedo, reflected, wi)) * (cosine / pdf);
+
+            // Russian roulette once paths have had a few bounces
+            if (bounce >= 2)
+            {
+                float survive = std::min(std::max(throughput.x, std::max(throughput.y, throughput.z)), 0.95f);
+                if (random.uniform() >= survive)
+                    break;
+                throughput = throughput * (1.0f / survive);
+            }
+            o = origin;
+            d = wi;
+        }
+        return radiance;
+    }
+
+    void renderTile(int x0, int y0, int pass)
+    {
+        int x1 = std::min(x0 + kTileSize, imageWidth), y1 = std::min(y0 + kTileSize, imageHeight);
+        for (int y = y0; y < y1; ++y)
+            for (int x = x0; x < x1; ++x)
+            {
+                size_t pixel = (size_t)y * imageWidth + x;
+                PathRandom random(pixel * 0x100000001B3ull + (uint64_t)pass);
+                float ndcX = 2.0f * (x + random.uniform()) / imageWidth - 1.0f;
+                float ndcY = 1.0f - 2.0f * (y + random.uniform()) / imageHeight;
+                Vec3 d = normalize(cameraForward + cameraRight * ndcX + cameraUp * ndcY);
+                Vec3 radiance = trace(cameraEye, d, random);
+
+                // A NaN from a degenerate normal would poison the pixel for good
+                if (radiance.x == radiance.x && radiance.y == radiance.y && radiance.z == radiance.z)
+                {
+                    float* sum = &accumulation[pixel * 3];
+                    sum[0] += radiance.x;
+                    sum[1] += radiance.y;
+                    sum[2] += radiance.z;
+                }
+            }
+    }
+
+    void refineLoop()
+    {
+        auto begin = std::chrono::steady_clock::now();
+        int first = passes, written = -1;
+        while (!quit && passes < target)
+        {
+            renderPass();
+            int done = passes;
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            rate = seconds > 0.0 ? (double)(done - first) * imageWidth * imageHeight / seconds : 0.0;
+            if (!outputPath.empty() && ((done & (done - 1)) == 0 || done == target))
+            {
+                writePpm(outputPath.c_str());
+                written = done;
+            }
+        }
+        if (!outputPath.empty() && passes > 0 && written != passes)
+            writePpm(outputPath.c_str());
+        busy = false;
+    }
+
+    std::vector<PathTriangle> triangles;
+    std::vector<PathShading> shading;
+    std::vector<PathMaterial> materials;
+    std::vector<WideNode> nodes;
+    std::vector<TrianglePack> packs;
+    const RasterCubemap* environment = NULL;
+
+    bool hasLight = false, lightDirectional = false;
+    Vec3 lightPosition, lightIntensity;
+
+    int imageWidth = 0, imageHeight = 0;
+    Vec3 cameraEye, cameraForward, cameraRight, cameraUp;
+    std::vector<float> accumulation;    // RGB sums, top-down
+
+    JobCounter refining;
+    std::atomic<int> passes{ 0 };
+    std::atomic<bool> quit{ false }, busy{ false };
+    std::atomic<double> rate{ 0.0 };
+    int target = 0;
+    std::string outputPath;
+};
@@ -0,0 +1,152 @@
+#pragma once
+
+// Holds the frame time near a budget by stepping through a ladder of
+// quality levels. Frame times are averaged over short windows; a window
+// well over budget drops one level, and a run of windows well under it
+// climbs one back. A climb that is undone straight away doubles the wait
+// before the next one, so the governor settles instead of oscillating
+// between two levels. The window after every change is ignored, since
+// reallocating render targets makes its first frames slow. No GL in here;
+// the caller applies settings() to the scene.
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+
+struct QualityLevel
+{
+    const char* name;
+    float renderScale;      // main view resolution, as a fraction of the window's
+    int tessellation;       // slices and stacks of the GL spheres and cylinders
+    int reflectionSize;     // face size of the teapot's cubemap
+    float reflectionRate;   // cubemap faces re-rendered per second, 0 for one every frame
+    bool floorReflection;   // the stencil reflection of the scene in the floor
+    float panelRate;        // idle control panel rebuilds per second
+};
+
+class QualityGovernor
+{
+public:
+    struct Change
+    {
+        double time;
+        int from, to;
+        double frameTime;   // the window's mean that caused it
+    };
+
+    static constexpr int kLevelCount = 5;
+    static const QualityLevel& levelSettings(int level)
+    {
+        static const QualityLevel kLevels[kLevelCount] =
+        {
+            { "Full",    1.0f,  20, 128,  0.0f, true,  10.0f },
+            { "High",    1.0f,  14, 128, 30.0f, true,  10.0f },
+            { "Medium",  0.85f, 12,  64, 15.0f, true,   5.0f },
+            { "Low",     0.7f,  10,  64, 10.0f, false,  5.0f },
+            { "Minimum", 0.5f,   8,  32,  5.0f, false,  2.0f },
+        };
+        return kLevels[std::min(std::max(level, 0), kLevelCount - 1)];
+    }
+
+    bool enabled = true;
+    double budget = 1.0 / 60.0;     // seconds per frame
+    double window = 0.5;            // seconds of frames averaged per decision
+    double dropAbove = 1.15;        // fractions of the budget
+    double climbBelow = 0.75;
+    double climbDelay = 2.0;        // seconds of headroom before climbing, doubled by each undone climb
+    size_t logSize = 8;
+
+    // Feeds one frame's duration. True when the level changed; the caller
+    // then applies settings().
+    bool update(double now, double frameTime)
+    {
+        if (!enabled)
+            return reset(now);
+        if (windowStart < 0.0 || now < settleUntil)
+        {
+            startWindow(now);
+            return false;
+        }
+
+        frameSum += frameTime;
+        ++frameCount;
+        if (now - windowStart < window)
+            return false;
+
+        average = frameSum / frameCount;
+        startWindow(now);
+        if (average > budget * dropAbove)
+        {
+            if (current == kLevelCount - 1)
+                return false;
+            if (lastClimb >= 0.0 && now - lastClimb < 3.0 * window)
+                climbBackoff = std::min(climbBackoff * 2.0, 32.0);
+            lastClimb = -1.0;
+            return change(now, current + 1);
+        }
+        if (average < budget * climbBelow)
+        {
+            if (current == 0)
+                return false;
+            if (headroomSince < 0.0)
+                headroomSince = now;
+            if (now - headroomSince < climbDelay * climbBackoff)
+                return false;
+            if (lastClimb >= 0.0)
+                climbBackoff = 1.0;     // the last climb held
+            lastClimb = now;
+            return change(now, current - 1);
+        }
+        headroomSince = -1.0;
+        return false;
+    }
+
+    // Back to full quality, e.g. when the governor is turned off. True if
+    // the level changed.
+    bool reset(double now)
+    {
+        windowStart = -1.0;
+        headroomSince = lastClimb = -1.0;
+        climbBackoff = 1.0;
+        return current != 0 && change(now, 0);
+    }
+
+    int level() const { return current; }
+    const QualityLevel& settings() const { return levelSettings(current); }
+
+    // Mean frame time of the last finished window, in seconds
+    double averageFrameTime() const { return average; }
+
+    // The most recent changes, oldest first
+    const std::deque<Change>& log() const { return changes; }
+
+private:
+    void startWindow(double now)
+    {
+        windowStart = now;
+        frameSum = 0.0;
+        frameCount = 0;
+    }
+
+    bool change(double now, int to)
+    {
+        Change entry = { now, current, to, average };
+        changes.push_back(entry);
+        while (changes.size() > logSize)
+            changes.pop_front();
+        current = to;
+        headroomSince = -1.0;
+        settleUntil = now + window;
+        windowStart = -1.0;
+        return true;
+    }
+
+    int current = 0;
+    double windowStart = -1.0, settleUntil = 0.0;
+    double frameSum = 0.0;
+    int frameCount = 0;
+    double average = 0.0;
+    double headroomSince = -1.0, lastClimb = -1.0;
+    double climbBackoff = 1.0;
+    std::deque<Change> changes;
+};
@@ -0,0 +1,242 @@
+#pragma once
+
+// Triangle meshes matching the GLUT and GLU solids the scene draws, for the
+// software rasterizer. Each builder produces the same shape, orientation
+// and outward normals as its GL counterpart, so both backends draw the
+// same scene from the same draw calls.
+
+#include "SimMath.h"
+
+#include <cstdint>
+#include <vector>
+
+struct RasterMesh
+{
+    std::vector<Vec3> positions;
+    std::vector<Vec3> normals;
+    std::vector<float> uvs;             // two per vertex, empty if untextured
+    std::vector<uint32_t> indices;      // triangles
+    bool closed = false;                // back faces can never be seen and are culled
+};
+
+inline uint32_t addVertex(RasterMesh& mesh, const Vec3& position, const Vec3& normal)
+{
+    mesh.positions.push_back(position);
+    mesh.normals.push_back(normal);
+    return (uint32_t)mesh.positions.size() - 1;
+}
+
+inline void addQuad(RasterMesh& mesh, uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+    uint32_t quad[6] = { a, b, c, a, c, d };
+    mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+}
+
+// glutSolidSphere: centred on the origin with its poles on the z axis
+inline RasterMesh makeSphereMesh(float radius, int slices, int stacks)
+{
+    RasterMesh mesh;
+    mesh.closed = true;
+    for (int i = 0; i <= stacks; ++i)
+    {
+        float phi = 3.14159265f * i / stacks;
+        for (int j = 0; j <= slices; ++j)
+        {
+            float theta = 6.28318531f * j / slices;
+            Vec3 n = vec3(std::sin(phi) * std::cos(theta), std::sin(phi) * std::sin(theta), std::cos(phi));
+            addVertex(mesh, n * radius, n);
+        }
+    }
+    for (int i = 0; i < stacks; ++i)
+        for (int j = 0; j < slices; ++j)
+        {
+            uint32_t a = i * (slices + 1) + j;
+            uint32_t b = a + slices + 1;
+            addQuad(mesh, a, b, b + 1, a + 1);
+        }
+    return mesh;
+}
+
+// gluCylinder: open tube along +z from 0 to length, normals facing out
+inline RasterMesh makeCylinderMesh(float radius, float length, int slices)
+{
+    RasterMesh mesh;
+    for (int j = 0; j <= slices; ++j)
+    {
+        float theta = 6.28318531f * j / slices;
+        Vec3 n = vec3(std::sin(theta), std::cos(theta), 0.0f);
+        addVertex(mesh, vec3(n.x * radius, n.y * radius, 0.0f), n);
+        addVertex(mesh, vec3(n.x * radius, n.y * radius, length), n);
+    }
+    for (int j = 0; j < slices; ++j)
+        addQuad(mesh, 2 * j, 2 * j + 2, 2 * j + 3, 2 * j + 1);
+    return mesh;
+}
+
+// glutSolidCube: axis-aligned, centred on the origin
+inline RasterMesh makeCubeMesh(float size)
+{
+    RasterMesh mesh;
+    mesh.closed = true;
+    float h = size * 0.5f;
+    const Vec3 normals[6] = { vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1) };
+    for (const Vec3& n : normals)
+    {
+        // Two axes spanning the face, ordered so the corners wind counter-clockwise from outside
+        Vec3 u = std::fabs(n.x) > 0.5f ? vec3(0, 1, 0) : vec3(1, 0, 0);
+        Vec3 v = cross(n, u);
+        uint32_t a = addVertex(mesh, (n - u - v) * h, n);
+        uint32_t b = addVertex(mesh, (n + u - v) * h, n);
+        uint32_t c = addVertex(mesh, (n + u + v) * h, n);
+        uint32_t d = addVertex(mesh, (n - u + v) * h, n);
+        addQuad(mesh, a, b, c, d);
+    }
+    return mesh;
+}
+
+// The GLUT teapot: ten bicubic Bezier patches, mirrored into the full pot
+const int kTeapotPatches[10][16] =
+{
+    // rim
+    { 102, 103, 104, 105, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+    // body
+    { 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27 },
+    { 24, 25, 26, 27, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40 },
+    // lid
+    { 96, 96, 96, 96, 97, 98, 99, 100, 101, 101, 101, 101, 0, 1, 2, 3 },
+    { 0, 1, 2, 3, 106, 107, 108, 109, 110, 111, 112, 113, 114, 115, 116, 117 },
+    // bottom
+    { 118, 118, 118, 118, 124, 122, 119, 121, 123, 126, 125, 120, 40, 39, 38, 37 },
+    // handle
+    { 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56 },
+    { 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 28, 65, 66, 67 },
+    // spout
+    { 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80, 81, 82, 83 },
+    { 80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 90, 91, 92, 93, 94, 95 }
+};
+
+const float kTeapotPoints[127][3] =
+{
+    { 0.2f, 0.0f, 2.7f }, { 0.2f, -0.112f, 2.7f }, { 0.112f, -0.2f, 2.7f }, { 0.0f, -0.2f, 2.7f },
+    { 1.3375f, 0.0f, 2.53125f }, { 1.3375f, -0.749f, 2.53125f }, { 0.749f, -1.3375f, 2.53125f }, { 0.0f, -1.3375f, 2.53125f },
+    { 1.4375f, 0.0f, 2.53125f }, { 1.4375f, -0.805f, 2.53125f }, { 0.805f, -1.4375f, 2.53125f }, { 0.0f, -1.4375f, 2.53125f },
+    { 1.5f, 0.0f, 2.4f }, { 1.5f, -0.84f, 2.4f }, { 0.84f, -1.5f, 2.4f }, { 0.0f, -1.5f, 2.4f },
+    { 1.75f, 0.0f, 1.875f }, { 1.75f, -0.98f, 1.875f }, { 0.98f, -1.75f, 1.875f }, { 0.0f, -1.75f, 1.875f },
+    { 2.0f, 0.0f, 1.35f }, { 2.0f, -1.12f, 1.35f }, { 1.12f, -2.0f, 1.35f }, { 0.0f, -2.0f, 1.35f },
+    { 2.0f, 0.0f, 0.9f }, { 2.0f, -1.12f, 0.9f }, { 1.12f, -2.0f, 0.9f }, { 0.0f, -2.0f, 0.9f },
+    { -2.0f, 0.0f, 0.9f },
+    { 2.0f, 0.0f, 0.45f }, { 2.0f, -1.12f, 0.45f }, { 1.12f, -2.0f, 0.45f }, { 0.0f, -2.0f, 0.45f },
+    { 1.5f, 0.0f, 0.225f }, { 1.5f, -0.84f, 0.225f }, { 0.84f, -1.5f, 0.225f }, { 0.0f, -1.5f, 0.225f },
+    { 1.5f, 0.0f, 0.15f }, { 1.5f, -0.84f, 0.15f }, { 0.84f, -1.5f, 0.15f }, { 0.0f, -1.5f, 0.15f },
+    { -1.6f, 0.0f, 2.025f }, { -1.6f, -0.3f, 2.025f }, { -1.5f, -0.3f, 2.25f }, { -1.5f, 0.0f, 2.25f },
+    { -2.3f, 0.0f, 2.025f }, { -2.3f, -0.3f, 2.025f }, { -2.5f, -0.3f, 2.25f }, { -2.5f, 0.0f, 2.25f },
+    { -2.7f, 0.0f, 2.025f }, { -2.7f, -0.3f, 2.025f }, { -3.0f, -0.3f, 2.25f }, { -3.0f, 0.0f, 2.25f },
+    { -2.7f, 0.0f, 1.8f }, { -2.7f, -0.3f, 1.8f }, { -3.0f, -0.3f, 1.8f }, { -3.0f, 0.0f, 1.8f },
+    { -2.7f, 0.0f, 1.575f }, { -2.7f, -0.3f, 1.575f }, { -3.0f, -0.3f, 1.35f }, { -3.0f, 0.0f, 1.35f },
+    { -2.5f, 0.0f, 1.125f }, { -2.5f, -0.3f, 1.125f }, { -2.65f, -0.3f, 0.9375f }, { -2.65f, 0.0f, 0.9375f },
+    { -2.0f, -0.3f, 0.9f }, { -1.9f, -0.3f, 0.6f }, { -1.9f, 0.0f, 0.6f },
+    { 1.7f, 0.0f, 1.425f }, { 1.7f, -0.66f, 1.425f }, { 1.7f, -0.66f, 0.6f }, { 1.7f, 0.0f, 0.6f },
+    { 2.6f, 0.0f, 1.425f }, { 2.6f, -0.66f, 1.425f }, { 3.1f, -0.66f, 0.825f }, { 3.1f, 0.0f, 0.825f },
+    { 2.3f, 0.0f, 2.1f }, { 2.3f, -0.25f, 2.1f }, { 2.4f, -0.25f, 2.025f }, { 2.4f, 0.0f, 2.025f },
+    { 2.7f, 0.0f, 2.4f }, { 2.7f, -0.25f, 2.4f }, { 3.3f, -0.25f, 2.4f }, { 3.3f, 0.0f, 2.4f },
+    { 2.8f, 0.0f, 2.475f }, { 2.8f, -0.25f, 2.475f }, { 3.525f, -0.25f, 2.49375f }, { 3.525f, 0.0f, 2.49375f },
+    { 2.9f, 0.0f, 2.475f }, { 2.9f, -0.15f, 2.475f }, { 3.45f, -0.15f, 2.5125f }, { 3.45f, 0.0f, 2.5125f },
+    { 2.8f, 0.0f, 2.4f }, { 2.8f, -0.15f, 2.4f }, { 3.2f, -0.15f, 2.4f }, { 3.2f, 0.0f, 2.4f },
+    { 0.0f, 0.0f, 3.15f }, { 0.8f, 0.0f, 3.15f }, { 0.8f, -0.45f, 3.15f }, { 0.45f, -0.8f, 3.15f },
+    { 0.0f, -0.8f, 3.15f }, { 0.0f, 0.0f, 2.85f },
+    { 1.4f, 0.0f, 2.4f }, { 1.4f, -0.784f, 2.4f }, { 0.784f, -1.4f, 2.4f }, { 0.0f, -1.4f, 2.4f },
+    { 0.4f, 0.0f, 2.55f }, { 0.4f, -0.224f, 2.55f }, { 0.224f, -0.4f, 2.55f }, { 0.0f, -0.4f, 2.55f },
+    { 1.3f, 0.0f, 2.55f }, { 1.3f, -0.728f, 2.55f }, { 0.728f, -1.3f, 2.55f }, { 0.0f, -1.3f, 2.55f },
+    { 1.3f, 0.0f, 2.4f }, { 1.3f, -0.728f, 2.4f }, { 0.728f, -1.3f, 2.4f }, { 0.0f, -1.3f, 2.4f },
+    { 0.0f, 0.0f, 0.0f }, { 1.425f, -0.798f, 0.0f }, { 1.5f, 0.0f, 0.075f }, { 1.425f, 0.0f, 0.0f },
+    { 0.798f, -1.425f, 0.0f }, { 0.0f, -1.5f, 0.075f }, { 0.0f, -1.425f, 0.0f }, { 1.5f, -0.84f, 0.075f },
+    { 0.84f, -1.5f, 0.075f }
+};
+
+// Cubic Bezier basis and its derivative at t
+inline void bezierBasis(float t, float* b, float* d)
+{
+    float s = 1.0f - t;
+    b[0] = s * s * s;
+    b[1] = 3.0f * t * s * s;
+    b[2] = 3.0f * t * t * s;
+    b[3] = t * t * t;
+    d[0] = -3.0f * s * s;
+    d[1] = 3.0f * s * s - 6.0f * t * s;
+    d[2] = 6.0f * t * s - 3.0f * t * t;
+    d[3] = 3.0f * t * t;
+}
+
+// Tessellates one patch into a grid x grid quad mesh. Normals come from the
+// patch's partial derivatives, as with GL_AUTO_NORMAL; where those collapse
+// (the lid's pole) a point just inside the patch stands in.
+inline void addBezierPatch(RasterMesh& mesh, const Vec3 (&points)[4][4], int grid, float scale)
+{
+    uint32_t first = (uint32_t)mesh.positions.size();
+    for (int i = 0; i <= grid; ++i)
+        for (int j = 0; j <= grid; ++j)
+        {
+            float v = (float)i / grid, u = (float)j / grid;
+            Vec3 position = vec3(0, 0, 0), normal = vec3(0, 0, 0);
+            for (int attempt = 0; attempt < 2; ++attempt)
+            {
+                float bu[4], du[4], bv[4], dv[4];
+                bezierBasis(u, bu, du);
+                bezierBasis(v, bv, dv);
+                Vec3 tu = vec3(0, 0, 0), tv = vec3(0, 0, 0);
+                Vec3 p = vec3(0, 0, 0);
+                for (int r = 0; r < 4; ++r)
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        p = p + points[r][c] * (bv[r] * bu[c]);
+                        tu = tu + points[r][c] * (bv[r] * du[c]);
+                        tv = tv + points[r][c] * (dv[r] * bu[c]);
+                    }
+                if (attempt == 0)
+                    position = p;
+                normal = cross(tu, tv);
+                if (dot(normal, normal) > 1e-12f)
+                    break;
+                u = u * 0.98f + 0.01f;
+                v = v * 0.98f + 0.01f;
+            }
+            // Rotated -90 degrees about x, scaled and dropped onto its base as glutSolidTeapot does
+            Vec3 p = vec3(position.x, position.z - 1.5f, -position.y) * (0.5f * scale);
+            Vec3 n = normalize(vec3(normal.x, normal.z, -normal.y));
+            addVertex(mesh, p, n);
+        }
+    for (int i = 0; i < grid; ++i)
+        for (int j = 0; j < grid; ++j)
+        {
+            uint32_t a = first + i * (grid + 1) + j;
+            uint32_t b = a + grid + 1;
+            addQuad(mesh, a, a + 1, b + 1, b);
+        }
+}
+
+// glutSolidTeapot(size), each of the 32 patches tessellated grid x grid
+inline RasterMesh makeTeapotMesh(float size, int grid)
+{
+    RasterMesh mesh;
+    mesh.closed = true;
+    for (int patch = 0; patch < 10; ++patch)
+    {
+        // The handle and spout are only mirrored across y, everything else into all four quadrants
+        int copies = patch < 6 ? 4 : 2;
+        for (int copy = 0; copy < copies; ++copy)
+        {
+            float sx = (copy == 2 || copy == 3) ? -1.0f : 1.0f;
+            float sy = (copy == 1 || copy == 3) ? -1.0f : 1.0f;
+            bool reversed = sx * sy < 0.0f;     // mirrored once, so flip the winding back
+            Vec3 points[4][4];
+            for (int r = 0; r < 4; ++r)
+                for (int c = 0; c < 4; ++c)
+                {
+                    const float* p = kTeapotPoints[kTeapotPatches[patch][r * 4 + (reversed ? 3 - c : c)]];
+                    points[r][c] = vec3(p[0] * sx, p[1] * sy, p[2]);
+                }
+            addBezierPatch(mesh, points, grid, size);
+        }
+    }
+    return mesh;
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+// Ray casting against the simulation's primitive shapes, and a bounding
+// volume hierarchy over axis-aligned boxes to cull them. Shared by the LiDAR
+// and mouse picking. Directions are unit length; hits behind the origin, or
+// from inside a shape, don't count.
+
+#include "SimMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+inline bool intersectSphere(const Vec3& o, const Vec3& d, const Vec3& center, float radius, float& t)
+{
+    Vec3 oc = o - center;
+    float b = dot(oc, d);
+    float c = dot(oc, oc) - radius * radius;
+    float h = b * b - c;
+    if (h < 0.0f)
+        return false;
+    t = -b - std::sqrt(h);
+    return t > 0.0f;
+}
+
+// Ray against capsule (after Inigo Quilez), d must be unit length
+inline bool intersectCapsule(const Vec3& o, const Vec3& d, const Vec3& pa, const Vec3& pb, float radius, float& t)
+{
+    Vec3 ba = pb - pa, oa = o - pa;
+    float baba = dot(ba, ba);
+    if (baba < 1e-10f)
+        return intersectSphere(o, d, pa, radius, t);
+
+    float bard = dot(ba, d), baoa = dot(ba, oa), rdoa = dot(d, oa), oaoa = dot(oa, oa);
+    float a = baba - bard * bard;
+    float b = baba * rdoa - baoa * bard;
+    float c = baba * oaoa - baoa * baoa - radius * radius * baba;
+    float h = b * b - a * c;
+    if (h < 0.0f)
+        return false;
+
+    // With the ray parallel to the axis only the cap facing the origin can be hit
+    float y = baoa;
+    if (a > 1e-10f)
+    {
+        t = (-b - std::sqrt(h)) / a;
+        y = baoa + t * bard;
+        if (y > 0.0f && y < baba)
+            return t > 0.0f;
+    }
+
+    // Hemispherical caps
+    return intersectSphere(o, d, y <= 0.0f ? pa : pb, radius, t);
+}
+
+inline bool intersectBox(const Vec3& o, const Vec3& invD, const Vec3& lo, const Vec3& hi, float& t, Vec3& normal)
+{
+    float tx1 = (lo.x - o.x) * invD.x, tx2 = (hi.x - o.x) * invD.x;
+    float ty1 = (lo.y - o.y) * invD.y, ty2 = (hi.y - o.y) * invD.y;
+    float tz1 = (lo.z - o.z) * invD.z, tz2 = (hi.z - o.z) * invD.z;
+    float nx = std::min(tx1, tx2), ny = std::min(ty1, ty2), nz = std::min(tz1, tz2);
+    float tNear = std::max(nx, std::max(ny, nz));
+    float tFar = std::min(std::max(tx1, tx2), std::min(std::max(ty1, ty2), std::max(tz1, tz2)));
+    if (tNear > tFar || tNear <= 0.0f)
+        return false;
+
+    t = tNear;
+    if (tNear == nx)
+        normal = vec3(invD.x < 0.0f ? 1.0f : -1.0f, 0.0f, 0.0f);
+    else if (tNear == ny)
+        normal = vec3(0.0f, invD.y < 0.0f ? 1.0f : -1.0f, 0.0f);
+    else
+        normal = vec3(0.0f, 0.0f, invD.z < 0.0f ? 1.0f : -1.0f);
+    return true;
+}
+
+// Slab test, true if the ray enters box before tMax
+inline bool rayHitsAabb(const Vec3& o, const Vec3& invD, const Aabb& box, float tMax)
+{
+    float tx1 = (box.min.x - o.x) * invD.x, tx2 = (box.max.x - o.x) * invD.x;
+    float ty1 = (box.min.y - o.y) * invD.y, ty2 = (box.max.y - o.y) * invD.y;
+    float tz1 = (box.min.z - o.z) * invD.z, tz2 = (box.max.z - o.z) * invD.z;
+    float tNear = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), 0.0f));
+    float tFar = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), tMax));
+    return tNear <= tFar;
+}
+
+inline Vec3 reciprocal(const Vec3& d) { return vec3(1.0f / d.x, 1.0f / d.y, 1.0f / d.z); }
+
+// Median split on the longest centroid axis. Nodes are stored depth-first so
+// the left child directly follows its parent; leaves hold a range of order[],
+// the indices of the boxes passed to build().
+class Bvh
+{
+public:
+    struct Node
+    {
+        Aabb bounds;
+        int rightOrFirst;   // interior: index of the right child, leaf: first entry in order
+        int count;          // 0 for interior nodes
+    };
+
+    void build(const std::vector<Aabb>& boxes, int leafSize = 4)
+    {
+        nodes.clear();
+        order.resize(boxes.size());
+        if (boxes.empty())
+            return;
+
+        centroids.resize(boxes.size());
+        for (size_t i = 0; i < boxes.size(); ++i)
+        {
+            order[i] = (int)i;
+            centroids[i] = boxes[i].min + boxes[i].max;
+        }
+        nodes.reserve(boxes.size() * 2);
+        buildRange(boxes, 0, (int)boxes.size(), leafSize);
+    }
+
+    // Updates the node bounds for boxes that have moved, keeping the tree's
+    // shape. Much cheaper than build(), though the tree gets looser the further
+    // the boxes drift from where they were built. Children always come after
+    // their parent, so a reverse sweep sees them first.
+    void refit(const std::vector<Aabb>& boxes)
+    {
+        for (int i = (int)nodes.size() - 1; i >= 0; --i)
+        {
+            Node& node = nodes[i];
+            if (node.count == 0)
+            {
+                node.bounds = merge(nodes[i + 1].bounds, nodes[node.rightOrFirst].bounds);
+                continue;
+            }
+            Aabb bounds = boxes[order[node.rightOrFirst]];
+            for (int j = node.rightOrFirst + 1; j < node.rightOrFirst + node.count; ++j)
+                bounds = merge(bounds, boxes[order[j]]);
+            node.bounds = bounds;
+        }
+    }
+
+    bool empty() const { return nodes.empty(); }
+
+    std::vector<Node> nodes;
+    std::vector<int> order;
+
+private:
+    int buildRange(const std::vector<Aabb>& boxes, int first, int count, int leafSize)
+    {
+        int index = (int)nodes.size();
+        nodes.push_back(Node());
+
+        Aabb bounds = boxes[order[first]];
+        Aabb centroidBounds = { centroids[order[first]], centroids[order[first]] };
+        for (int i = first + 1; i < first + count; ++i)
+        {
+            bounds = merge(bounds, boxes[order[i]]);
+            centroidBounds.min = vmin(centroidBounds.min, centroids[order[i]]);
+            centroidBounds.max = vmax(centroidBounds.max, centroids[order[i]]);
+        }
+        nodes[index].bounds = bounds;
+
+        if (count <= leafSize)
+        {
+            nodes[index].rightOrFirst = first;
+            nodes[index].count = count;
+            return index;
+        }
+
+        Vec3 extent = centroidBounds.max - centroidBounds.min;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        int half = count / 2;
+        const std::vector<Vec3>& c = centroids;
+        std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+            [&c, axis](int l, int r) { return (&c[l].x)[axis] < (&c[r].x)[axis]; });
+
+        buildRange(boxes, first, half, leafSize);
+        int right = buildRange(boxes, first + half, count - half, leafSize);
+        nodes[index].rightOrFirst = right;
+        nodes[index].count = 0;
+        return index;
+    }
+
+    std::vector<Vec3> centroids;
+};
@@ -0,0 +1,1177 @@
+#include "RobotApp.h"
+
+#include <GL/freeglut.h>
+#include "imgui.h"
+#include "imgui_impl_glut.h"
+#include "imgui_impl_opengl2.h"
+
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+#include "Benchmark.h"
+#include "JobSystem.h"
+#include "RobotSim.h"
+#include "RobotBatch.h"
+#include "RobotSelfCollision.h"
+#include "RobotPicking.h"
+#include "HeadCameraSensor.h"
+#include "LidarSensor.h"
+#include "PathTracer.h"
+#include "InsetView.h"
+#include "FrameRecorder.h"
+#include "InputState.h"
+#include "PanelCache.h"
+#include "QualityGovernor.h"
+#include "SimulationLoop.h"
+#include "StateExchange.h"
+
+#ifdef DEBUG
+#include <iostream>
+#endif
+
+AppConfig appConfig;
+SelfCollisionChecker selfCollision;
+
+// Held movement keys, sampled once per simulation tick
+KeyboardState keys;
+MouseDelta mouseDelta;
+LatencyTracker inputLatency;
+PanelCache panelCache;
+
+// Input and movement run on the simulation thread at a fixed rate. It owns
+// its own copy of the state and publishes a snapshot every tick; the render
+// thread (GLUT's) draws the newest one and sends the panel's edits back.
+struct SimState
+{
+    World world;
+    float props[3][3];      // propPositions order
+};
+
+struct RenderSnapshot
+{
+    SimState state;
+    uint64_t appliedEdits;  // last panel edit folded in
+    double inputTime;       // inputClock() when the tick sampled the input
+};
+
+float simulationRate = 120.0f;
+TripleBuffer<RenderSnapshot> snapshots;
+TripleBuffer<StateEdits<SimState>::Message> editMessages;
+StateEdits<SimState> panelEdits;
+SimState frameState;            // render thread: this frame's state before the panel edited it
+SimState simState;              // simulation thread only from here on
+CollisionScene simCollision;
+uint64_t simAppliedEdits = 0;
+SimulationLoop simulation;      // last, so exit() stops it before the state above goes away
+
+// Mouse picking; the selection is highlighted and its sliders marked in the panel
+PickScene pickScene;
+PickResult selection;
+bool scrollToSelection = false;
+
+enum SliderGroup
+{
+    GROUP_NONE,
+    GROUP_POSITION,
+    GROUP_SHOULDER,
+    GROUP_ELBOW,
+    GROUP_WRIST,
+    GROUP_HEAD,
+    GROUP_LEGS
+};
+
+// Window size
+int windowWidth = 1280;
+int windowHeight = 720;
+bool show_help_window = false;
+bool blockSelfCollision = true;
+
+// Head-camera sensor stream, published to shared memory for other processes
+HeadCameraSensor headCamSensor;
+bool streamHeadCam = false;
+bool streamHeadCamDepth = true;
+bool streamHeadCamPoints = false;
+int headCamSensorWidth = 640;
+int headCamSensorHeight = 480;
+float headCamSensorRate = 30.0f;
+const char* headCamRingName = "/robot_headcam";
+
+// Simulated head LiDAR, sweeps appended to a binary scan file
+LidarSensor lidar;
+LidarScan lidarScan;
+LidarScanWriter lidarWriter;
+bool recordLidar = false;
+const char* lidarScanPath = "lidar_scans.bin";
+
+// Picture-in-picture inset showing whichever camera the main view isn't using
+InsetView insetView;
+bool showInset = false;
+int insetWidth = 320;
+int insetHeight = 240;
+float insetRate = 15.0f;
+
+// Main-view recording to an uncompressed Y4M file
+FrameRecorder frameRecorder;
+bool recordVideo = false;
+int recordInterval = 1;
+const char* recordingPath = "recording.y4m";
+
+// Offline path-traced reference of the main view, refined in the background
+PathTracer pathTracer;
+int pathTraceSamples = 256;
+const char* pathTracePath = "pathtrace.ppm";
+
+// Quality governor: trades detail for frame time to hold the budget. Below
+// full resolution the main view renders offscreen and is scaled up.
+QualityGovernor governor;
+InsetView scaledView;
+double lastFrameStart = -1.0;
+
+// Share of the last frame each job system worker spent running jobs
+std::vector<float> workerUtilisation;
+
+// Render benchmark: swap-to-swap frame times and the scripted walk's position
+std::vector<double> benchmarkFrameTimes;
+double lastFrameEnd = -1.0;
+unsigned benchmarkStep = 0;
+
+ImFont* smallFont, * font;
+
+// Selects the link or prop under the cursor by casting a ray from the main view
+void pickAt(int x, int y)
+{
+    glm::vec3 eye, target;
+    if (world.useHeadCam)
+        computeHeadCamera(eye, target);
+    else
+        computeOrbitCamera(eye, target);
+
+    static std::vector<RobotLinks> robots(1);
+    computeRobotLinks(world, robots[0]);
+    pickScene.setProps(collisionScene.props);
+    pickScene.setRobots(robots);
+
+    float ndcX = 2.0f * (x + 0.5f) / windowWidth - 1.0f;
+    float ndcY = 1.0f - 2.0f * (y + 0.5f) / windowHeight;
+    Vec3 origin, direction;
+    pickRay(vec3(eye.x, eye.y, eye.z), vec3(target.x - eye.x, target.y - eye.y, target.z - eye.z), 45.0f, (float)windowWidth / (float)windowHeight, ndcX, ndcY, origin, direction);
+    selection = pickScene.pick(origin, direction);
+    scrollToSelection = true;
+}
+
+// Captures the main view as it is now and path-traces it at the window's size
+void startPathTrace()
+{
+    glm::vec3 eye, target;
+    if (world.useHeadCam)
+        computeHeadCamera(eye, target);
+    else
+        computeOrbitCamera(eye, target);
+
+    capturePathTraceScene(pathTracer, world.useHeadCam);
+    pathTracer.setCamera(vec3(eye.x, eye.y, eye.z), vec3(target.x, target.y, target.z), 45.0f, windowWidth, windowHeight);
+    pathTracer.start(pathTraceSamples, pathTracePath);
+}
+
+SliderGroup selectedGroup()
+{
+    if (selection.kind != PICK_LINK)
+        return GROUP_NONE;
+    switch (selection.index)
+    {
+    case LINK_PELVIS: case LINK_TORSO: return GROUP_POSITION;
+    case LINK_SHOULDER: case LINK_UPPER_ARM: return GROUP_SHOULDER;
+    case LINK_ELBOW: case LINK_FOREARM: return GROUP_ELBOW;
+    case LINK_WRIST: case LINK_HAND: return GROUP_WRIST;
+    case LINK_NECK: case LINK_HEAD: return GROUP_HEAD;
+    default: return GROUP_LEGS;
+    }
+}
+
+// Slider section title, highlighted and scrolled into view when the picked
+// link is driven by its sliders
+void groupLabel(const char* label, SliderGroup group)
+{
+    if (group != selectedGroup())
+    {
+        ImGui::Text("%s", label);
+        return;
+    }
+    ImGui::TextColored(ImVec4(1.0f, 0.85f, 0.0f, 1.0f), "%s", label);
+    if (scrollToSelection)
+    {
+        ImGui::SetScrollHereY(0.0f);
+        scrollToSelection = false;
+    }
+}
+
+// Outlines the selected link or prop with its bounding box
+void drawSelection()
+{
+    Aabb box;
+    if (selection.kind == PICK_LINK)
+    {
+        RobotLinks links;
+        computeRobotLinks(world, links);
+        box = capsuleBounds(links.links[selection.index]);
+    }
+    else if (selection.kind == PICK_PROP)
+    {
+        box = propBounds(collisionScene.props[selection.index]);
+    }
+    else
+    {
+        return;
+    }
+
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_LINE_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_TEXTURE_2D);
+    glLineWidth(2.0f);
+    glColor3f(1.0f, 0.85f, 0.0f);
+
+    // Corner i takes max on each axis whose bit is set; edges join corners one bit apart
+    glBegin(GL_LINES);
+    for (int i = 0; i < 8; ++i)
+        for (int bit = 1; bit < 8; bit <<= 1)
+        {
+            if (i & bit)
+                continue;
+            int j = i | bit;
+            glVertex3f((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+            glVertex3f((j & 1) ? box.max.x : box.min.x, (j & 2) ? box.max.y : box.min.y, (j & 4) ? box.max.z : box.min.z);
+        }
+    glEnd();
+
+    glPopAttrib();
+}
+
+// Collapsible panel section. A collapsed section submits none of its
+// widgets, so it costs nothing; reveal opens it, e.g. to show the sliders
+// for a picked link.
+bool panelSection(const char* label, bool openByDefault, bool reveal = false)
+{
+    if (reveal)
+        ImGui::SetNextItemOpen(true);
+    return ImGui::CollapsingHeader(label, openByDefault ? ImGuiTreeNodeFlags_DefaultOpen : 0);
+}
+
+// How busy each job system worker was over the last frame, eight to a line
+void drawWorkerUtilisation()
+{
+    std::vector<JobSystem::WorkerStats> stats;
+    JobSystem::shared().stats(stats);
+    unsigned long long jobs = 0, steals = 0;
+    for (const JobSystem::WorkerStats& worker : stats)
+    {
+        jobs += worker.jobs;
+        steals += worker.steals;
+    }
+    ImGui::Text("%zu workers, %llu jobs, %llu stolen", stats.size(), jobs, steals);
+
+    char line[128];
+    size_t used = 0;
+    for (size_t i = 0; i < workerUtilisation.size(); ++i)
+    {
+        used += snprintf(line + used, sizeof(line) - used, "%3.0f%% ", workerUtilisation[i] * 100.0f);
+        if (i % 8 == 7 || i + 1 == workerUtilisation.size())
+        {
+            ImGui::Text("%s", line);
+            used = 0;
+        }
+    }
+}
+
+void drawControlPanel()
+{
+    ImGui::SetNextWindowPos(ImVec2(windowWidth - 300, 0));
+    ImGui::SetNextWindowSize(ImVec2(300, windowHeight));
+    ImGui::Begin("Robot Control", NULL, ImGuiWindowFlags_NoMove);
+
+    if (selection.kind == PICK_LINK)
+        ImGui::Text("Selected: %s", robotLinkName(selection.index));
+    else if (selection.kind == PICK_PROP)
+        ImGui::Text("Selected: %s", propNames[selection.index]);
+    else
+        ImGui::Text("Click a link or prop to select it");
+    if (selection.kind == PICK_PROP)
+    {
+        ImGui::PushFont(smallFont);
+        if (ImGui::SliderFloat3("##Prop Position", propPositions[selection.index], -15.0f, 15.0f))
+            buildCollisionScene();
+        ImGui::PopFont();
+    }
+    ImGui::Dummy(ImVec2(0.0f, 7.0f));
+
+    if (panelSection("Robot", true, scrollToSelection && selection.kind == PICK_LINK))
+    {
+        groupLabel("Robot Position", GROUP_POSITION);
+        ImGui::PushFont(smallFont);
+        ImGui::Text("X");
+        ImGui::SameLine();
+        ImGui::SliderFloat("##Robot Position X", &world.robot.x, -10.0f, 10.0f);
+        ImGui::Text("Y");
+        ImGui::SameLine();
+        ImGui::SliderFloat("##Robot Position Y", &world.robot.y, -10.0f, 10.0f);
+        ImGui::Text("Z");
+        ImGui::SameLine();
+        ImGui::SliderFloat("##Robot Position Z", &world.robot.z, -10.0f, 10.0f);
+        ImGui::Text("Input latency %.1f ms (avg %.1f, max %.1f)", inputLatency.last * 1e3, inputLatency.average * 1e3, inputLatency.worst * 1e3);
+        if (simulation.running())
+            ImGui::Text("Simulation %.0f Hz, tick %.2f ms, %llu late", simulation.rate, simulation.tickSeconds * 1e3, simulation.lateTicks.load());
+        ImGui::PopFont();
+
+        ImGui::Dummy(ImVec2(0.0f, 7.0f));
+        ImGui::Text("Right-hand Angles");
+        ImGui::PushFont(smallFont);
+        World armBefore = world;
+        bool armChanged = false;
+        groupLabel("Shoulder", GROUP_SHOULDER);
+        ImGui::Text("Pitch"); ImGui::SameLine();
+        armChanged |= ImGui::SliderFloat("##Shoulder Pitch", &world.shoulderPitch, -180.0f, 180.0f);
+        ImGui::Text("Yaw"); ImGui::SameLine();
+        armChanged |= ImGui::SliderFloat("##Shoulder Yaw", &world.shoulderYaw, -180.0f, 180.0f);
+        ImGui::Text("Roll"); ImGui::SameLine();
+        armChanged |= ImGui::SliderFloat("##Shoulder Roll", &world.shoulderRoll, -180.0f, 180.0f);
+        groupLabel("Elbow", GROUP_ELBOW);
+        ImGui::Text("Pitch"); ImGui::SameLine();
+        armChanged |= ImGui::SliderFloat("##Elbow Pitch", &world.elbowPitch, -180.0f, 180.0f);
+        ImGui::Text("Yaw"); ImGui::SameLine();
+        armChanged |= ImGui::SliderFloat("##Elbow Yaw", &world.elbowYaw, -180.0f, 180.0f);
+        ImGui::Text("Roll"); ImGui::SameLine();
+        armChanged |= ImGui::SliderFloat("##Elbow Roll", &world.elbowRoll, -180.0f, 180.0f);
+        groupLabel("Wrist", GROUP_WRIST);
+        ImGui::Text("Pitch"); ImGui::SameLine();
+        armChanged |= ImGui::SliderFloat("##Wrist Pitch", &world.wristPitch, -180.0f, 180.0f);
+        ImGui::Text("Yaw"); ImGui::SameLine();
+        armChanged |= ImGui::SliderFloat("##Wrist Yaw", &world.wristYaw, -180.0f, 180.0f);
+        ImGui::Text("Roll"); ImGui::SameLine();
+        armChanged |= ImGui::SliderFloat("##Wrist Roll", &world.wristRoll, -180.0f, 180.0f);
+
+        // Reject slider moves that drive the arm into the body
+        SelfCollisionResult selfHit = selfCollision.query(world);
+        if (armChanged && blockSelfCollision && selfHit.colliding && !selfCollision.colliding(armBefore))
+        {
+            copyArmPose(world, armBefore);
+            selfHit = selfCollision.query(world);
+        }
+        ImGui::Checkbox("Block Self-Collision", &blockSelfCollision);
+        if (selfHit.colliding)
+            ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Self-collision: %s / %s", robotLinkName(selfHit.armLink), robotLinkName(selfHit.bodyLink));
+        else
+            ImGui::Text("Clearance %.2f (%s / %s)", selfHit.distance, robotLinkName(selfHit.armLink), robotLinkName(selfHit.bodyLink));
+        ImGui::PopFont();
+
+        ImGui::Dummy(ImVec2(0.0f, 7.0f));
+        groupLabel("Head", GROUP_HEAD);
+        ImGui::PushFont(smallFont);
+        ImGui::Text("Yaw");
+        ImGui::SameLine();
+        ImGui::SliderFloat("##Head Yaw", &world.headYaw, -60.0f, 60.0f);
+        ImGui::Text("Pitch");
+        ImGui::SameLine();
+        ImGui::SliderFloat("##Head Pitch", &world.headPitch, -35.0f, 15.0f);
+        ImGui::PopFont();
+
+        ImGui::Dummy(ImVec2(0.0f, 7.0f));
+        groupLabel("Leg Angles", GROUP_LEGS);
+        ImGui::PushFont(smallFont);
+        ImGui::Text("Hip");
+        ImGui::Text("Left Hip Angle");
+        ImGui::SameLine();
+        ImGui::SliderFloat("##Left Hip Angle", &world.robot.leftHipAngle, -90.0f, 90.0f);
+        ImGui::Text("Right Hip Angle");
+        ImGui::SameLine();
+        ImGui::SliderFloat("##Right Hip Angle", &world.robot.rightHipAngle, -90.0f, 90.0f);
+        ImGui::Text("Knee");
+        ImGui::Text("Left Knee Angle");
+        ImGui::SameLine();
+        ImGui::SliderFloat("##Left Knee Angle", &world.robot.leftKneeAngle, -90.0f, 90.0f);
+        ImGui::Text("Right Knee Angle");
+        ImGui::SameLine();
+        ImGui::SliderFloat("##Right Knee Angle", &world.robot.rightKneeAngle, -90.0f, 90.0f);
+        ImGui::PopFont();
+    }
+
+    if (panelSection("Camera", false))
+    {
+        ImGui::PushFont(smallFont);
+        ImGui::Text("X");
+        ImGui::SameLine();
+        ImGui::SliderFloat("##Camera Position X", &world.camX, -20.0f, 20.0f);
+        ImGui::Text("Y");
+        ImGui::SameLine();
+        ImGui::SliderFloat("##Camera Position Y", &world.camY, -20.0f, 20.0f);
+        ImGui::Text("Z");
+        ImGui::SameLine();
+        ImGui::SliderFloat("##Camera Position Z", &world.camZ, 0.0f, 50.0f);
+        ImGui::PopFont();
+    }
+
+    if (panelSection("Lighting", false))
+    {
+        ImGui::Text("Light Position");
+        ImGui::PushFont(smallFont);
+        ImGui::Text("X");
+        ImGui::SameLine();
+        ImGui::SliderFloat("##Light Position X", &world.lightPos[0], -10.0f, 10.0f);
+        ImGui::Text("Y");
+        ImGui::SameLine();
+        ImGui::SliderFloat("##Light Position Y", &world.lightPos[1], -10.0f, 10.0f);
+        ImGui::Text("Z");
+        ImGui::SameLine();
+        ImGui::SliderFloat("##Light Position Z", &world.lightPos[2], -10.0f, 10.0f);
+        ImGui::Text("W");
+        ImGui::SameLine();
+        ImGui::SliderFloat("##Light Position W", &world.lightPos[3], -10.0f, 10.0f);
+
+        ImGui::Text("Light Angle");
+        ImGui::SameLine();
+        ImGui::SliderFloat("##Light Angle", &world.lightAngle, 0.0f, 360.0f);
+        ImGui::PopFont();
+
+        ImGui::Dummy(ImVec2(0.0f, 2.0f));
+        ImGui::Text("Ambient Strength");
+        ImGui::PushFont(smallFont);
+        ImGui::SliderFloat("##Ambient Strength", &world.ambientStrength, 0.0f, 1.0f);
+        ImGui::PopFont();
+        ImGui::Dummy(ImVec2(0.0f, 2.0f));
+        ImGui::Text("Point Light Intensity");
+        ImGui::PushFont(smallFont);
+        ImGui::SliderFloat("##Point Light Intensity", &world.pointLightIntensity, 0.0f, 1.0f);
+        ImGui::PopFont();
+        ImGui::Dummy(ImVec2(0.0f, 2.0f));
+        ImGui::Text("Shadow Strength");
+        ImGui::PushFont(smallFont);
+        ImGui::SliderFloat("##Shadow Strength", &world.shadowStrength, 0.0f, 1.0f);
+        ImGui::PopFont();
+    }
+
+    if (panelSection("Materials", false))
+    {
+        ImGui::Text("Floor Material");
+        ImGui::PushFont(smallFont);
+        ImGui::ColorEdit3("Floor Specular", world.floorSpecular);
+        ImGui::SliderFloat("Floor Shininess", &world.floorShininess, 1.0f, 128.0f);  // Corrected the range
+        ImGui::PopFont();
+
+        ImGui::Separator();
+
+        ImGui::Text("Plastic Sphere Material");
+        ImGui::PushFont(smallFont);
+        ImGui::ColorEdit3("Specular", world.plasticSpecular);
+        ImGui::SliderFloat("Shininess", &world.plasticShininess, 1.0f, 128.0f);
+        ImGui::PopFont();
+
+        ImGui::Text("Teapot Material");
+        ImGui::PushFont(smallFont);
+        ImGui::ColorEdit3("Teapot Specular", world.teapotSpecular);
+        ImGui::SliderFloat("Teapot Shininess", &world.teapotShininess, 1.0f, 200.0f);
+        ImGui::SliderFloat("Teapot Reflectivity", &world.teapotReflectivity, 0.0f, 1.0f);
+        ImGui::PopFont();
+
+        ImGui::Text("Robot Material");
+        ImGui::PushFont(smallFont);
+        ImGui::ColorEdit3("Robot Specular", world.robotSpecular);
+        ImGui::SliderFloat("Robot Shininess", &world.robotShininess, 1.0f, 128.0f);
+        ImGui::PopFont();
+
+        ImGui::Text("Cube Material");
+        ImGui::PushFont(smallFont);
+        ImGui::ColorEdit3("Cube Specular", world.cubeSpecular);
+        ImGui::SliderFloat("Cube Shininess", &world.cubeShininess, 1.0f, 128.0f);
+        ImGui::PopFont();
+    }
+
+    if (panelSection("Quality", true))
+    {
+        ImGui::Checkbox("Adaptive Quality", &governor.enabled);
+        float budgetMs = (float)(governor.budget * 1e3);
+        ImGui::Text("Frame Budget");
+        ImGui::PushFont(smallFont);
+        if (ImGui::SliderFloat("##Frame Budget", &budgetMs, 5.0f, 100.0f, "%.1f ms"))
+            governor.budget = budgetMs * 1e-3;
+        const QualityLevel& quality = governor.settings();
+        ImGui::Text("%s: %.1f ms per frame", quality.name, governor.averageFrameTime() * 1e3);
+        ImGui::Text("Scale %.0f%%, %d slices, reflection %d px", quality.renderScale * 100.0f, quality.tessellation, quality.reflectionSize);
+        double clock = benchmarkClock();
+        for (auto change = governor.log().rbegin(); change != governor.log().rend(); ++change)
+            ImGui::Text("%.0f s ago: %s -> %s at %.1f ms", clock - change->time, QualityGovernor::levelSettings(change->from).name,
+                QualityGovernor::levelSettings(change->to).name, change->frameTime * 1e3);
+        drawWorkerUtilisation();
+        if (terrainActive())
+        {
+            size_t resident, building, drawn, triangles;
+            terrainStatistics(resident, building, drawn, triangles);
+            ImGui::Text("Terrain: %zu chunks loaded, %zu building", resident, building);
+            ImGui::Text("%zu chunks, %zu triangles drawn", drawn, triangles);
+        }
+        ImGui::PopFont();
+    }
+
+    if (panelSection("Views & Recording", true))
+    {
+        if (sceneConfig.reflection)
+            ImGui::Checkbox("Enable Reflection", &world.enableReflection);
+
+        ImGui::Checkbox("Use Head Camera", &world.useHeadCam);
+        ImGui::Checkbox("Software Rasterizer", &sceneConfig.softwareRaster);
+        ImGui::Checkbox("Teapot Reflection", &sceneConfig.teapotReflection);
+        ImGui::Checkbox("Sky Ambient", &sceneConfig.skyAmbient);
+        ImGui::Checkbox("Shadows", &sceneConfig.shadows);
+        ImGui::Checkbox("Baked Lighting", &sceneConfig.bakedLighting);
+        if (sceneConfig.bakedLighting && !sceneConfig.softwareRaster && !bakedLightingReady())
+        {
+            ImGui::PushFont(smallFont);
+            ImGui::Text("Baking lighting, %d%%", (int)(bakedLightingProgress() * 100.0f));
+            ImGui::PopFont();
+        }
+
+        if (ImGui::Checkbox("Picture-in-Picture", &showInset))
+        {
+            if (showInset)
+                showInset = insetView.init(insetWidth, insetHeight, insetRate);
+            else
+                insetView.shutdown();
+        }
+        if (showInset)
+        {
+            ImGui::PushFont(smallFont);
+            ImGui::Text("%s inset, %dx%d", world.useHeadCam ? "Orbit" : "Head", insetView.width, insetView.height);
+            ImGui::Text("Rate"); ImGui::SameLine();
+            ImGui::SliderFloat("##Inset Rate", &insetView.rate, 1.0f, 60.0f, "%.0f Hz");
+            ImGui::PopFont();
+        }
+
+        if (ImGui::Checkbox("Stream Head Camera", &streamHeadCam))
+        {
+            if (streamHeadCam)
+                streamHeadCam = headCamSensor.init(headCamSensorWidth, headCamSensorHeight, headCamSensorRate, headCamRingName, streamHeadCamDepth, streamHeadCamPoints);
+            else
+                headCamSensor.shutdown();
+        }
+        ImGui::PushFont(smallFont);
+        if (streamHeadCam)
+        {
+            ImGui::Text("%dx%d @ %.0f Hz, %llu frames", headCamSensor.width, headCamSensor.height, headCamSensor.rate, (unsigned long long)headCamSensor.framesPublished());
+            ImGui::Text("Depth: %s, Points: %s", headCamSensor.depthEnabled ? "on" : "off", headCamSensor.pointsEnabled ? "on" : "off");
+        }
+        else
+        {
+            ImGui::Checkbox("Depth", &streamHeadCamDepth);
+            ImGui::SameLine();
+            ImGui::Checkbox("Point Cloud", &streamHeadCamPoints);
+        }
+        ImGui::PopFont();
+
+        if (ImGui::Checkbox("Record Video", &recordVideo))
+        {
+            if (recordVideo)
+                recordVideo = frameRecorder.start(recordingPath, windowWidth, windowHeight, recordInterval, 60);
+            else
+                frameRecorder.stop();
+        }
+        ImGui::PushFont(smallFont);
+        if (recordVideo)
+        {
+            ImGui::Text("%dx%d, every %d frame(s)", frameRecorder.width, frameRecorder.height, frameRecorder.interval);
+            ImGui::Text("%llu written, %llu dropped", (unsigned long long)frameRecorder.framesWritten(), (unsigned long long)frameRecorder.framesDropped());
+        }
+        else
+        {
+            ImGui::Text("Every Nth"); ImGui::SameLine();
+            ImGui::SliderInt("##Record Interval", &recordInterval, 1, 10);
+        }
+        ImGui::PopFont();
+
+        if (ImGui::Checkbox("Record LiDAR", &recordLidar))
+        {
+            if (recordLidar)
+                recordLidar = lidarWriter.open(lidarScanPath);
+            else
+                lidarWriter.close();
+        }
+        if (recordLidar)
+        {
+            ImGui::PushFont(smallFont);
+            ImGui::Text("%dx%d @ %.0f Hz, %llu scans", lidar.settings().channels, lidar.settings().columns, lidar.settings().rate, (unsigned long long)lidarWriter.scansWritten);
+            ImGui::PopFont();
+        }
+
+        if (pathTracer.running())
+        {
+            ImGui::PushFont(smallFont);
+            ImGui::Text("%d / %d samples, %.2f M samples/s", pathTracer.samples(), pathTracer.targetSamples(), pathTracer.samplesPerSecond() * 1e-6);
+            ImGui::PopFont();
+            if (ImGui::Button("Stop Path Trace"))
+                pathTracer.stop();
+        }
+        else
+        {
+            if (ImGui::Button("Path Trace View"))
+                startPathTrace();
+            ImGui::PushFont(smallFont);
+            ImGui::Text("Samples"); ImGui::SameLine();
+            ImGui::SliderInt("##Path Trace Samples", &pathTraceSamples, 1, 1024);
+            ImGui::PopFont();
+        }
+    }
+
+    ImGui::Separator();
+
+    ImGui::Checkbox("Throttle Panel", &panelCache.throttle);
+    if (panelCache.throttle)
+    {
+        ImGui::PushFont(smallFont);
+        ImGui::Text("Idle Rate"); ImGui::SameLine();
+        ImGui::SliderFloat("##Panel Idle Rate", &panelCache.idleRate, 1.0f, 30.0f, "%.0f Hz");
+        ImGui::PopFont();
+    }
+
+    ImGui::Separator();
+
+    if (ImGui::Button("Help"))
+    {
+        show_help_window = true;
+    }
+    ImGui::SameLine();
+    ImGui::Dummy(ImVec2(7.0f, 0.0f));
+    ImGui::SameLine();
+    if (ImGui::Button("Quit"))
+    {
+        exit(0);
+    }
+    ImGui::End();
+
+    if (show_help_window)
+    {
+        ImGui::Begin("Help", &show_help_window);
+        ImGui::Text("Controls:");
+        ImGui::BulletText("W / S: Walk Forward / Backward");
+        ImGui::BulletText("A / D: Walk Left / Right");
+        ImGui::BulletText("Use mouse to control the robot's head");
+        ImGui::BulletText("Use the sliders to adjust robot parts and camera");
+        ImGui::End();
+    }
+}
+
+void updateMouseLook(World& state)
+{
+    float dx, dy;
+    if (!mouseDelta.take(dx, dy))
+        return;
+
+    const float sensitivity = 0.1f;
+    float& yaw = state.useHeadCam ? state.headCamYaw : state.headYaw;
+    float& pitch = state.useHeadCam ? state.headCamPitch : state.headPitch;
+    yaw = std::min(std::max(yaw + dx * sensitivity, -60.0f), 60.0f);
+    pitch = std::min(std::max(pitch + dy * sensitivity, -35.0f), 15.0f);
+}
+
+void updateMovement(World& state, float dt)
+{
+    if (appConfig.benchmarkFrames > 0)
+    {
+        // Fixed script and step so every benchmark run renders the same frames
+        const unsigned script[] = { INPUT_FORWARD, INPUT_FORWARD | INPUT_RIGHT, INPUT_RIGHT, INPUT_BACKWARD, INPUT_LEFT, 0 };
+        moveRobotInput(state, script[benchmarkStep++ / 60 % 6], 1.0f / 60.0f, simCollision);
+        return;
+    }
+    moveRobotInput(state, keys.sample(), dt, simCollision);
+}
+
+void publishSnapshot(double inputTime)
+{
+    RenderSnapshot& snapshot = snapshots.back();
+    snapshot.state = simState;
+    snapshot.appliedEdits = simAppliedEdits;
+    snapshot.inputTime = inputTime;
+    snapshots.publish();
+}
+
+void rebuildSimCollision()
+{
+    const float* positions[3] = { simState.props[0], simState.props[1], simState.props[2] };
+    buildPropCollision(simCollision, positions);
+}
+
+// One step of the control loop, on the simulation thread. Panel edits made
+// since the last tick win over the simulation's own values.
+void simulationTick(float dt)
+{
+    float props[3][3];
+    memcpy(props, simState.props, sizeof(props));
+    if (editMessages.update() && StateEdits<SimState>::apply(editMessages.front(), simState, simAppliedEdits) &&
+        memcmp(props, simState.props, sizeof(props)) != 0)
+        rebuildSimCollision();
+
+    World& state = simState.world;
+    updateLightPosition(state);
+    updateMouseLook(state);
+    double inputTime = inputClock();
+    updateMovement(state, dt);
+    stepAnimation(state.robot);
+    if (terrainActive())
+        placeOnGround(state, groundHeight);
+    publishSnapshot(inputTime);
+}
+
+// Render thread: takes the newest snapshot into the scene's globals, with
+// the panel edits the simulation hasn't applied yet on top
+void receiveSnapshot()
+{
+    snapshots.update();
+    const RenderSnapshot& snapshot = snapshots.front();
+    SimState state = snapshot.state;
+    panelEdits.overlay(state, snapshot.appliedEdits);
+
+    bool propsMoved = false;
+    for (int i = 0; i < 3; ++i)
+        propsMoved = propsMoved || memcmp(propPositions[i], state.props[i], sizeof(state.props[i])) != 0;
+    world = state.world;
+    for (int i = 0; i < 3; ++i)
+        memcpy(propPositions[i], state.props[i], sizeof(state.props[i]));
+    if (propsMoved)
+        buildCollisionScene();
+
+    frameState = state;
+    inputLatency.sampled(snapshot.inputTime);
+}
+
+// Render thread: sends whatever the panel changed this frame
+void sendPanelEdits()
+{
+    SimState state;
+    state.world = world;
+    for (int i = 0; i < 3; ++i)
+        memcpy(state.props[i], propPositions[i], sizeof(state.props[i]));
+    if (!panelEdits.record(frameState, state))
+        return;
+    panelEdits.message(editMessages.back());
+    editMessages.publish();
+}
+
+// Hands the governor's level to the scene and the panel; the render scale is
+// read every frame
+void applyQuality()
+{
+    const QualityLevel& quality = governor.settings();
+    sceneConfig.tessellation = quality.tessellation;
+    sceneConfig.teapotProbeSize = quality.reflectionSize;
+    sceneConfig.teapotProbeRate = quality.reflectionRate;
+    sceneConfig.dropReflection = !quality.floorReflection;
+    panelCache.idleRate = quality.panelRate;
+    panelCache.touch();
+}
+
+void updateQuality()
+{
+    double now = benchmarkClock();
+    double frameTime = lastFrameStart >= 0.0 ? now - lastFrameStart : 0.0;
+    lastFrameStart = now;
+    if (!governor.update(now, frameTime))
+        return;
+
+    applyQuality();
+#ifdef DEBUG
+    const QualityGovernor::Change& change = governor.log().back();
+    std::cerr << "Quality " << QualityGovernor::levelSettings(change.from).name << " -> " << governor.settings().name
+              << " at " << change.frameTime * 1e3 << " ms per frame, budget " << governor.budget * 1e3 << " ms" << std::endl;
+#endif
+}
+
+// Times each frame from one swap to the next and stops the main loop once
+// the benchmark has its frames
+void recordBenchmarkFrame()
+{
+    double now = benchmarkClock();
+    if (lastFrameEnd >= 0.0)
+        benchmarkFrameTimes.push_back(now - lastFrameEnd);
+    lastFrameEnd = now;
+
+    if ((int)benchmarkFrameTimes.size() >= appConfig.benchmarkFrames)
+    {
+        printTimings(sceneConfig.softwareRaster ? "frame (software)" : sceneConfig.reflection ? "frame (reflect)" : "frame", summarizeTimings(benchmarkFrameTimes));
+        glutLeaveMainLoop();
+    }
+}
+
+void display()
+{
+    double now = glutGet(GLUT_ELAPSED_TIME) * 0.001;
+    updateQuality();
+    JobSystem::shared().utilisation(workerUtilisation);
+
+    // Benchmarks step the simulation once per frame instead, so every run
+    // renders the same frames
+    if (appConfig.benchmarkFrames > 0)
+        simulationTick(1.0f / 60.0f);
+    receiveSnapshot();
+
+    // Per-frame work shared by every view: both camera poses and the light colours
+    glm::vec3 headEye, headTarget;
+    computeHeadCamera(headEye, headTarget);
+    glm::vec3 orbitEye, orbitTarget;
+    computeOrbitCamera(orbitEye, orbitTarget);
+    updateTerrain(world.useHeadCam ? headEye : orbitEye);
+    setupLighting();
+    updateBakedLighting();
+    updateShadowMap();
+    updateTeapotReflection(now);
+
+    if (streamHeadCam && headCamSensor.due(now))
+    {
+        DepthCameraModel model = makeDepthCameraModel(world, headCamSensor.width, headCamSensor.height, headCamSensor.fovY, headCamSensor.nearPlane, headCamSensor.farPlane);
+        headCamSensor.capture(now, model, [&]()
+        {
+            drawView(headEye, headTarget, headCamSensor.fovY, (float)headCamSensor.width / (float)headCamSensor.height, headCamSensor.nearPlane, headCamSensor.farPlane, true);
+        });
+    }
+
+    if (showInset && insetView.due(now))
+    {
+        insetView.render(now, [&]()
+        {
+            float aspect = (float)insetView.width / (float)insetView.height;
+            if (world.useHeadCam)
+                drawView(orbitEye, orbitTarget, 45.0f, aspect, 0.1f, 1000.0f, false);
+            else
+                drawView(headEye, headTarget, 45.0f, aspect, 0.1f, 1000.0f, true);
+        });
+    }
+
+    float aspect = (float)windowWidth / (float)windowHeight;
+    auto drawMainView = [&]()
+    {
+        if (world.useHeadCam)
+            drawView(headEye, headTarget, 45.0f, aspect, 0.1f, 1000.0f, true);
+        else
+            drawView(orbitEye, orbitTarget, 45.0f, aspect, 0.1f, 1000.0f, false);
+        drawSelection();
+    };
+
+    glEnable(GL_DEPTH_TEST);
+    float scale = governor.settings().renderScale;
+    int scaledWidth = std::max((int)(windowWidth * scale), 1), scaledHeight = std::max((int)(windowHeight * scale), 1);
+    bool scaled = scale < 1.0f;
+    if (scaled && (!scaledView.isActive() || scaledView.width != scaledWidth || scaledView.height != scaledHeight))
+        scaled = scaledView.init(scaledWidth, scaledHeight, 0.0f);
+    if (scaled)
+    {
+        scaledView.render(now, drawMainView);
+        scaledView.present(0, 0, windowWidth, windowHeight, false);
+    }
+    else
+    {
+        scaledView.shutdown();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | (sceneConfig.reflection ? GL_STENCIL_BUFFER_BIT : 0));
+        drawMainView();
+    }
+
+    // Inset in the bottom-left corner, left of the control panel
+    if (showInset)
+    {
+        int presentHeight = windowHeight / 4;
+        int presentWidth = presentHeight * insetView.width / insetView.height;
+        insetView.present(12, 12, presentWidth, presentHeight);
+    }
+
+    // The panel is only rebuilt when it's due; other frames redraw its cached buffers
+    if (panelCache.due(now))
+    {
+        ImGui_ImplOpenGL2_NewFrame();
+        ImGui_ImplGLUT_NewFrame();
+        ImGui::NewFrame();
+        drawControlPanel();
+        ImGui::Render();
+        panelCache.upload(now, ImGui::GetDrawData(), ImGui::IsAnyItemActive());
+    }
+    panelCache.draw();
+    sendPanelEdits();
+
+    if (recordVideo && !frameRecorder.capture(windowWidth, windowHeight))
+    {
+        // The video can't change size mid-stream
+        frameRecorder.stop();
+        recordVideo = false;
+    }
+
+    glutSwapBuffers();
+    inputLatency.presented(inputClock());
+
+    if (appConfig.benchmarkFrames > 0)
+        recordBenchmarkFrame();
+}
+
+void reshape(int width, int height)
+{
+    windowWidth = width;
+    windowHeight = height;
+    glViewport(0, 0, windowWidth, windowHeight);
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = ImVec2((float)width, (float)height);
+    panelCache.touch();
+    glutPostRedisplay();
+}
+
+// Key events only record which movement keys are held; updateMovement()
+// applies them once per tick
+void keyboard(unsigned char key, int x, int y)
+{
+    if (keys.keyDown(key))
+        inputLatency.eventArrived(inputClock());
+}
+
+void keyboardUp(unsigned char key, int x, int y)
+{
+    if (keys.keyUp(key))
+        inputLatency.eventArrived(inputClock());
+}
+
+// Motion events only accumulate; updateMouseLook() applies the total once
+// per tick
+void mouseMotion(int x, int y)
+{
+    mouseDelta.moved(x, y);
+    inputLatency.eventArrived(inputClock());
+}
+
+// Left clicks in the 3D view pick; everything is still passed on to ImGui.
+// The panel's strip is excluded explicitly since ImGui only learns the cursor
+// position on clicks and drags.
+void mouseButton(int button, int state, int x, int y)
+{
+    ImGui_ImplGLUT_MouseFunc(button, state, x, y);
+    panelCache.touch();
+    if (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN && x < windowWidth - 300 && !ImGui::GetIO().WantCaptureMouse)
+        pickAt(x, y);
+}
+
+void mouseWheel(int wheel, int direction, int x, int y)
+{
+    ImGui_ImplGLUT_MouseWheelFunc(wheel, direction, x, y);
+    panelCache.touch();
+}
+
+void init()
+{
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    glEnable(GL_DEPTH_TEST);
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGui_ImplGLUT_Init();
+    ImGui_ImplGLUT_InstallFuncs();
+    ImGui_ImplOpenGL2_Init();
+
+    ImGui::StyleColorsDark();
+
+    ImGuiIO& io = ImGui::GetIO(); (void)&io;
+    io.FontGlobalScale = 1.5f;
+    io.DisplaySize = ImVec2((float)windowWidth, (float)windowHeight);
+
+    font = io.Fonts->AddFontFromFileTTF("Assets/Roboto-Regular.ttf", 18.0f);
+    smallFont = io.Fonts->AddFontFromFileTTF("Assets/Roboto-Regular.ttf", 12.0f);
+    if (font == NULL || smallFont == NULL)
+    {
+#ifdef DEBUG
+        std::cerr << "Failed to load font file!" << std::endl;
+#endif
+    }
+
+    loadTextures();
+    glActiveTexture(GL_TEXTURE0);
+    glEnable(GL_TEXTURE_2D);
+}
+
+// Casts a LiDAR sweep from the robot's current pose when one is due
+void updateLidar()
+{
+    double now = glutGet(GLUT_ELAPSED_TIME) * 0.001;
+    if (!recordLidar || !lidar.due(now))
+        return;
+
+    std::vector<RobotLinks> robots(1);
+    computeRobotLinks(world, robots[0]);
+    lidar.setScene(collisionScene, robots, 0);
+    // The sweep's ground is a plane; on terrain, the one under the robot
+    lidar.setFloorHeight(groundHeight(world.robot.x, world.robot.z));
+    lidar.sweep(world.robot, now, lidarScan);
+    lidarWriter.write(lidar, lidarScan);
+}
+
+void idle()
+{
+    updateLidar();
+    glutPostRedisplay();
+}
+
+// Batched headless mode: steps many environments at once across all cores,
+// each one offset into the walking script so they don't stay in lockstep
+int runBatchMode(uint64_t steps, size_t envs, const unsigned char* script, size_t scriptLength)
+{
+    RobotBatch batch(envs);
+    JobSystem& jobs = JobSystem::shared();
+    std::vector<unsigned char> actions(envs);
+    std::vector<float> observations(envs * kObservationSize);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t step = 0; step < steps; ++step)
+    {
+        for (size_t i = 0; i < envs; ++i)
+            actions[i] = script[(step + i) % scriptLength];
+        batch.step(actions.data(), observations.data(), jobs);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double total = (double)steps * envs;
+    printf("%zu envs x %llu steps on %u threads in %.3f s (%.2f M env-steps/s)\n", envs, (unsigned long long)steps, jobs.threadCount(), seconds, seconds > 0.0 ? total / seconds * 1e-6 : 0.0);
+    return 0;
+}
+
+// Headless mode: steps the kinematics through a walking script with no GL
+// context and reports the throughput, e.g. "--headless 10000000" or
+// "--headless 1000 4096" for 4096 environments stepped in parallel
+int runHeadlessMode(int argc, char** argv)
+{
+    uint64_t steps = 10000000;
+    if (argc > 2)
+        steps = strtoull(argv[2], NULL, 10);
+
+    const unsigned char script[] = { 'w', 'w', 'w', 'd', 'd', 's', 's', 'a', 0, 0 };
+
+    if (argc > 3)
+        return runBatchMode(steps, strtoull(argv[3], NULL, 10), script, sizeof(script));
+
+    RobotKinematics state;
+    auto start = std::chrono::steady_clock::now();
+    runHeadless(state, script, sizeof(script), steps);
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    printf("%llu steps in %.3f s (%.2f M steps/s)\n", (unsigned long long)steps, seconds, seconds > 0.0 ? steps / seconds * 1e-6 : 0.0);
+    printf("final pose: x=%.2f z=%.2f rotation=%.1f walkCycle=%.2f\n", state.x, state.z, state.rotation, state.walkCycle);
+    return 0;
+}
+
+// LiDAR mode: walks the robot through the script and casts one sweep per
+// step with no GL context, e.g. "--lidar 200 scans.bin" writes 200 sweeps
+int runLidarMode(int argc, char** argv)
+{
+    int sweeps = argc > 2 ? atoi(argv[2]) : 100;
+    LidarScanWriter writer;
+    if (argc > 3 && !writer.open(argv[3]))
+    {
+        fprintf(stderr, "Cannot open %s\n", argv[3]);
+        return 1;
+    }
+
+    const unsigned char script[] = { 'w', 'w', 'w', 'd', 'd', 's', 's', 'a', 0, 0 };
+    std::vector<RobotLinks> robots(1);
+
+    double seconds = 0.0;
+    for (int i = 0; i < sweeps; ++i)
+    {
+        moveRobot(world, script[i % sizeof(script)], collisionScene);
+        stepAnimation(world.robot);
+
+        auto start = std::chrono::steady_clock::now();
+        computeRobotLinks(world, robots[0]);
+        lidar.setScene(collisionScene, robots, 0);
+        lidar.sweep(world.robot, i / lidar.settings().rate, lidarScan);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (writer.isOpen())
+            writer.write(lidar, lidarScan);
+    }
+
+    int rays = lidar.settings().channels * lidar.settings().columns;
+    printf("%d sweeps of %d rays in %.3f s (%.2f ms/sweep, %.2f M rays/s)\n", sweeps, rays, seconds, sweeps > 0 ? seconds * 1e3 / sweeps : 0.0, seconds > 0.0 ? (double)rays * sweeps / seconds * 1e-6 : 0.0);
+    return 0;
+}
+
+int runRobotApp(int argc, char** argv, const AppConfig& config)
+{
+    appConfig = config;
+    configureScene(config.scene);
+
+    if (argc > 1 && strcmp(argv[1], "--headless") == 0)
+        return runHeadlessMode(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "--lidar") == 0)
+        return runLidarMode(argc, argv);
+
+    // Draws every view with the CPU rasterizer from the start; "--budget ms"
+    // sets the quality governor's frame time; "--terrain heightmap" replaces
+    // the floor, with "--terrain-spacing m" between pixels and
+    // "--terrain-height m" from black to white
+    const char* terrainPath = NULL;
+    float terrainSpacing = 1.0f, terrainHeight = 100.0f;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--software") == 0)
+            sceneConfig.softwareRaster = true;
+        if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0.0)
+            governor.budget = atof(argv[++i]) * 1e-3;
+        if (strcmp(argv[i], "--terrain") == 0 && i + 1 < argc)
+            terrainPath = argv[++i];
+        if (strcmp(argv[i], "--terrain-spacing") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0.0)
+            terrainSpacing = (float)atof(argv[++i]);
+        if (strcmp(argv[i], "--terrain-height") == 0 && i + 1 < argc)
+            terrainHeight = (float)atof(argv[++i]);
+    }
+    if (terrainPath)
+        loadTerrain(terrainPath, terrainSpacing, terrainHeight);
+
+    // Benchmarks compare fixed settings
+    governor.enabled = config.benchmarkFrames <= 0;
+    applyQuality();
+
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH | (sceneConfig.reflection ? GLUT_STENCIL : 0));
+    glutInitWindowSize(windowWidth, windowHeight);
+    glutCreateWindow(config.title);
+    glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_GLUTMAINLOOP_RETURNS);
+
+    glewInit();
+    init();
+
+    glutDisplayFunc(display);
+    glutKeyboardFunc(keyboard);
+    glutKeyboardUpFunc(keyboardUp);
+    glutIgnoreKeyRepeat(1);
+    glutPassiveMotionFunc(mouseMotion);
+    glutMouseFunc(mouseButton);
+    glutMouseWheelFunc(mouseWheel);
+    glutReshapeFunc(reshape);
+    glutIdleFunc(idle);
+
+    // The simulation starts from the configured scene and hands it over
+    // before the first frame
+    simState.world = world;
+    for (int i = 0; i < 3; ++i)
+        memcpy(simState.props[i], propPositions[i], sizeof(simState.props[i]));
+    rebuildSimCollision();
+    publishSnapshot(0.0);
+    if (config.benchmarkFrames <= 0)
+        simulation.start(simulationRate, simulationTick);
+
+    glutMainLoop();
+
+    simulation.stop();
+    headCamSensor.shutdown();
+    insetView.shutdown();
+    scaledView.shutdown();
+    frameRecorder.stop();
+    panelCache.shutdown();
+    ImGui_ImplOpenGL2_Shutdown();
+    ImGui_ImplGLUT_Shutdown();
+    ImGui::DestroyContext();
+
+    return 0;
+}
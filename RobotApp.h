@@ -0,0 +1,22 @@
+#pragma once
+
+// The interactive robot application: window, control panel, input, sensors
+// and recording on top of RobotScene. The executables are thin frontends
+// that fill in an AppConfig and hand over to runRobotApp().
+
+#include "RobotScene.h"
+
+struct AppConfig
+{
+    const char* title = "Robot";
+    SceneConfig scene;
+
+    // Render benchmark: when above zero, the robot walks a fixed script and
+    // the app exits after this many frames, printing the frame timings
+    int benchmarkFrames = 0;
+};
+
+// Runs the app, or one of its headless modes if argv asks for it
+// ("--headless", "--lidar"). "--software" starts it on the CPU rasterizer.
+// Returns the process exit code.
+int runRobotApp(int argc, char** argv, const AppConfig& config);
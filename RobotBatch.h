@@ -0,0 +1,152 @@
+#pragma once
+
+// Batched headless simulation of many independent robots.
+// State is kept as structure-of-arrays so one step walks each field linearly,
+// and the shared JobSystem spreads the environments across cores.
+// Observations for the whole batch are written to a single contiguous
+// buffer, kObservationSize floats per environment.
+
+#include "JobSystem.h"
+#include "RobotSim.h"
+
+#include <cstdint>
+#include <vector>
+
+// Observation layout per environment
+enum ObservationField
+{
+    OBS_X,
+    OBS_Y,
+    OBS_Z,
+    OBS_ROTATION,
+    OBS_WALK_CYCLE,
+    OBS_LEFT_HIP,
+    OBS_LEFT_KNEE,
+    OBS_RIGHT_HIP,
+    OBS_RIGHT_KNEE,
+    kObservationSize
+};
+
+class RobotBatch
+{
+public:
+    explicit RobotBatch(size_t count = 0) { resize(count); }
+
+    size_t size() const { return x.size(); }
+
+    void resize(size_t count)
+    {
+        x.assign(count, 0.0f);
+        y.assign(count, 0.0f);
+        z.assign(count, 0.0f);
+        rotation.assign(count, 0.0f);
+        walkCycle.assign(count, 0.0f);
+        leftHip.assign(count, 0.0f);
+        leftKnee.assign(count, 0.0f);
+        rightHip.assign(count, 0.0f);
+        rightKnee.assign(count, 0.0f);
+        direction.assign(count, FORWARD);
+        isMoving.assign(count, 0);
+    }
+
+    void set(size_t i, const RobotKinematics& robot)
+    {
+        x[i] = robot.x;
+        y[i] = robot.y;
+        z[i] = robot.z;
+        rotation[i] = robot.rotation;
+        walkCycle[i] = robot.walkCycle;
+        leftHip[i] = robot.leftHipAngle;
+        leftKnee[i] = robot.leftKneeAngle;
+        rightHip[i] = robot.rightHipAngle;
+        rightKnee[i] = robot.rightKneeAngle;
+        direction[i] = (uint8_t)robot.direction;
+        isMoving[i] = robot.isMoving ? 1 : 0;
+    }
+
+    RobotKinematics get(size_t i) const
+    {
+        RobotKinematics robot;
+        robot.x = x[i];
+        robot.y = y[i];
+        robot.z = z[i];
+        robot.rotation = rotation[i];
+        robot.walkCycle = walkCycle[i];
+        robot.leftHipAngle = leftHip[i];
+        robot.leftKneeAngle = leftKnee[i];
+        robot.rightHipAngle = rightHip[i];
+        robot.rightKneeAngle = rightKnee[i];
+        robot.direction = (Direction)direction[i];
+        robot.isMoving = isMoving[i] != 0;
+        return robot;
+    }
+
+    void reset(size_t i) { set(i, RobotKinematics()); }
+
+    // Advances every environment by one tick. actions holds one key per
+    // environment (0 for none), observations receives size() * kObservationSize
+    // floats and may be NULL when only the state is needed.
+    void step(const unsigned char* actions, float* observations, JobSystem& jobs)
+    {
+        jobs.parallelFor(size(), [&](size_t begin, size_t end)
+        {
+            stepRange(begin, end, actions, observations);
+        });
+    }
+
+    // Single-threaded version of step for a subrange of environments
+    void stepRange(size_t begin, size_t end, const unsigned char* actions, float* observations)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            Direction next;
+            if (actions[i] != 0)
+            {
+                isMoving[i] = 1;
+                if (keyToDirection(actions[i], next))
+                {
+                    rotation[i] += kTurnTable[direction[i]][next];
+                    direction[i] = (uint8_t)next;
+                    x[i] += kMoveTable[next][0];
+                    z[i] += kMoveTable[next][1];
+                    walkCycle[i] += kMoveTable[next][2];
+                }
+            }
+        }
+
+        // Gait update kept in its own loop so it stays branch-light
+        for (size_t i = begin; i < end; ++i)
+        {
+            float amplitude = isMoving[i] ? 30.0f : 0.0f;
+            float s = std::sin(walkCycle[i]) * amplitude;
+            float c = std::cos(walkCycle[i]) * amplitude;
+            leftHip[i] = s;
+            leftKnee[i] = c;
+            rightHip[i] = -s;
+            rightKnee[i] = -c;
+        }
+
+        if (observations == NULL)
+            return;
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            float* obs = observations + i * kObservationSize;
+            obs[OBS_X] = x[i];
+            obs[OBS_Y] = y[i];
+            obs[OBS_Z] = z[i];
+            obs[OBS_ROTATION] = rotation[i];
+            obs[OBS_WALK_CYCLE] = walkCycle[i];
+            obs[OBS_LEFT_HIP] = leftHip[i];
+            obs[OBS_LEFT_KNEE] = leftKnee[i];
+            obs[OBS_RIGHT_HIP] = rightHip[i];
+            obs[OBS_RIGHT_KNEE] = rightKnee[i];
+        }
+    }
+
+    std::vector<float> x, y, z;
+    std::vector<float> rotation, walkCycle;
+    std::vector<float> leftHip, leftKnee, rightHip, rightKnee;
+    std::vector<uint8_t> direction;
+    std::vector<uint8_t> isMoving;
+};
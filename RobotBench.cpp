@@ -0,0 +1,504 @@
+// Benchmark harness. Runs the engine's hot paths on fixed, seeded workloads
+// and prints one timing line per benchmark, so a change can be measured by
+// running it before and after.
+//
+//   robot_bench                          every CPU benchmark
+//   robot_bench lidar pick               only benchmarks whose name contains a filter
+//   robot_bench --render [frames] [--reflection] [--software]
+//                                        renders frames of the app in a window
+//                                        (GL builds only; disable vsync first)
+
+#include "Benchmark.h"
+#include "JobSystem.h"
+#include "LidarSensor.h"
+#include "LightmapBaker.h"
+#include "PathTracer.h"
+#include "RobotBatch.h"
+#include "RobotCollision.h"
+#include "RobotPicking.h"
+#include "RobotSelfCollision.h"
+#include "RobotSim.h"
+#include "SoftRasterizer.h"
+#include "Terrain.h"
+#include "VideoEncoder.h"
+
+#ifdef ROBOT_BENCH_RENDER
+#include "RobotApp.h"
+#endif
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+const unsigned char kWalkScript[] = { 'w', 'w', 'w', 'd', 'd', 's', 's', 'a', 0, 0 };
+
+// Results are written here so the optimizer can't drop the work
+volatile int benchSink;
+
+// Props scattered over a 100x100 area around the app's three
+CollisionScene makeBenchScene()
+{
+    CollisionScene scene;
+    scene.addSphere(vec3(-7.0f, 0.0f, 0.0f), 0.5f);
+    scene.addBox(vec3(2.0f, 0.0f, -10.0f), vec3(0.5f, 0.5f, 0.5f));
+    scene.addBox(vec3(-4.0f, 0.0f, -1.0f), vec3(1.6f, 0.8f, 1.0f));
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    for (int i = 0; i < 64; ++i)
+    {
+        if (i % 2 == 0)
+            scene.addSphere(vec3(position(rng), 0.0f, position(rng)), 0.5f);
+        else
+            scene.addBox(vec3(position(rng), 0.0f, position(rng)), vec3(0.5f, 0.5f, 0.5f));
+    }
+    scene.build();
+    return scene;
+}
+
+// A crowd of robots in random poses over the same area
+std::vector<RobotLinks> makeBenchCrowd(size_t count)
+{
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> angle(-90.0f, 90.0f);
+
+    std::vector<RobotLinks> robots(count);
+    World world;
+    for (RobotLinks& links : robots)
+    {
+        world.robot.x = position(rng);
+        world.robot.z = position(rng);
+        world.robot.rotation = angle(rng);
+        world.shoulderPitch = angle(rng);
+        world.elbowPitch = angle(rng);
+        computeRobotLinks(world, links);
+    }
+    return robots;
+}
+
+void benchKinematics()
+{
+    const uint64_t steps = 1000000;
+    RobotKinematics robot;
+    printTimings("kinematics", timeIterations(10, [&](int) { runHeadless(robot, kWalkScript, sizeof(kWalkScript), steps); }), (double)steps, "steps");
+    benchSink = (int)(robot.x + robot.z + robot.walkCycle);
+}
+
+void benchBatch()
+{
+    const size_t envs = 4096;
+    RobotBatch batch(envs);
+    JobSystem& jobs = JobSystem::shared();
+    std::vector<unsigned char> actions(envs);
+    std::vector<float> observations(envs * kObservationSize);
+    printTimings("batch", timeIterations(200, [&](int step)
+    {
+        for (size_t i = 0; i < envs; ++i)
+            actions[i] = kWalkScript[(step + i) % sizeof(kWalkScript)];
+        batch.step(actions.data(), observations.data(), jobs);
+    }), (double)envs, "env-steps");
+}
+
+void benchContacts()
+{
+    CollisionScene scene = makeBenchScene();
+    std::vector<RobotLinks> robots = makeBenchCrowd(1024);
+    std::vector<std::pair<int, Contact> > robotProp, robotRobot;
+    printTimings("contacts", timeIterations(50, [&](int) { scene.findContacts(robots, robotProp, robotRobot); }), (double)robots.size(), "robots");
+}
+
+void benchSelfCollision()
+{
+    const int queries = 10000;
+    SelfCollisionChecker checker;
+    World world;
+    int colliding = 0;
+    printTimings("self-collision", timeIterations(20, [&](int)
+    {
+        for (int i = 0; i < queries; ++i)
+        {
+            world.shoulderPitch = (float)(i % 360) - 180.0f;
+            world.elbowPitch = (float)(i * 7 % 360) - 180.0f;
+            colliding += checker.query(world).colliding;
+        }
+    }), (double)queries, "queries");
+    benchSink = colliding;
+}
+
+void benchPick()
+{
+    const int picks = 1000;
+    CollisionScene scene = makeBenchScene();
+    std::vector<RobotLinks> robots = makeBenchCrowd(1024);
+    PickScene pickScene;
+    pickScene.setProps(scene.props);
+    pickScene.setRobots(robots, true);
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::vector<Vec3> origins(picks), directions(picks);
+    for (int i = 0; i < picks; ++i)
+    {
+        origins[i] = vec3(position(rng), 3.0f, position(rng));
+        directions[i] = normalize(vec3(position(rng), 0.5f, position(rng)) - origins[i]);
+    }
+
+    int hits = 0;
+    printTimings("pick", timeIterations(20, [&](int)
+    {
+        for (int i = 0; i < picks; ++i)
+            hits += pickScene.pick(origins[i], directions[i]).kind != PICK_NONE;
+    }), (double)picks, "picks");
+    benchSink = hits;
+}
+
+void benchLidar()
+{
+    CollisionScene scene = makeBenchScene();
+    std::vector<RobotLinks> robots = makeBenchCrowd(64);
+    LidarSensor lidar;
+    LidarScan scan;
+    RobotKinematics robot;
+    lidar.setScene(scene, robots, -1);
+    int rays = lidar.settings().channels * lidar.settings().columns;
+    printTimings("lidar", timeIterations(20, [&](int i) { lidar.sweep(robot, i / lidar.settings().rate, scan); }), (double)rays, "rays");
+}
+
+void benchVideoConversion()
+{
+    const int width = 1280, height = 720;
+    std::vector<uint8_t> rgba((size_t)width * height * 4);
+    for (size_t i = 0; i < rgba.size(); ++i)
+        rgba[i] = (uint8_t)(i * 31);
+    std::vector<uint8_t> planes((size_t)width * height * 3 / 2);
+    uint8_t* y = planes.data();
+    uint8_t* u = y + (size_t)width * height;
+    uint8_t* v = u + (size_t)width * height / 4;
+    printTimings("rgba-to-i420", timeIterations(50, [&](int) { rgbaToI420(rgba.data(), width, height, (size_t)width * 4, y, u, v); }), (double)width * height, "pixels");
+}
+
+// Places a unit mesh along a capsule's axis, the way drawLimb() stretches its cylinder
+Mat4 capsuleAxisTransform(const Capsule& c)
+{
+    Vec3 axis = c.b - c.a;
+    Vec3 side = normalize(cross(axis, std::fabs(axis.y) < 0.9f * length(axis) ? vec3(0.0f, 1.0f, 0.0f) : vec3(1.0f, 0.0f, 0.0f)));
+    Vec3 up = normalize(cross(axis, side));
+    Mat4 m = mat4Identity();
+    m.m[0] = side.x * c.radius; m.m[1] = side.y * c.radius; m.m[2] = side.z * c.radius;
+    m.m[4] = up.x * c.radius;   m.m[5] = up.y * c.radius;   m.m[6] = up.z * c.radius;
+    m.m[8] = axis.x;            m.m[9] = axis.y;            m.m[10] = axis.z;
+    m.m[12] = c.a.x;            m.m[13] = c.a.y;            m.m[14] = c.a.z;
+    return m;
+}
+
+// The softraster and pathtrace workload: the app's floor, sky and props with
+// eight robots built from their link capsules, and a fixed camera
+struct BenchRenderScene
+{
+    RasterTexture floorTexture;
+    RasterCubemap sky;
+    RasterMesh floor, sphere, cylinder, cube, teapot;
+    std::vector<RobotLinks> robots;
+    RasterMaterial material;
+    Vec3 eye, lightPosition;
+};
+
+void makeBenchRenderScene(BenchRenderScene& scene)
+{
+    std::vector<unsigned char> pixels(1024 * 1024 * 3);
+    for (int y = 0; y < 1024; ++y)
+        for (int x = 0; x < 1024; ++x)
+            for (int c = 0; c < 3; ++c)
+                pixels[((size_t)y * 1024 + x) * 3 + c] = (unsigned char)(((x / 64 + y / 64) & 1) ? 200 : 60 + c * 20);
+    scene.floorTexture.setImage(pixels.data(), 1024, 1024, 3, true);
+    for (int face = 0; face < 6; ++face)
+        scene.sky.faces[face].setImage(pixels.data(), 512, 512, 3, false);
+
+    for (int i = -10; i < 10; ++i)
+        for (int j = -10; j < 10; ++j)
+        {
+            uint32_t first = (uint32_t)scene.floor.positions.size();
+            const float corners[4][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+            for (const float* corner : corners)
+            {
+                addVertex(scene.floor, vec3(i + corner[0], -0.9f, j + corner[1]), vec3(0.0f, 1.0f, 0.0f));
+                scene.floor.uvs.push_back(corner[0]);
+                scene.floor.uvs.push_back(corner[1]);
+            }
+            addQuad(scene.floor, first, first + 1, first + 2, first + 3);
+        }
+    scene.sphere = makeSphereMesh(1.0f, 20, 20);
+    scene.cylinder = makeCylinderMesh(1.0f, 1.0f, 20);
+    scene.cube = makeCubeMesh(1.0f);
+    scene.teapot = makeTeapotMesh(1.0f, 10);
+
+    scene.robots.resize(8);
+    World world;
+    for (size_t i = 0; i < scene.robots.size(); ++i)
+    {
+        world.robot.x = (float)(i % 4) * 2.5f - 4.0f;
+        world.robot.z = (float)(i / 4) * 3.0f - 3.0f;
+        world.robot.rotation = (float)i * 40.0f;
+        world.shoulderPitch = (float)i * 20.0f - 60.0f;
+        computeRobotLinks(world, scene.robots[i]);
+    }
+
+    scene.material.specular[0] = scene.material.specular[1] = scene.material.specular[2] = 0.9f;
+    scene.material.shininess = 64.0f;
+    scene.eye = vec3(0.0f, 4.0f, 12.0f);
+    scene.lightPosition = vec3(1.2f, 7.5f, 2.0f);
+}
+
+// Calls draw(mesh, model, texture) for everything in the scene
+template <typename Draw>
+void drawBenchRenderScene(const BenchRenderScene& scene, Draw draw)
+{
+    draw(scene.floor, mat4Identity(), &scene.floorTexture);
+    draw(scene.sphere, mat4Translation(-7.0f, 0.0f, 0.0f) * mat4Scaling(0.5f, 0.5f, 0.5f), (const RasterTexture*)NULL);
+    draw(scene.cube, mat4Translation(2.0f, 0.0f, -10.0f), (const RasterTexture*)NULL);
+    draw(scene.teapot, mat4Translation(-4.0f, 0.0f, -1.0f), (const RasterTexture*)NULL);
+    for (const RobotLinks& links : scene.robots)
+        for (const Capsule& c : links.links)
+        {
+            draw(scene.sphere, mat4Translation(c.a.x, c.a.y, c.a.z) * mat4Scaling(c.radius, c.radius, c.radius), (const RasterTexture*)NULL);
+            if (length(c.b - c.a) > 0.0f)
+                draw(scene.cylinder, capsuleAxisTransform(c), (const RasterTexture*)NULL);
+        }
+}
+
+void benchSoftRaster()
+{
+    const int width = 1280, height = 720;
+    BenchRenderScene scene;
+    makeBenchRenderScene(scene);
+
+    RasterLight light;
+    light.ambient[0] = light.ambient[1] = light.ambient[2] = 0.25f;
+    Mat4 view = mat4LookAt(scene.eye, vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
+    Vec3 lightEye = transformPoint(view, scene.lightPosition);
+    light.position[0] = lightEye.x;
+    light.position[1] = lightEye.y;
+    light.position[2] = lightEye.z;
+    light.position[3] = 1.0f;
+    const float clearColor[4] = { 0.1f, 0.1f, 0.1f, 1.0f };
+
+    SoftRasterizer rasterizer;
+    printTimings("softraster", timeIterations(30, [&](int)
+    {
+        rasterizer.begin(width, height, mat4Perspective(45.0f, (float)width / height, 0.1f, 1000.0f), clearColor);
+        rasterizer.setLight(light);
+        rasterizer.setSky(&scene.sky, view);
+        drawBenchRenderScene(scene, [&](const RasterMesh& mesh, const Mat4& model, const RasterTexture* texture)
+        {
+            rasterizer.draw(mesh, view * model, scene.material, texture);
+        });
+        rasterizer.render();
+    }), (double)width * height, "pixels");
+    benchSink = (int)rasterizer.triangleCount() + (int)rasterizer.color()[width * height / 2];
+}
+
+// One sample per pixel per iteration; the throughput is per core, so
+// machines with different core counts compare directly
+void benchPathTrace()
+{
+    const int width = 320, height = 180;
+    BenchRenderScene scene;
+    makeBenchRenderScene(scene);
+
+    PathTracer tracer;
+    drawBenchRenderScene(scene, [&](const RasterMesh& mesh, const Mat4& model, const RasterTexture* texture)
+    {
+        tracer.addMesh(mesh, model, scene.material, texture);
+    });
+    const float lightPosition[4] = { scene.lightPosition.x, scene.lightPosition.y, scene.lightPosition.z, 1.0f };
+    tracer.setLight(lightPosition, vec3(70.0f, 70.0f, 70.0f));
+    tracer.setEnvironment(&scene.sky);
+    tracer.setCamera(scene.eye, vec3(0.0f, 0.0f, 0.0f), 45.0f, width, height);
+    tracer.build();
+
+    unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+    printTimings("pathtrace", timeIterations(8, [&](int) { tracer.renderPass(); }), (double)width * height / cores, "samples/core");
+    std::vector<uint8_t> rgb;
+    tracer.resolve(rgb);
+    benchSink = (int)tracer.triangleCount() + rgb[rgb.size() / 2];
+}
+
+// The floor's lightmap and the props' normal cubemaps under the whole
+// scene, robots included; per core like the path tracer
+void benchLightmap()
+{
+    BenchRenderScene scene;
+    makeBenchRenderScene(scene);
+
+    LightmapBaker baker;
+    drawBenchRenderScene(scene, [&](const RasterMesh& mesh, const Mat4& model, const RasterTexture* texture)
+    {
+        baker.scene.addMesh(mesh, model, scene.material, texture);
+    });
+    baker.scene.build();
+    baker.targets.push_back(LightmapTarget::plane(vec3(-10.0f, -0.9f, -10.0f), vec3(20.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, 20.0f), 128, 128, scene.material));
+    baker.targets.push_back(LightmapTarget::normalCube(vec3(-7.0f, 0.0f, 0.0f), 0.5f, 32, scene.material));
+    baker.targets.push_back(LightmapTarget::normalCube(vec3(2.0f, 0.0f, -10.0f), 0.5f, 32, scene.material));
+
+    RasterLight light;
+    light.ambient[0] = light.ambient[1] = light.ambient[2] = 0.25f;
+    light.position[0] = scene.lightPosition.x;
+    light.position[1] = scene.lightPosition.y;
+    light.position[2] = scene.lightPosition.z;
+    light.position[3] = 1.0f;
+
+    size_t texels = 0;
+    for (const LightmapTarget& target : baker.targets)
+        texels += target.texelCount();
+    unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+    printTimings("lightmap", timeIterations(3, [&](int) { baker.bake(light); }), (double)texels / cores, "texels/core");
+    benchSink = (int)baker.targets[0].texels[baker.targets[0].texels.size() / 2];
+}
+
+// A 4 km square of rolling hills at 2 m spacing, flown over at 25 m per
+// update with chunk builds waited for, then ground lookups at random points
+// on it
+void benchTerrain()
+{
+    const int size = 2049;
+    const char* path = "robot_bench.terrain";
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> phase(0.0f, 6.2831853f);
+    float phases[4][2];
+    for (float* p : phases)
+    {
+        p[0] = phase(random);
+        p[1] = phase(random);
+    }
+    std::vector<float> heights((size_t)size * size);
+    for (int z = 0; z < size; ++z)
+        for (int x = 0; x < size; ++x)
+        {
+            float h = 0.0f;
+            for (int octave = 0; octave < 4; ++octave)
+            {
+                float frequency = 0.005f * (float)(1 << octave);
+                h += 40.0f / (float)(1 << octave) * std::sin(x * frequency + phases[octave][0]) * std::cos(z * frequency * 1.3f + phases[octave][1]);
+            }
+            heights[(size_t)z * size + x] = h;
+        }
+    Terrain terrain;
+    if (!Terrain::write(path, heights.data(), size, size, 2.0f, -0.9f, 0) || !terrain.open(path))
+    {
+        fprintf(stderr, "terrain: can't write %s\n", path);
+        return;
+    }
+
+    size_t triangles = 0;
+    int updates = 40;
+    TimingStats stream = timeIterations(updates, [&](int i)
+    {
+        terrain.update(vec3(-500.0f + i * 25.0f, 0.0f, 0.0f));
+        terrain.finishBuilds();
+        for (int index : terrain.activeChunks())
+            if (terrain.prepareMesh(terrain.chunk(index)))
+                triangles += terrain.chunk(index).mesh.indices.size() / 3;
+    });
+    printTimings("terrain-stream", stream, (double)triangles / updates, "triangles");
+
+    std::uniform_real_distribution<float> position(-2000.0f, 2000.0f);
+    std::vector<float> points(2 * 1000000);
+    for (float& p : points)
+        p = position(random);
+    float sum = 0.0f;
+    printTimings("terrain-height", timeIterations(10, [&](int)
+    {
+        for (size_t i = 0; i < points.size(); i += 2)
+            sum += terrain.height(points[i], points[i + 1]);
+    }), (double)(points.size() / 2), "lookups");
+    benchSink = (int)sum;
+    terrain.close();
+    remove(path);
+}
+
+struct BenchEntry
+{
+    const char* name;
+    void (*run)();
+};
+
+const BenchEntry kBenchmarks[] =
+{
+    { "kinematics", benchKinematics },
+    { "batch", benchBatch },
+    { "contacts", benchContacts },
+    { "self-collision", benchSelfCollision },
+    { "pick", benchPick },
+    { "lidar", benchLidar },
+    { "rgba-to-i420", benchVideoConversion },
+    { "softraster", benchSoftRaster },
+    { "pathtrace", benchPathTrace },
+    { "lightmap", benchLightmap },
+    { "terrain", benchTerrain },
+};
+
+// How busy each job system worker was during a benchmark, for the ones that
+// schedule work on it
+void printWorkerUtilisation(const std::vector<float>& utilisation)
+{
+    float total = 0.0f;
+    for (float busy : utilisation)
+        total += busy;
+    if (total < 0.01f)
+        return;
+    printf("%-16s", "  workers");
+    for (float busy : utilisation)
+        printf(" %3.0f%%", busy * 100.0f);
+    printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--render") == 0)
+    {
+#ifdef ROBOT_BENCH_RENDER
+        AppConfig config;
+        config.title = "Robot benchmark";
+        config.benchmarkFrames = 600;
+        for (int i = 2; i < argc; ++i)
+        {
+            if (strcmp(argv[i], "--reflection") == 0)
+            {
+                config.scene.spherePosition[2] = 4.0f;
+                config.scene.teapotPosition[2] = 7.0f;
+                config.scene.reflection = true;
+                config.scene.dimmableLight = true;
+                world.enableReflection = true;
+            }
+            else if (strcmp(argv[i], "--software") == 0)
+                config.scene.softwareRaster = true;
+            else
+                config.benchmarkFrames = atoi(argv[i]);
+        }
+        char* appArgv[] = { argv[0], NULL };
+        return runRobotApp(1, appArgv, config);
+#else
+        fprintf(stderr, "This build has no renderer; configure with OpenGL, GLEW, GLUT, glm and ImGui available\n");
+        return 1;
+#endif
+    }
+
+    std::vector<float> utilisation;
+    for (const BenchEntry& bench : kBenchmarks)
+    {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc && !selected; ++i)
+            selected = strstr(bench.name, argv[i]) != NULL;
+        if (!selected)
+            continue;
+        JobSystem::shared().utilisation(utilisation);
+        bench.run();
+        JobSystem::shared().utilisation(utilisation);
+        printWorkerUtilisation(utilisation);
+    }
+    return 0;
+}
@@ -0,0 +1,449 @@
+#pragma once
+
+// Collision detection between robots and scene props.
+// Props are spheres or axis-aligned boxes, robot links are capsules from
+// RobotLinks.h. A uniform spatial hash gives the broad phase and the exact
+// distance functions below are the narrow phase.
+
+#include "JobSystem.h"
+#include "RobotLinks.h"
+#include "SimMath.h"
+
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Narrow phase
+// ---------------------------------------------------------------------------
+
+// Squared distance between segments p1-q1 and p2-q2 (Ericson, RTCD 5.1.9)
+inline float segmentSegmentDistanceSq(const Vec3& p1, const Vec3& q1, const Vec3& p2, const Vec3& q2, float& s, float& t)
+{
+    const float epsilon = 1e-8f;
+    Vec3 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+    float a = dot(d1, d1), e = dot(d2, d2), f = dot(d2, r);
+
+    if (a <= epsilon && e <= epsilon)
+    {
+        s = t = 0.0f;
+        return dot(r, r);
+    }
+    if (a <= epsilon)
+    {
+        s = 0.0f;
+        t = std::min(std::max(f / e, 0.0f), 1.0f);
+    }
+    else
+    {
+        float c = dot(d1, r);
+        if (e <= epsilon)
+        {
+            t = 0.0f;
+            s = std::min(std::max(-c / a, 0.0f), 1.0f);
+        }
+        else
+        {
+            float b = dot(d1, d2);
+            float denom = a * e - b * b;
+            s = denom != 0.0f ? std::min(std::max((b * f - c * e) / denom, 0.0f), 1.0f) : 0.0f;
+            t = (b * s + f) / e;
+            if (t < 0.0f)
+            {
+                t = 0.0f;
+                s = std::min(std::max(-c / a, 0.0f), 1.0f);
+            }
+            else if (t > 1.0f)
+            {
+                t = 1.0f;
+                s = std::min(std::max((b - c) / a, 0.0f), 1.0f);
+            }
+        }
+    }
+
+    Vec3 c1 = p1 + d1 * s, c2 = p2 + d2 * t;
+    Vec3 d = c1 - c2;
+    return dot(d, d);
+}
+
+inline float pointAabbDistanceSq(const Vec3& p, const Aabb& box)
+{
+    Vec3 c = vmin(vmax(p, box.min), box.max);
+    Vec3 d = p - c;
+    return dot(d, d);
+}
+
+// Distance from a segment to a box. The distance along the segment is convex,
+// so a short ternary search converges to the exact minimum.
+inline float segmentAabbDistance(const Vec3& a, const Vec3& b, const Aabb& box)
+{
+    float lo = 0.0f, hi = 1.0f;
+    Vec3 d = b - a;
+    for (int i = 0; i < 24; ++i)
+    {
+        float m1 = lo + (hi - lo) * (1.0f / 3.0f);
+        float m2 = hi - (hi - lo) * (1.0f / 3.0f);
+        if (pointAabbDistanceSq(a + d * m1, box) <= pointAabbDistanceSq(a + d * m2, box))
+            hi = m2;
+        else
+            lo = m1;
+    }
+    return std::sqrt(pointAabbDistanceSq(a + d * ((lo + hi) * 0.5f), box));
+}
+
+// Signed distance between two capsules, negative when they overlap
+inline float capsuleCapsuleDistance(const Capsule& c1, const Capsule& c2)
+{
+    float s, t;
+    return std::sqrt(segmentSegmentDistanceSq(c1.a, c1.b, c2.a, c2.b, s, t)) - c1.radius - c2.radius;
+}
+
+// ---------------------------------------------------------------------------
+// Broad phase
+// ---------------------------------------------------------------------------
+
+// Uniform grid hashed into a fixed bucket table. Objects are inserted once per
+// covered cell, then build() counting-sorts the entries so each bucket is a
+// contiguous run of ids. Queries are read-only and safe to run in parallel.
+class SpatialHash
+{
+public:
+    explicit SpatialHash(float cellSize = 2.0f, unsigned tableBits = 12)
+        : cellSize(cellSize), inverseCellSize(1.0f / cellSize), mask((1u << tableBits) - 1)
+    {
+        starts.assign(mask + 2, 0);
+    }
+
+    void clear()
+    {
+        bounds.clear();
+        entries.clear();
+        ids.clear();
+        std::fill(starts.begin(), starts.end(), 0);
+    }
+
+    int insert(const Aabb& box)
+    {
+        int id = (int)bounds.size();
+        bounds.push_back(box);
+
+        int x0, y0, z0, x1, y1, z1;
+        cellRange(box, x0, y0, z0, x1, y1, z1);
+        for (int x = x0; x <= x1; ++x)
+            for (int y = y0; y <= y1; ++y)
+                for (int z = z0; z <= z1; ++z)
+                {
+                    Entry entry = { bucket(x, y, z), id };
+                    entries.push_back(entry);
+                }
+        return id;
+    }
+
+    void build()
+    {
+        std::fill(starts.begin(), starts.end(), 0);
+        for (const Entry& entry : entries)
+            ++starts[entry.bucket + 1];
+        for (size_t i = 1; i < starts.size(); ++i)
+            starts[i] += starts[i - 1];
+
+        ids.resize(entries.size());
+        std::vector<uint32_t> cursor(starts.begin(), starts.end() - 1);
+        for (const Entry& entry : entries)
+            ids[cursor[entry.bucket]++] = entry.id;
+    }
+
+    // Appends every object whose bounds overlap box, each id once
+    void query(const Aabb& box, std::vector<int>& out) const
+    {
+        size_t first = out.size();
+        int x0, y0, z0, x1, y1, z1;
+        cellRange(box, x0, y0, z0, x1, y1, z1);
+        for (int x = x0; x <= x1; ++x)
+            for (int y = y0; y <= y1; ++y)
+                for (int z = z0; z <= z1; ++z)
+                {
+                    uint32_t b = bucket(x, y, z);
+                    for (uint32_t i = starts[b]; i < starts[b + 1]; ++i)
+                        if (overlaps(bounds[ids[i]], box))
+                            out.push_back(ids[i]);
+                }
+
+        if (out.size() - first > 1)
+        {
+            std::sort(out.begin() + first, out.end());
+            out.erase(std::unique(out.begin() + first, out.end()), out.end());
+        }
+    }
+
+    size_t size() const { return bounds.size(); }
+    const Aabb& boundsOf(int id) const { return bounds[id]; }
+
+private:
+    struct Entry
+    {
+        uint32_t bucket;
+        int id;
+    };
+
+    int cell(float v) const { return (int)std::floor(v * inverseCellSize); }
+
+    void cellRange(const Aabb& box, int& x0, int& y0, int& z0, int& x1, int& y1, int& z1) const
+    {
+        x0 = cell(box.min.x); y0 = cell(box.min.y); z0 = cell(box.min.z);
+        x1 = cell(box.max.x); y1 = cell(box.max.y); z1 = cell(box.max.z);
+    }
+
+    uint32_t bucket(int x, int y, int z) const
+    {
+        return ((uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u ^ (uint32_t)z * 83492791u) & mask;
+    }
+
+    float cellSize, inverseCellSize;
+    uint32_t mask;
+    std::vector<Aabb> bounds;
+    std::vector<Entry> entries;
+    std::vector<uint32_t> starts;
+    std::vector<int> ids;
+};
+
+// ---------------------------------------------------------------------------
+// Scene
+// ---------------------------------------------------------------------------
+
+enum PropShape
+{
+    PROP_SPHERE,
+    PROP_BOX
+};
+
+struct Prop
+{
+    PropShape shape;
+    Vec3 center;
+    Vec3 halfExtents;   // box only
+    float radius;       // sphere only
+};
+
+inline Aabb propBounds(const Prop& prop)
+{
+    Vec3 h = prop.shape == PROP_SPHERE ? vec3(prop.radius, prop.radius, prop.radius) : prop.halfExtents;
+    Aabb box = { prop.center - h, prop.center + h };
+    return box;
+}
+
+// Signed distance between a link capsule and a prop, negative when they overlap
+inline float capsulePropDistance(const Capsule& c, const Prop& prop)
+{
+    if (prop.shape == PROP_SPHERE)
+    {
+        float s, t;
+        return std::sqrt(segmentSegmentDistanceSq(c.a, c.b, prop.center, prop.center, s, t)) - c.radius - prop.radius;
+    }
+    return segmentAabbDistance(c.a, c.b, propBounds(prop)) - c.radius;
+}
+
+struct Contact
+{
+    int link;       // link of the first robot
+    int other;      // prop id, or robot index for robot-robot contacts
+    int otherLink;  // link of the second robot, -1 for props
+    float distance; // negative penetration depth
+};
+
+class CollisionScene
+{
+public:
+    explicit CollisionScene(float cellSize = 2.0f) : propHash(cellSize), robotHash(cellSize) {}
+
+    int addSphere(Vec3 center, float radius)
+    {
+        Prop prop = { PROP_SPHERE, center, vec3(0, 0, 0), radius };
+        props.push_back(prop);
+        return (int)props.size() - 1;
+    }
+
+    int addBox(Vec3 center, Vec3 halfExtents)
+    {
+        Prop prop = { PROP_BOX, center, halfExtents, 0.0f };
+        props.push_back(prop);
+        return (int)props.size() - 1;
+    }
+
+    // Rebuilds the prop hash, call after adding or moving props
+    void build()
+    {
+        propHash.clear();
+        for (const Prop& prop : props)
+            propHash.insert(propBounds(prop));
+        propHash.build();
+    }
+
+    // Smallest signed distance between any robot link and any nearby prop.
+    // Returns FLT_MAX when no prop is inside the robot's bounds.
+    float robotClearance(const RobotLinks& robot, Contact* deepest = NULL) const
+    {
+        thread_local std::vector<int> candidates;
+        candidates.clear();
+        propHash.query(robot.bounds, candidates);
+
+        float best = FLT_MAX;
+        for (int id : candidates)
+        {
+            const Aabb& propBox = propHash.boundsOf(id);
+            for (int link = 0; link < kRobotLinkCount; ++link)
+            {
+                if (!overlaps(capsuleBounds(robot.links[link]), propBox))
+                    continue;
+                float distance = capsulePropDistance(robot.links[link], props[id]);
+                if (distance < best)
+                {
+                    best = distance;
+                    if (deepest)
+                    {
+                        Contact contact = { link, id, -1, distance };
+                        *deepest = contact;
+                    }
+                }
+            }
+        }
+        return best;
+    }
+
+    bool robotHitsProps(const RobotLinks& robot, Contact* deepest = NULL) const
+    {
+        return robotClearance(robot, deepest) < 0.0f;
+    }
+
+    // All robot-prop and robot-robot contacts for a crowd. The robots are
+    // hashed by their overall bounds each call, so the cost scales with the
+    // number of nearby pairs rather than robots squared.
+    // Each result pairs the index of the first robot with its contact.
+    // Robots are checked in blocks on the shared JobSystem, each block into
+    // lists of its own that are joined in order, so the results come out the
+    // same as from one thread.
+    void findContacts(const std::vector<RobotLinks>& robots, std::vector<std::pair<int, Contact> >& robotProp, std::vector<std::pair<int, Contact> >& robotRobot)
+    {
+        robotProp.clear();
+        robotRobot.clear();
+
+        robotHash.clear();
+        for (const RobotLinks& robot : robots)
+            robotHash.insert(robot.bounds);
+        robotHash.build();
+
+        size_t blockCount = (robots.size() + kContactBlock - 1) / kContactBlock;
+        if (contactBlocks.size() < blockCount)
+            contactBlocks.resize(blockCount);
+        JobSystem::shared().parallelFor(blockCount, [&](size_t first, size_t last)
+        {
+            std::vector<int> candidates;
+            for (size_t block = first; block < last; ++block)
+            {
+                ContactBlock& out = contactBlocks[block];
+                out.robotProp.clear();
+                out.robotRobot.clear();
+                size_t end = std::min(robots.size(), (block + 1) * kContactBlock);
+                for (size_t i = block * kContactBlock; i < end; ++i)
+                    robotContacts(robots, i, candidates, out);
+            }
+        }, 1);
+
+        for (size_t block = 0; block < blockCount; ++block)
+        {
+            const ContactBlock& found = contactBlocks[block];
+            robotProp.insert(robotProp.end(), found.robotProp.begin(), found.robotProp.end());
+            robotRobot.insert(robotRobot.end(), found.robotRobot.begin(), found.robotRobot.end());
+        }
+    }
+
+    std::vector<Prop> props;
+
+private:
+    static constexpr size_t kContactBlock = 64;
+
+    struct ContactBlock
+    {
+        std::vector<std::pair<int, Contact> > robotProp, robotRobot;
+    };
+
+    // Contacts of robot i with the props and with robots after it
+    void robotContacts(const std::vector<RobotLinks>& robots, size_t i, std::vector<int>& candidates, ContactBlock& out) const
+    {
+        Contact contact;
+        if (robotHitsProps(robots[i], &contact))
+            out.robotProp.push_back(std::make_pair((int)i, contact));
+
+        candidates.clear();
+        robotHash.query(robots[i].bounds, candidates);
+        for (int j : candidates)
+        {
+            if (j <= (int)i)
+                continue;
+
+            // Only links inside the other robot's bounds can touch it
+            int linksA[kRobotLinkCount], linksB[kRobotLinkCount];
+            int countA = 0, countB = 0;
+            for (int link = 0; link < kRobotLinkCount; ++link)
+            {
+                if (overlaps(capsuleBounds(robots[i].links[link]), robots[j].bounds))
+                    linksA[countA++] = link;
+                if (overlaps(capsuleBounds(robots[j].links[link]), robots[i].bounds))
+                    linksB[countB++] = link;
+            }
+
+            for (int a = 0; a < countA; ++a)
+                for (int b = 0; b < countB; ++b)
+                {
+                    float distance = capsuleCapsuleDistance(robots[i].links[linksA[a]], robots[j].links[linksB[b]]);
+                    if (distance < 0.0f)
+                    {
+                        Contact hit = { linksA[a], j, linksB[b], distance };
+                        out.robotRobot.push_back(std::make_pair((int)i, hit));
+                    }
+                }
+        }
+    }
+
+    SpatialHash propHash;
+    SpatialHash robotHash;
+    std::vector<ContactBlock> contactBlocks;
+};
+
+// Runs step on the robot and undoes it if that pushes the robot deeper into
+// a prop, keeping the new isMoving so the gait still reflects the input
+template <typename Step>
+inline bool moveRobotChecked(World& world, const CollisionScene& scene, Step step)
+{
+    RobotLinks links;
+    computeRobotLinks(world, links);
+    float before = scene.robotClearance(links);
+
+    RobotKinematics previous = world.robot;
+    step(world.robot);
+
+    computeRobotLinks(world, links);
+    float after = scene.robotClearance(links);
+    if (after < 0.0f && after < before)
+    {
+        bool moving = world.robot.isMoving;
+        world.robot = previous;
+        world.robot.isMoving = moving;
+        return false;
+    }
+    return true;
+}
+
+// Applies a movement key like stepKeyboard(), but rejects the step if it
+// would push the robot deeper into a prop. Moves that leave the robot no
+// worse off are allowed, so a robot that starts overlapping can back out.
+inline bool moveRobot(World& world, unsigned char key, const CollisionScene& scene)
+{
+    return moveRobotChecked(world, scene, [key](RobotKinematics& robot) { stepKeyboard(robot, key); });
+}
+
+// Same for held-key movement over a tick of dt seconds, see stepInput()
+inline bool moveRobotInput(World& world, unsigned input, float dt, const CollisionScene& scene)
+{
+    return moveRobotChecked(world, scene, [input, dt](RobotKinematics& robot) { stepInput(robot, input, dt); });
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+// Forward kinematics for the robot's collision geometry.
+// Every limb becomes a capsule and every joint a sphere (a capsule with both
+// ends at the same point), with the same offsets and radii drawRobot() uses.
+
+#include "RobotWorld.h"
+#include "SimMath.h"
+
+struct Capsule
+{
+    Vec3 a, b;
+    float radius;
+};
+
+inline Aabb capsuleBounds(const Capsule& c)
+{
+    Vec3 r = vec3(c.radius, c.radius, c.radius);
+    Aabb box = { vmin(c.a, c.b) - r, vmax(c.a, c.b) + r };
+    return box;
+}
+
+enum RobotLink
+{
+    LINK_LEFT_HIP,
+    LINK_LEFT_THIGH,
+    LINK_LEFT_KNEE,
+    LINK_LEFT_SHIN,
+    LINK_RIGHT_HIP,
+    LINK_RIGHT_THIGH,
+    LINK_RIGHT_KNEE,
+    LINK_RIGHT_SHIN,
+    LINK_PELVIS,
+    LINK_TORSO,
+    LINK_NECK,
+    LINK_HEAD,
+    LINK_SHOULDER,
+    LINK_UPPER_ARM,
+    LINK_ELBOW,
+    LINK_FOREARM,
+    LINK_WRIST,
+    LINK_HAND,
+    kRobotLinkCount
+};
+
+inline const char* robotLinkName(int link)
+{
+    static const char* names[kRobotLinkCount] =
+    {
+        "Left Hip", "Left Thigh", "Left Knee", "Left Shin",
+        "Right Hip", "Right Thigh", "Right Knee", "Right Shin",
+        "Pelvis", "Torso", "Neck", "Head",
+        "Shoulder", "Upper Arm", "Elbow", "Forearm", "Wrist", "Hand"
+    };
+    return link >= 0 && link < kRobotLinkCount ? names[link] : "";
+}
+
+struct RobotLinks
+{
+    Capsule links[kRobotLinkCount];
+    Aabb bounds;
+};
+
+inline Capsule makeCapsule(const Transform& t, Vec3 a, Vec3 b, float radius)
+{
+    Capsule c = { t * a, t * b, radius };
+    return c;
+}
+
+inline Capsule makeSphere(const Transform& t, float radius)
+{
+    Vec3 center = t.translation;
+    Capsule c = { center, center, radius };
+    return c;
+}
+
+inline void computeLegLinks(const Transform& root, float translateX, float hipAngle, float kneeAngle, Capsule* out)
+{
+    Transform hip = rotated(translated(root, translateX, 0.0f, 0.0f), rotationX(hipAngle));
+    out[0] = makeSphere(hip, 0.2f);
+    out[1] = makeCapsule(hip, vec3(0.0f, -0.1f, 0.0f), vec3(0.0f, -0.45f, 0.0f), 0.2f);
+
+    Transform knee = rotated(translated(hip, 0.0f, -0.55f, 0.0f), rotationX(kneeAngle));
+    out[2] = makeSphere(knee, 0.18f);
+    out[3] = makeCapsule(knee, vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, -0.35f, 0.0f), 0.16f);
+}
+
+// World-space link capsules for the robot described by world
+inline void computeRobotLinks(const World& world, RobotLinks& out)
+{
+    const RobotKinematics& robot = world.robot;
+    Transform root = rotated(translated(transformIdentity(), robot.x, robot.y, robot.z), rotationY(robot.rotation));
+
+    computeLegLinks(root, -0.25f, robot.leftHipAngle, robot.leftKneeAngle, &out.links[LINK_LEFT_HIP]);
+    computeLegLinks(root, 0.25f, robot.rightHipAngle, robot.rightKneeAngle, &out.links[LINK_RIGHT_HIP]);
+
+    out.links[LINK_PELVIS] = makeSphere(root, 0.18f);
+    out.links[LINK_TORSO] = makeCapsule(root, vec3(0.0f, 0.9f, 0.0f), vec3(0.0f, 0.15f, 0.0f), 0.15f);
+    out.links[LINK_NECK] = makeSphere(translated(root, 0.0f, 1.125f, 0.0f), 0.25f);
+    out.links[LINK_HEAD] = makeSphere(translated(root, 0.0f, 1.75f, 0.0f), 0.5f);
+
+    Transform shoulder = rotated(translated(root, 0.65f, 1.0f, 0.0f), rotationYXZ(world.shoulderYaw, world.shoulderPitch, world.shoulderRoll));
+    out.links[LINK_SHOULDER] = makeSphere(shoulder, 0.25f);
+    out.links[LINK_UPPER_ARM] = makeCapsule(shoulder, vec3(0.0f, -0.25f, 0.0f), vec3(0.0f, -0.5f, 0.0f), 0.1f);
+
+    Transform elbow = rotated(translated(shoulder, 0.0f, -0.5f, 0.0f), rotationYXZ(world.elbowYaw, world.elbowPitch, world.elbowRoll));
+    out.links[LINK_ELBOW] = makeSphere(elbow, 0.2f);
+    out.links[LINK_FOREARM] = makeCapsule(elbow, vec3(0.0f, -0.25f, 0.0f), vec3(0.0f, -0.5f, 0.0f), 0.1f);
+
+    Transform wrist = rotated(translated(elbow, 0.0f, -0.5f, 0.0f), rotationYXZ(world.wristYaw, world.wristPitch, world.wristRoll));
+    out.links[LINK_WRIST] = makeSphere(wrist, 0.15f);
+    out.links[LINK_HAND] = makeCapsule(wrist, vec3(0.0f, -0.1f, 0.0f), vec3(0.0f, -0.3f, 0.0f), 0.05f);
+
+    out.bounds = capsuleBounds(out.links[0]);
+    for (int i = 1; i < kRobotLinkCount; ++i)
+        out.bounds = merge(out.bounds, capsuleBounds(out.links[i]));
+}
+
+// Raises or lowers the robot until the foot that is deepest into the ground
+// just touches it; the other foot is then at or above the ground. groundHeight
+// is called as groundHeight(x, z) for the height under each foot tip.
+template <typename GroundHeight>
+inline void placeOnGround(World& world, const GroundHeight& groundHeight)
+{
+    RobotLinks links;
+    computeRobotLinks(world, links);
+    const Vec3& left = links.links[LINK_LEFT_SHIN].b;
+    const Vec3& right = links.links[LINK_RIGHT_SHIN].b;
+    world.robot.y += std::max(groundHeight(left.x, left.z) - left.y, groundHeight(right.x, right.z) - right.y);
+}
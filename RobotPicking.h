@@ -0,0 +1,139 @@
+#pragma once
+
+// Mouse picking of robot links and props by casting a ray on the CPU.
+// PickScene caches the link capsules and prop shapes along with a BVH over
+// the robots' bounds, so a pick only visits the few robots whose boxes the
+// ray crosses and tests their links exactly. Nothing is read back from the
+// GPU, so picking never stalls the frame.
+
+#include "RayCast.h"
+#include "RobotCollision.h"
+#include "RobotLinks.h"
+#include "SimMath.h"
+
+#include <cfloat>
+#include <vector>
+
+enum PickKind
+{
+    PICK_NONE,
+    PICK_LINK,
+    PICK_PROP
+};
+
+struct PickResult
+{
+    PickKind kind = PICK_NONE;
+    int robot = -1;     // robot index for links
+    int index = -1;     // RobotLink or prop index
+    float distance = FLT_MAX;
+};
+
+// Ray through a pixel of a perspective view looking from eye along forward,
+// ndcX and ndcY in [-1, 1] with +y up
+inline void pickRay(const Vec3& eye, const Vec3& forward, float fovY, float aspect, float ndcX, float ndcY, Vec3& origin, Vec3& direction)
+{
+    Vec3 f = normalize(forward);
+    Vec3 right = normalize(cross(f, vec3(0.0f, 1.0f, 0.0f)));
+    Vec3 up = cross(right, f);
+    float tanHalf = std::tan(toRadians(fovY) * 0.5f);
+    origin = eye;
+    direction = normalize(f + right * (ndcX * tanHalf * aspect) + up * (ndcY * tanHalf));
+}
+
+class PickScene
+{
+public:
+    void setProps(const std::vector<Prop>& sceneProps)
+    {
+        props = sceneProps;
+    }
+
+    // Caches the robots' links, call whenever they have moved since the last
+    // pick. The BVH over their bounds is only rebuilt when the number of
+    // robots changes or rebuild is set, otherwise it's refitted in place.
+    void setRobots(const std::vector<RobotLinks>& sceneRobots, bool rebuild = false)
+    {
+        rebuild = rebuild || sceneRobots.size() != robots.size();
+        robots = sceneRobots;
+        bounds.resize(robots.size());
+        for (size_t i = 0; i < robots.size(); ++i)
+            bounds[i] = robots[i].bounds;
+        if (rebuild)
+            robotBvh.build(bounds, 2);
+        else
+            robotBvh.refit(bounds);
+    }
+
+    PickResult pick(const Vec3& origin, const Vec3& direction) const
+    {
+        PickResult result;
+        Vec3 invDir = reciprocal(direction);
+        float t;
+        Vec3 normal;
+
+        for (size_t i = 0; i < props.size(); ++i)
+        {
+            const Prop& prop = props[i];
+            bool hit = prop.shape == PROP_SPHERE
+                ? intersectSphere(origin, direction, prop.center, prop.radius, t)
+                : intersectBox(origin, invDir, prop.center - prop.halfExtents, prop.center + prop.halfExtents, t, normal);
+            if (hit && t < result.distance)
+            {
+                result.kind = PICK_PROP;
+                result.index = (int)i;
+                result.distance = t;
+            }
+        }
+
+        if (robotBvh.empty())
+            return result;
+
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            int nodeIndex = stack[--top];
+            const Bvh::Node& node = robotBvh.nodes[nodeIndex];
+            if (!rayHitsAabb(origin, invDir, node.bounds, result.distance))
+                continue;
+
+            if (node.count == 0)
+            {
+                if (top + 2 <= 64)
+                {
+                    stack[top++] = node.rightOrFirst;
+                    stack[top++] = nodeIndex + 1;
+                }
+                continue;
+            }
+
+            for (int i = node.rightOrFirst; i < node.rightOrFirst + node.count; ++i)
+            {
+                int robot = robotBvh.order[i];
+                const RobotLinks& links = robots[robot];
+                if (!rayHitsAabb(origin, invDir, links.bounds, result.distance))
+                    continue;
+                for (int link = 0; link < kRobotLinkCount; ++link)
+                {
+                    const Capsule& c = links.links[link];
+                    if (intersectCapsule(origin, direction, c.a, c.b, c.radius, t) && t < result.distance)
+                    {
+                        result.kind = PICK_LINK;
+                        result.robot = robot;
+                        result.index = link;
+                        result.distance = t;
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+private:
+    std::vector<Prop> props;
+    std::vector<RobotLinks> robots;
+    std::vector<Aabb> bounds;
+    Bvh robotBvh;
+};
@@ -0,0 +1,1687 @@
+#include "RobotScene.h"
+#include "EnvironmentProbe.h"
+#include "JobSystem.h"
+#include "LightmapBaker.h"
+#include "PathTracer.h"
+#include "ShadowMap.h"
+#include "SkyIrradiance.h"
+#include "SoftRasterizer.h"
+#include "Terrain.h"
+#include "TerrainRenderer.h"
+
+#include <GL/freeglut.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+#include <string>
+
+#ifdef DEBUG
+#include <iostream>
+#endif
+
+World world;
+SceneConfig sceneConfig;
+
+// Picked props can be moved with the selection sliders
+float spherePosition[3];
+float cubePosition[3];
+float teapotPosition[3];
+float* propPositions[3] = { spherePosition, cubePosition, teapotPosition };
+const char* propNames[3] = { "Plastic Sphere", "Textured Cube", "Metal Teapot" };
+CollisionScene collisionScene;
+
+GLuint cubemapTexture;
+GLuint floorTexture;
+
+// The teapot's surroundings, captured from its centre one face per frame.
+// The reflection's texture matrix needs the view the teapot is drawn in.
+EnvironmentProbe teapotProbe;
+glm::mat4 currentView(1.0f);
+bool teapotVisible = true;
+
+// The props' and robot's shadows on the floor. The map is only redrawn when
+// the light, a prop or the robot moved; shadowMatrix takes world space to the
+// light's clip space.
+ShadowMap shadowMap;
+const int kShadowMapSize = 2048;
+const float kFloorHalfSize = 10.0f;
+glm::mat4 shadowMatrix(1.0f);
+bool depthOnlyPass = false;
+
+// Heightfield terrain in place of the flat floor, when one is loaded. The
+// floor's stencil reflection and lightmap only exist on the flat floor;
+// shadows fall on a square of terrain around the robot instead.
+Terrain terrain;
+TerrainRenderer terrainRenderer;
+const float (*softwareCullPlanes)[4] = NULL;    // the software view's frustum, none while capturing
+RasterMesh bakeGround;                          // the terrain the lightmap bake sees
+
+// Static light on the floor, sphere and cube, baked on the CPU in the
+// background whenever the light, a material or a prop changes, and cached
+// on disk under a key of all of them. The floor gets a lightmap, the convex
+// props a cubemap indexed by their normal; specular stays per vertex.
+LightmapBaker lightmapBaker;
+const int kFloorLightmapSize = 256;
+const int kPropLightmapSize = 32;
+const char* lightmapCacheDirectory = "Assets/lightmaps";
+const int kLightmapCacheFiles = 16;     // most recently used kept, ~300 KB each
+GLuint floorLightmap = 0;
+GLuint propLightmaps[2] = { 0, 0 };     // sphere, cube
+uint64_t lightmapKey = 0, uploadedLightmapKey = 0;
+bool reflectedPass = false;             // mirrored draws, whose normals don't match the bake
+
+// drawFloor()'s quads as one mesh, facing up
+RasterMesh makeFloorMesh()
+{
+    RasterMesh mesh;
+    const float corners[4][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+    for (int i = -10; i < 10; ++i)
+        for (int j = -10; j < 10; ++j)
+        {
+            uint32_t first = (uint32_t)mesh.positions.size();
+            for (const float* corner : corners)
+            {
+                addVertex(mesh, vec3(i + corner[0], 0.0f, j + corner[1]), vec3(0.0f, 1.0f, 0.0f));
+                mesh.uvs.push_back(corner[0]);
+                mesh.uvs.push_back(corner[1]);
+            }
+            addQuad(mesh, first, first + 1, first + 2, first + 3);
+        }
+    return mesh;
+}
+
+// CPU copies of the textures and the scene's solids for the software rasterizer
+RasterTexture floorImage;
+RasterCubemap skyboxImage;
+RasterMesh sphereMesh = makeSphereMesh(1.0f, 20, 20);
+RasterMesh cylinderMesh = makeCylinderMesh(1.0f, 1.0f, 20);
+RasterMesh cubeMesh = makeCubeMesh(1.0f);
+RasterMesh teapotMesh = makeTeapotMesh(1.0f, 10);
+RasterMesh floorMesh = makeFloorMesh();
+
+// The skybox's irradiance, cached next to its images. setupLighting() scales
+// it so its average brightness follows ambientStrength.
+SkyIrradiance skyIrradiance;
+const char* skyIrradiancePath = "Assets/field-skyboxes/irradiance.cache";
+float skyAmbientScale = 0.0f;
+float skyAmbientMatrices[3][16];    // world space, scaled
+
+// The draw functions issue their transforms, materials and solids through
+// the scene* calls below, so the same code feeds either backend: straight to
+// GL, or into a matrix stack and material state mirroring GL's that queue
+// meshes on the software rasterizer, or on the path tracer while capturing.
+SoftRasterizer softRasterizer;
+PathTracer* pathTraceCapture = NULL;
+bool softwareView = false;
+std::vector<glm::mat4> softwareMatrices(1, glm::mat4(1.0f));
+RasterMaterial softwareMaterial;
+RasterLight softwareLight;
+
+void scenePushMatrix()
+{
+    if (softwareView)
+        softwareMatrices.push_back(softwareMatrices.back());
+    else
+        glPushMatrix();
+}
+
+void scenePopMatrix()
+{
+    if (softwareView)
+        softwareMatrices.pop_back();
+    else
+        glPopMatrix();
+}
+
+void sceneTranslate(float x, float y, float z)
+{
+    if (softwareView)
+        softwareMatrices.back() = glm::translate(softwareMatrices.back(), glm::vec3(x, y, z));
+    else
+        glTranslatef(x, y, z);
+}
+
+void sceneRotate(float angle, float x, float y, float z)
+{
+    if (softwareView)
+        softwareMatrices.back() = glm::rotate(softwareMatrices.back(), glm::radians(angle), glm::vec3(x, y, z));
+    else
+        glRotatef(angle, x, y, z);
+}
+
+void sceneMultMatrix(const glm::mat4& matrix)
+{
+    if (softwareView)
+        softwareMatrices.back() = softwareMatrices.back() * matrix;
+    else
+        glMultMatrixf(glm::value_ptr(matrix));
+}
+
+float* softwareMaterialColor(GLenum pname)
+{
+    switch (pname)
+    {
+    case GL_AMBIENT: return softwareMaterial.ambient;
+    case GL_DIFFUSE: return softwareMaterial.diffuse;
+    case GL_SPECULAR: return softwareMaterial.specular;
+    default: return softwareMaterial.emission;
+    }
+}
+
+// GL_FRONT material colours and shininess
+void sceneMaterial(GLenum pname, const GLfloat* values)
+{
+    if (softwareView)
+        memcpy(softwareMaterialColor(pname), values, 4 * sizeof(GLfloat));
+    else
+        glMaterialfv(GL_FRONT, pname, values);
+}
+
+void sceneGetMaterial(GLenum pname, GLfloat* values)
+{
+    if (softwareView)
+        memcpy(values, softwareMaterialColor(pname), 4 * sizeof(GLfloat));
+    else
+        glGetMaterialfv(GL_FRONT, pname, values);
+}
+
+void sceneShininess(float shininess)
+{
+    if (softwareView)
+        softwareMaterial.shininess = shininess;
+    else
+        glMaterialf(GL_FRONT, GL_SHININESS, shininess);
+}
+
+void softwareDraw(const RasterMesh& mesh, const glm::mat4& model, const RasterTexture* texture)
+{
+    Mat4 modelView;
+    memcpy(modelView.m, glm::value_ptr(softwareMatrices.back() * model), sizeof(modelView.m));
+    if (pathTraceCapture)
+        pathTraceCapture->addMesh(mesh, modelView, softwareMaterial, texture);
+    else
+        softRasterizer.draw(mesh, modelView, softwareMaterial, texture);
+}
+
+void sceneSphere(float radius)
+{
+    if (softwareView)
+        softwareDraw(sphereMesh, glm::scale(glm::mat4(1.0f), glm::vec3(radius)), NULL);
+    else
+        glutSolidSphere(radius, sceneConfig.tessellation, sceneConfig.tessellation);
+}
+
+void sceneCube(float size)
+{
+    if (softwareView)
+        softwareDraw(cubeMesh, glm::scale(glm::mat4(1.0f), glm::vec3(size)), NULL);
+    else
+        glutSolidCube(size);
+}
+
+void sceneTeapot(float size)
+{
+    if (softwareView)
+        softwareDraw(teapotMesh, glm::scale(glm::mat4(1.0f), glm::vec3(size)), NULL);
+    else
+        glutSolidTeapot(size);
+}
+
+bool useSkyAmbient()
+{
+    return sceneConfig.skyAmbient && skyIrradiance.valid;
+}
+
+void setupLighting()
+{
+    glEnable(GL_LIGHTING);
+    glEnable(GL_LIGHT0);
+
+    GLfloat ambientLight[] = { world.ambientStrength, world.ambientStrength, world.ambientStrength, 1.0f };
+    if (useSkyAmbient())
+    {
+        // The sky's average irradiance, scaled to the slider's brightness
+        Vec3 average = skyIrradiance.average();
+        float luminance = 0.2126f * average.x + 0.7152f * average.y + 0.0722f * average.z;
+        skyAmbientScale = luminance > 0.0f ? world.ambientStrength / luminance : 0.0f;
+        skyIrradiance.matrices(skyAmbientMatrices, skyAmbientScale);
+        ambientLight[0] = average.x * skyAmbientScale;
+        ambientLight[1] = average.y * skyAmbientScale;
+        ambientLight[2] = average.z * skyAmbientScale;
+    }
+    glLightfv(GL_LIGHT0, GL_AMBIENT, ambientLight);
+
+    float intensity = sceneConfig.dimmableLight ? world.pointLightIntensity : 1.0f;
+    GLfloat diffuseLight[] = { intensity, intensity, intensity, 1.0f };
+    GLfloat specularLight[] = { intensity, intensity, intensity, 1.0f };
+    glLightfv(GL_LIGHT0, GL_DIFFUSE, diffuseLight);
+    glLightfv(GL_LIGHT0, GL_SPECULAR, specularLight);
+
+    memcpy(softwareLight.ambient, ambientLight, sizeof(ambientLight));
+    memcpy(softwareLight.diffuse, diffuseLight, sizeof(diffuseLight));
+    memcpy(softwareLight.specular, specularLight, sizeof(specularLight));
+    softwareLight.skyAmbient = false;
+}
+
+// Sky ambient for a software view: the world-space quadratic forms turned
+// into eye space, n_world = R^T n_eye with R the view's rotation
+void setSoftwareSkyAmbient(const glm::mat4& view)
+{
+    softwareLight.skyAmbient = useSkyAmbient();
+    if (!softwareLight.skyAmbient)
+        return;
+    glm::mat4 toWorld = glm::transpose(glm::mat4(glm::mat3(view)));
+    for (int c = 0; c < 3; ++c)
+    {
+        glm::mat4 m = glm::make_mat4(skyAmbientMatrices[c]);
+        glm::mat4 eye = glm::transpose(toWorld) * m * toWorld;
+        memcpy(softwareLight.ambientMatrices[c], glm::value_ptr(eye), sizeof(softwareLight.ambientMatrices[c]));
+    }
+}
+
+void positionLight()
+{
+    if (softwareView)
+    {
+        glm::vec4 eyePosition = softwareMatrices.back() * glm::make_vec4(world.lightPos);
+        memcpy(softwareLight.position, glm::value_ptr(eyePosition), sizeof(softwareLight.position));
+    }
+    else
+        glLightfv(GL_LIGHT0, GL_POSITION, world.lightPos);
+}
+
+// An image file decoded off the GL thread, with its CPU copy already built
+struct ImageLoad
+{
+    std::string path;
+    RasterTexture* copy;
+    bool mipmaps;
+    unsigned char* data = NULL;
+    int width = 0, height = 0, channels = 0;
+};
+
+// Decodes the files on the shared JobSystem, one job each, so only the GL
+// uploads are left for the thread with the context
+void decodeImages(std::vector<ImageLoad>& loads)
+{
+    JobSystem::shared().parallelFor(loads.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            ImageLoad& load = loads[i];
+            load.data = stbi_load(load.path.c_str(), &load.width, &load.height, &load.channels, 0);
+            if (load.data)
+                load.copy->setImage(load.data, load.width, load.height, load.channels, load.mipmaps);
+        }
+    }, 1);
+}
+
+bool loadTexture(const ImageLoad& load, GLuint& textureID)
+{
+    if (load.data)
+    {
+        GLenum format = load.channels == 3 ? GL_RGB : GL_RGBA;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, load.width, load.height, 0, format, GL_UNSIGNED_BYTE, load.data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return true;
+    }
+    else
+    {
+#ifdef DEBUG
+        std::cerr << "Failed to load texture: " << load.path << std::endl;
+#endif
+        return false;
+    }
+}
+
+// faces are the six decoded faces in GL's +X, -X, +Y, -Y, +Z, -Z order
+bool loadCubemapTexture(const ImageLoad* faces, GLuint& textureID)
+{
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+    for (unsigned int i = 0; i < 6; i++)
+    {
+        if (faces[i].data)
+        {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, faces[i].width, faces[i].height, 0, GL_RGB, GL_UNSIGNED_BYTE, faces[i].data);
+        }
+        else
+        {
+#ifdef DEBUG
+            std::cerr << "Cubemap texture failed to load at path: " << faces[i].path << std::endl;
+#endif
+            return false;
+        }
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    return true;
+}
+
+// Mirrors a texture's base level, left to right or top to bottom
+void mirrorImage(RasterTexture& image, bool horizontal)
+{
+    if (image.empty())
+        return;
+    RasterTexture::Level& level = image.levels[0];
+    for (int y = 0; y < level.height; ++y)
+        for (int x = 0; x < level.width; ++x)
+        {
+            int mx = horizontal ? level.width - 1 - x : x, my = horizontal ? y : level.height - 1 - y;
+            if (my * level.width + mx > y * level.width + x)
+                std::swap(level.texels[(size_t)y * level.width + x], level.texels[(size_t)my * level.width + mx]);
+        }
+}
+
+void loadTextures()
+{
+    std::vector<std::string> faces
+    {
+        "Assets/field-skyboxes/right.bmp",
+        "Assets/field-skyboxes/left.bmp",
+        "Assets/field-skyboxes/top.bmp",
+        "Assets/field-skyboxes/bottom.bmp",
+        "Assets/field-skyboxes/front.bmp",
+        "Assets/field-skyboxes/back.bmp"
+    };
+
+    // The sky faces first, then the floor
+    std::vector<ImageLoad> loads(faces.size() + 1);
+    for (size_t i = 0; i < faces.size(); ++i)
+    {
+        loads[i].path = faces[i];
+        loads[i].copy = &skyboxImage.faces[i];
+        loads[i].mipmaps = false;
+    }
+    loads.back().path = "Assets/tiles_0006_color_1k.jpg";
+    loads.back().copy = &floorImage;
+    loads.back().mipmaps = true;
+    decodeImages(loads);
+
+    loadTexture(loads.back(), floorTexture);
+    loadCubemapTexture(loads.data(), cubemapTexture);
+    for (ImageLoad& load : loads)
+        stbi_image_free(load.data);
+
+    // drawSkybox()'s texture coordinates mirror the top and front faces; bake
+    // that into the CPU copy so the software sky looks the same
+    mirrorImage(skyboxImage.faces[2], false);
+    mirrorImage(skyboxImage.faces[4], true);
+
+    // Projected from the sky as it's drawn, so after the mirroring
+    uint64_t signature = fileSignature(faces);
+    if (skyboxImage.empty() || skyIrradiance.load(skyIrradiancePath, signature))
+        return;
+    skyIrradiance.project(skyboxImage);
+    if (!skyIrradiance.save(skyIrradiancePath, signature))
+    {
+#ifdef DEBUG
+        std::cerr << "Failed to write " << skyIrradiancePath << std::endl;
+#endif
+    }
+}
+
+void drawLightBox()
+{
+    scenePushMatrix();
+    sceneTranslate(world.lightPos[0], world.lightPos[1], world.lightPos[2]);
+
+    GLfloat prevMaterial[4];
+    sceneGetMaterial(GL_AMBIENT, prevMaterial);
+
+    GLfloat yellow[] = { 1.0f, 1.0f, 0.0f, 1.0f };
+    GLfloat emission[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+    sceneMaterial(GL_AMBIENT, yellow);
+    sceneMaterial(GL_DIFFUSE, yellow);
+    sceneMaterial(GL_SPECULAR, yellow);
+    sceneMaterial(GL_EMISSION, emission);
+    sceneShininess(50.0f);
+
+    sceneCube(0.2f);
+
+    sceneMaterial(GL_AMBIENT, prevMaterial);
+    sceneMaterial(GL_EMISSION, prevMaterial);
+
+    scenePopMatrix();
+}
+
+void drawRobotHead()
+{
+    if (!world.headVisible)
+        return;
+
+    scenePushMatrix();
+    sceneTranslate(0.0f, 1.75f, 0.0f);
+    sceneRotate(world.headYaw, 0.0f, 1.0f, 0.0f);
+    sceneRotate(world.headPitch, 1.0f, 0.0f, 0.0f);
+    glColor3f(0.0f, 1.0f, 0.0f);
+    sceneSphere(0.5f);
+
+    scenePushMatrix();
+    glColor3f(1.0f, 1.0f, 1.0f);
+    sceneTranslate(0.2f, 0.1f, -0.45f);
+    sceneSphere(0.1f);
+    sceneTranslate(-0.4f, 0.0f, 0.0f);
+    sceneSphere(0.1f);
+    scenePopMatrix();
+
+    scenePopMatrix();
+}
+
+void drawLimb(float length, float radius)
+{
+    if (softwareView)
+    {
+        softwareDraw(cylinderMesh, glm::scale(glm::mat4(1.0f), glm::vec3(radius, radius, length)), NULL);
+        return;
+    }
+    GLUquadric* quadric = gluNewQuadric();
+    gluCylinder(quadric, radius, radius, length, sceneConfig.tessellation, sceneConfig.tessellation);
+    gluDeleteQuadric(quadric);
+}
+
+void drawJoint(float radius)
+{
+    sceneSphere(radius);
+}
+
+void drawRightArm()
+{
+    scenePushMatrix();
+    sceneTranslate(0.65f, 1.0f, 0.0f);
+
+    glm::quat shoulderQuaternion = glm::angleAxis(glm::radians(world.shoulderYaw), glm::vec3(0.0f, 1.0f, 0.0f)) *
+        glm::angleAxis(glm::radians(world.shoulderPitch), glm::vec3(1.0f, 0.0f, 0.0f)) *
+        glm::angleAxis(glm::radians(world.shoulderRoll), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 shoulderRotation = glm::toMat4(shoulderQuaternion);
+
+    sceneMultMatrix(shoulderRotation);
+    glColor3f(0.0f, 1.0f, 0.0f);
+    drawJoint(0.25f);
+
+    scenePushMatrix();
+    sceneTranslate(0.0f, -0.25f, 0.0f);
+    sceneRotate(90, 1.0f, 0.0f, 0.0f);
+    glColor3f(0.0f, 0.0f, 1.0f);
+    drawLimb(0.25f, 0.1f);
+    scenePopMatrix();
+
+    sceneTranslate(0.0f, -0.5f, 0.0f);
+
+    glm::quat elbowQuaternion = glm::angleAxis(glm::radians(world.elbowYaw), glm::vec3(0.0f, 1.0f, 0.0f)) *
+        glm::angleAxis(glm::radians(world.elbowPitch), glm::vec3(1.0f, 0.0f, 0.0f)) *
+        glm::angleAxis(glm::radians(world.elbowRoll), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 elbowRotation = glm::toMat4(elbowQuaternion);
+
+    sceneMultMatrix(elbowRotation);
+    glColor3f(0.0f, 1.0f, 0.0f);
+    drawJoint(0.2f);
+
+    scenePushMatrix();
+    sceneTranslate(0.0f, -0.25f, 0.0f);
+    sceneRotate(90, 1.0f, 0.0f, 0.0f);
+    glColor3f(0.0f, 0.0f, 1.0f);
+    drawLimb(0.25f, 0.1f);
+    scenePopMatrix();
+
+    sceneTranslate(0.0f, -0.5f, 0.0f);
+
+    glm::quat wristQuaternion = glm::angleAxis(glm::radians(world.wristYaw), glm::vec3(0.0f, 1.0f, 0.0f)) *
+        glm::angleAxis(glm::radians(world.wristPitch), glm::vec3(1.0f, 0.0f, 0.0f)) *
+        glm::angleAxis(glm::radians(world.wristRoll), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 wristRotation = glm::toMat4(wristQuaternion);
+
+    sceneMultMatrix(wristRotation);
+    glColor3f(0.0f, 1.0f, 0.0f);
+    drawJoint(0.15f);
+
+    scenePushMatrix();
+    sceneTranslate(0.0f, -0.1f, 0.0f);
+    sceneRotate(90, 1.0f, 0.0f, 0.0f);
+    glColor3f(0.0f, 0.0f, 1.0f);
+    drawLimb(0.2f, 0.05f);
+    scenePopMatrix();
+
+    scenePopMatrix();
+}
+
+void drawLeg(float hipAngle, float kneeAngle, float translateX, float translateY, float translateZ)
+{
+    scenePushMatrix();
+    sceneTranslate(translateX, translateY, translateZ);
+    sceneRotate(hipAngle, 1.0f, 0.0f, 0.0f);
+
+    glColor3f(0.0f, 1.0f, 0.0f);
+    drawJoint(0.2f);
+
+    scenePushMatrix();
+    sceneTranslate(0.0f, -0.1f, 0.0f);
+    sceneRotate(90.0f, 1.0f, 0.0f, 0.0f);
+    glColor3f(0.0f, 0.0f, 1.0f);
+    drawLimb(0.35f, 0.2f);
+    scenePopMatrix();
+
+    sceneTranslate(0.0f, -0.55f, 0.0f);
+    sceneRotate(kneeAngle, 1.0f, 0.0f, 0.0f);
+
+    glColor3f(0.0f, 1.0f, 0.0f);
+    drawJoint(0.18f);
+
+    scenePushMatrix();
+    sceneTranslate(0.0f, 0.0f, 0.0f);
+    glColor3f(0.0f, 0.0f, 1.0f);
+    sceneRotate(90.0f, 1.0f, 0.0f, 0.0f);
+    drawLimb(0.35f, 0.16f);
+    scenePopMatrix();
+
+    scenePopMatrix();
+}
+
+void drawNeck()
+{
+    sceneTranslate(0.0f, 1.125f, 0.0f);
+    drawJoint(0.25f);
+}
+
+void drawRobot()
+{
+    sceneMaterial(GL_DIFFUSE, world.robotDiffuse);
+    sceneMaterial(GL_SPECULAR, world.robotSpecular);
+    sceneShininess(world.robotShininess);
+
+    scenePushMatrix();
+    sceneTranslate(world.robot.x, world.robot.y, world.robot.z);
+    sceneRotate(world.robot.rotation, 0.0f, 1.0f, 0.0f);
+
+    drawLeg(world.robot.leftHipAngle, world.robot.leftKneeAngle, -0.25f, 0.0f, 0.0f); // Left leg
+    drawLeg(world.robot.rightHipAngle, world.robot.rightKneeAngle, 0.25f, 0.0f, 0.0f); // Right leg
+
+    scenePushMatrix();
+    sceneTranslate(0.0f, 0.9f, 0.0f);
+    sceneRotate(90.0f, 1.0f, 0.0f, 0.0f);
+    glColor3f(0.0f, 0.0f, 1.0f);
+    drawLimb(0.75f, 0.15f);
+    scenePopMatrix();
+
+    drawJoint(0.18f);
+
+    drawRobotHead();
+    drawRightArm();
+
+    drawNeck();
+
+    scenePopMatrix();
+}
+
+bool bakedLightingReady()
+{
+    return sceneConfig.bakedLighting && !sceneConfig.softwareRaster && lightmapKey != 0 && uploadedLightmapKey == lightmapKey;
+}
+
+float bakedLightingProgress()
+{
+    return bakedLightingReady() ? 1.0f : lightmapBaker.progress();
+}
+
+bool useBakedLighting()
+{
+    return !softwareView && !depthOnlyPass && !reflectedPass && bakedLightingReady();
+}
+
+// The baked textures replace the lit colour, then the per-vertex specular
+// is added on top of them
+void beginBakedLighting()
+{
+    glPushAttrib(GL_LIGHTING_BIT | GL_TEXTURE_BIT | GL_ENABLE_BIT);
+    glLightModeli(GL_LIGHT_MODEL_COLOR_CONTROL, GL_SEPARATE_SPECULAR_COLOR);
+}
+
+// The floor texture on unit 0 replaces the lit colour and the lightmap on
+// unit 1 modulates it, through texgen on the floor's object coordinates
+void beginBakedFloor()
+{
+    const GLfloat sPlane[4] = { 0.5f / kFloorHalfSize, 0.0f, 0.0f, 0.5f };
+    const GLfloat tPlane[4] = { 0.0f, 0.0f, 0.5f / kFloorHalfSize, 0.5f };
+    beginBakedLighting();
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, floorLightmap);
+    glEnable(GL_TEXTURE_2D);
+    glTexGeni(GL_S, GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
+    glTexGeni(GL_T, GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
+    glTexGenfv(GL_S, GL_OBJECT_PLANE, sPlane);
+    glTexGenfv(GL_T, GL_OBJECT_PLANE, tPlane);
+    glEnable(GL_TEXTURE_GEN_S);
+    glEnable(GL_TEXTURE_GEN_T);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// Like the teapot's reflection, but texgen makes eye-space normals, which
+// the texture matrix turns back into world space
+void beginBakedProp(GLuint lightmap)
+{
+    beginBakedLighting();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, lightmap);
+    glEnable(GL_TEXTURE_CUBE_MAP);
+    glTexGeni(GL_S, GL_TEXTURE_GEN_MODE, GL_NORMAL_MAP);
+    glTexGeni(GL_T, GL_TEXTURE_GEN_MODE, GL_NORMAL_MAP);
+    glTexGeni(GL_R, GL_TEXTURE_GEN_MODE, GL_NORMAL_MAP);
+    glEnable(GL_TEXTURE_GEN_S);
+    glEnable(GL_TEXTURE_GEN_T);
+    glEnable(GL_TEXTURE_GEN_R);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+
+    glMatrixMode(GL_TEXTURE);
+    glLoadMatrixf(glm::value_ptr(glm::transpose(glm::mat4(glm::mat3(currentView)))));
+    glMatrixMode(GL_MODELVIEW);
+}
+
+void endBakedLighting()
+{
+    glMatrixMode(GL_TEXTURE);
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
+}
+
+// drawFloor() on terrain: the chunks the terrain placed, in world space
+void drawTerrain()
+{
+    if (softwareView)
+    {
+        if (pathTraceCapture == &lightmapBaker.scene)
+        {
+            softwareDraw(bakeGround, glm::mat4(1.0f), &floorImage);
+            return;
+        }
+        for (int index : terrain.activeChunks())
+        {
+            TerrainChunk& chunk = terrain.chunk(index);
+            if (terrain.prepareMesh(chunk) && (softwareCullPlanes == NULL || insidePlanes(chunk.bounds, softwareCullPlanes, 6)))
+                softwareDraw(chunk.mesh, glm::mat4(1.0f), &floorImage);
+        }
+        return;
+    }
+
+    // As on the floor, the sky ambient is the upward one; slopes are close
+    // enough to it
+    GLfloat ambientLight[4];
+    if (useSkyAmbient())
+    {
+        glGetLightfv(GL_LIGHT0, GL_AMBIENT, ambientLight);
+        Vec3 up = skyIrradiance.evaluate(vec3(0.0f, 1.0f, 0.0f), skyAmbientScale);
+        GLfloat floorAmbient[4] = { up.x, up.y, up.z, 1.0f };
+        glLightfv(GL_LIGHT0, GL_AMBIENT, floorAmbient);
+    }
+
+    glm::mat4 projection, modelView;
+    glGetFloatv(GL_PROJECTION_MATRIX, glm::value_ptr(projection));
+    glGetFloatv(GL_MODELVIEW_MATRIX, glm::value_ptr(modelView));
+    float planes[6][4];
+    frustumPlanes(glm::value_ptr(projection * modelView), planes);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, floorTexture);
+    glEnable(GL_TEXTURE_2D);
+    terrainRenderer.draw(terrain, planes, 6, true);
+    glDisable(GL_TEXTURE_2D);
+
+    if (useSkyAmbient())
+        glLightfv(GL_LIGHT0, GL_AMBIENT, ambientLight);
+}
+
+void drawFloor()
+{
+    sceneMaterial(GL_SPECULAR, world.floorSpecular);
+    sceneShininess(128.0f - world.floorShininess);  // Adjust shininess correctly
+    sceneMaterial(GL_DIFFUSE, world.floorDiffuse);
+    if (terrainActive())
+    {
+        drawTerrain();
+        return;
+    }
+
+    scenePushMatrix();
+    sceneTranslate(0.0f, -0.9f, 0.0f);
+
+    // The GL path leaves the floor's normal to whatever was drawn last; the mesh faces up
+    if (softwareView)
+    {
+        softwareDraw(floorMesh, glm::mat4(1.0f), &floorImage);
+        scenePopMatrix();
+        return;
+    }
+
+    // Fixed-function ambient can't vary per vertex, but the floor only ever faces up
+    bool baked = useBakedLighting();
+    GLfloat ambientLight[4];
+    if (useSkyAmbient() && !baked)
+    {
+        glGetLightfv(GL_LIGHT0, GL_AMBIENT, ambientLight);
+        Vec3 up = skyIrradiance.evaluate(vec3(0.0f, 1.0f, 0.0f), skyAmbientScale);
+        GLfloat floorAmbient[4] = { up.x, up.y, up.z, 1.0f };
+        glLightfv(GL_LIGHT0, GL_AMBIENT, floorAmbient);
+    }
+
+    // Bind floor texture
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, floorTexture);
+
+    glEnable(GL_TEXTURE_2D);
+    if (baked)
+    {
+        beginBakedFloor();
+        glNormal3f(0.0f, 1.0f, 0.0f);
+    }
+    glBegin(GL_QUADS);
+    for (int i = -10; i < 10; ++i)
+    {
+        for (int j = -10; j < 10; ++j)
+        {
+            glTexCoord2f(0.0f, 0.0f); glVertex3f(i, 0.0f, j);
+            glTexCoord2f(1.0f, 0.0f); glVertex3f(i + 1, 0.0f, j);
+            glTexCoord2f(1.0f, 1.0f); glVertex3f(i + 1, 0.0f, j + 1);
+            glTexCoord2f(0.0f, 1.0f); glVertex3f(i, 0.0f, j + 1);
+        }
+    }
+    glEnd();
+    if (baked)
+        endBakedLighting();
+    glDisable(GL_TEXTURE_2D);
+
+    if (useSkyAmbient() && !baked)
+        glLightfv(GL_LIGHT0, GL_AMBIENT, ambientLight);
+
+    scenePopMatrix();
+}
+
+void drawPlasticSphere()
+{
+    sceneMaterial(GL_DIFFUSE, world.plasticDiffuse);
+    sceneMaterial(GL_SPECULAR, world.plasticSpecular);
+    sceneShininess(world.plasticShininess);
+
+    bool baked = useBakedLighting();
+    if (baked)
+        beginBakedProp(propLightmaps[0]);
+
+    scenePushMatrix();
+    sceneTranslate(spherePosition[0], spherePosition[1], spherePosition[2]);
+    sceneSphere(0.5f);
+    scenePopMatrix();
+
+    if (baked)
+        endBakedLighting();
+}
+
+void drawTexturedCube()
+{
+    sceneMaterial(GL_DIFFUSE, world.cubeDiffuse);
+    sceneMaterial(GL_SPECULAR, world.cubeSpecular);
+    sceneShininess(world.cubeShininess);
+
+    bool baked = useBakedLighting();
+    if (baked)
+        beginBakedProp(propLightmaps[1]);
+
+    scenePushMatrix();
+    sceneTranslate(cubePosition[0], cubePosition[1], cubePosition[2]);
+    sceneCube(1.0f);
+    scenePopMatrix();
+
+    if (baked)
+        endBakedLighting();
+}
+
+// Fixed-function reflection mapping: texgen makes eye-space reflection
+// vectors, the texture matrix turns them back into world space, and the
+// cubemap is blended over the lit colour by the teapot's reflectivity
+void beginTeapotReflection()
+{
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, teapotProbe.texture);
+    glEnable(GL_TEXTURE_CUBE_MAP);
+    glTexGeni(GL_S, GL_TEXTURE_GEN_MODE, GL_REFLECTION_MAP);
+    glTexGeni(GL_T, GL_TEXTURE_GEN_MODE, GL_REFLECTION_MAP);
+    glTexGeni(GL_R, GL_TEXTURE_GEN_MODE, GL_REFLECTION_MAP);
+    glEnable(GL_TEXTURE_GEN_S);
+    glEnable(GL_TEXTURE_GEN_T);
+    glEnable(GL_TEXTURE_GEN_R);
+
+    glMatrixMode(GL_TEXTURE);
+    glLoadMatrixf(glm::value_ptr(glm::transpose(glm::mat4(glm::mat3(currentView)))));
+    glMatrixMode(GL_MODELVIEW);
+
+    GLfloat reflectivity[4] = { world.teapotReflectivity, world.teapotReflectivity, world.teapotReflectivity, world.teapotReflectivity };
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE);
+    glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_INTERPOLATE);
+    glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_RGB, GL_TEXTURE);
+    glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE1_RGB, GL_PRIMARY_COLOR);
+    glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE2_RGB, GL_CONSTANT);
+    glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND2_RGB, GL_SRC_COLOR);
+    glTexEnvfv(GL_TEXTURE_ENV, GL_TEXTURE_ENV_COLOR, reflectivity);
+}
+
+void endTeapotReflection()
+{
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glMatrixMode(GL_TEXTURE);
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glDisable(GL_TEXTURE_GEN_S);
+    glDisable(GL_TEXTURE_GEN_T);
+    glDisable(GL_TEXTURE_GEN_R);
+    glDisable(GL_TEXTURE_CUBE_MAP);
+}
+
+void drawMetalTeapot()
+{
+    if (!teapotVisible)
+        return;
+
+    sceneMaterial(GL_SPECULAR, world.teapotSpecular);
+    sceneMaterial(GL_DIFFUSE, world.teapotDiffuse);
+    sceneShininess(world.teapotShininess);
+
+    bool reflective = !softwareView && !depthOnlyPass && sceneConfig.teapotReflection && teapotProbe.ready();
+    if (reflective)
+        beginTeapotReflection();
+
+    scenePushMatrix();
+    sceneTranslate(teapotPosition[0], teapotPosition[1], teapotPosition[2]);
+    sceneTeapot(1.0f);
+    scenePopMatrix();
+
+    if (reflective)
+        endTeapotReflection();
+}
+
+void drawSkybox()
+{
+    // Terrain reaches far past the box, so it mustn't hide behind it
+    if (terrainActive())
+        glDepthMask(GL_FALSE);
+    glDepthFunc(GL_LEQUAL);
+    glEnable(GL_TEXTURE_CUBE_MAP);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+
+    glBegin(GL_QUADS);
+    glTexCoord3f(-1.0f, 1.0f, -1.0f); glVertex3f(-50.0f, 50.0f, -50.0f);
+    glTexCoord3f(-1.0f, -1.0f, -1.0f); glVertex3f(-50.0f, -50.0f, -50.0f);
+    glTexCoord3f(1.0f, -1.0f, -1.0f); glVertex3f(50.0f, -50.0f, -50.0f);
+    glTexCoord3f(1.0f, 1.0f, -1.0f); glVertex3f(50.0f, 50.0f, -50.0f);
+
+    glTexCoord3f(1.0f, 1.0f, 1.0f); glVertex3f(-50.0f, 50.0f, 50.0f);
+    glTexCoord3f(1.0f, -1.0f, 1.0f); glVertex3f(-50.0f, -50.0f, 50.0f);
+    glTexCoord3f(-1.0f, -1.0f, 1.0f); glVertex3f(50.0f, -50.0f, 50.0f);
+    glTexCoord3f(-1.0f, 1.0f, 1.0f); glVertex3f(50.0f, 50.0f, 50.0f);
+
+    glTexCoord3f(-1.0f, 1.0f, 1.0f); glVertex3f(-50.0f, 50.0f, -50.0f);
+    glTexCoord3f(1.0f, 1.0f, 1.0f); glVertex3f(50.0f, 50.0f, -50.0f);
+    glTexCoord3f(1.0f, 1.0f, -1.0f); glVertex3f(50.0f, 50.0f, 50.0f);
+    glTexCoord3f(-1.0f, 1.0f, -1.0f); glVertex3f(-50.0f, 50.0f, 50.0f);
+
+    glTexCoord3f(-1.0f, -1.0f, -1.0f); glVertex3f(-50.0f, -50.0f, -50.0f);
+    glTexCoord3f(1.0f, -1.0f, -1.0f); glVertex3f(50.0f, -50.0f, -50.0f);
+    glTexCoord3f(1.0f, -1.0f, 1.0f); glVertex3f(50.0f, -50.0f, 50.0f);
+    glTexCoord3f(-1.0f, -1.0f, 1.0f); glVertex3f(-50.0f, -50.0f, 50.0f);
+
+    glTexCoord3f(1.0f, -1.0f, -1.0f); glVertex3f(50.0f, -50.0f, -50.0f);
+    glTexCoord3f(1.0f, -1.0f, 1.0f); glVertex3f(50.0f, -50.0f, 50.0f);
+    glTexCoord3f(1.0f, 1.0f, 1.0f); glVertex3f(50.0f, 50.0f, 50.0f);
+    glTexCoord3f(1.0f, 1.0f, -1.0f); glVertex3f(50.0f, 50.0f, -50.0f);
+
+    glTexCoord3f(-1.0f, -1.0f, 1.0f); glVertex3f(-50.0f, -50.0f, 50.0f);
+    glTexCoord3f(-1.0f, -1.0f, -1.0f); glVertex3f(-50.0f, -50.0f, -50.0f);
+    glTexCoord3f(-1.0f, 1.0f, -1.0f); glVertex3f(-50.0f, 50.0f, -50.0f);
+    glTexCoord3f(-1.0f, 1.0f, 1.0f); glVertex3f(-50.0f, 50.0f, 50.0f);
+
+    glEnd();
+
+    glDisable(GL_TEXTURE_CUBE_MAP);
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+}
+
+// Matches drawPlasticSphere(), drawTexturedCube() and drawMetalTeapot()
+void buildPropCollision(CollisionScene& scene, const float* const positions[3])
+{
+    const float* sphere = positions[0];
+    const float* cube = positions[1];
+    const float* teapot = positions[2];
+    scene.props.clear();
+    scene.addSphere(vec3(sphere[0], sphere[1], sphere[2]), 0.5f);
+    scene.addBox(vec3(cube[0], cube[1], cube[2]), vec3(0.5f, 0.5f, 0.5f));
+    scene.addBox(vec3(teapot[0], teapot[1], teapot[2]), vec3(1.6f, 0.8f, 1.0f)); // approximate teapot bounds
+    scene.build();
+}
+
+void buildCollisionScene()
+{
+    buildPropCollision(collisionScene, propPositions);
+}
+
+void renderScene()
+{
+    positionLight();
+    drawFloor();
+    drawRobot();
+    drawLightBox();
+    drawPlasticSphere();
+    drawTexturedCube();
+    drawMetalTeapot();
+}
+
+void renderReflectedScene()
+{
+    if (!world.enableReflection)
+        return;
+
+    // Save the current attributes
+    glPushAttrib(GL_ALL_ATTRIB_BITS);
+
+    // Enable stencil testing
+    glEnable(GL_STENCIL_TEST);
+
+    // Configure stencil buffer
+    glStencilFunc(GL_ALWAYS, 1, 0xFF); // Set the stencil buffer to 1 where we draw
+    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+
+    // Clear the stencil buffer
+    glClear(GL_STENCIL_BUFFER_BIT);
+
+    // Draw the floor to mark it in the stencil buffer
+    glStencilFunc(GL_ALWAYS, 1, 0xFF);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+    drawFloor();
+
+    // Now draw only where the stencil buffer is marked with 1
+    glStencilFunc(GL_EQUAL, 1, 0xFF);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+
+    // Setup blending for reflection
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // Calculate reflection transformation based on light position
+    float reflectionOffsetX = world.lightPos[0] * 0.1f;
+    float reflectionOffsetZ = world.lightPos[2] * 0.1f;
+
+    // Scale to create reflection
+    glPushMatrix();
+    glTranslatef(reflectionOffsetX, -2.0f * (-0.9f), reflectionOffsetZ); // Translate the scene to be reflected correctly on the floor (floor is at y = -0.9)
+    glScalef(1.0f, -1.0f, 1.0f); // Flip vertically
+
+    // Adjust reflection brightness based on light intensity
+    glColor4f(world.pointLightIntensity, world.pointLightIntensity, world.pointLightIntensity, 0.5f); // 0.5 for semi-transparent reflection
+
+    // Render the scene
+    reflectedPass = true;
+    drawRobot();
+    drawPlasticSphere();
+    drawTexturedCube();
+    drawMetalTeapot();
+    reflectedPass = false;
+
+    glPopMatrix();
+
+    // Disable stencil testing
+    glDisable(GL_STENCIL_TEST);
+
+    // Restore the attributes
+    glPopAttrib();
+}
+
+void configureScene(const SceneConfig& config)
+{
+    sceneConfig = config;
+    for (int i = 0; i < 3; ++i)
+    {
+        spherePosition[i] = config.spherePosition[i];
+        cubePosition[i] = config.cubePosition[i];
+        teapotPosition[i] = config.teapotPosition[i];
+    }
+    buildCollisionScene();
+}
+
+bool loadTerrain(const char* path, float spacing, float heightRange)
+{
+    std::string source = path;
+    bool converted = source.size() > 8 && source.compare(source.size() - 8, 8, ".terrain") == 0;
+    std::string terrainPath = converted ? source : source + ".terrain";
+
+    // A heightmap's terrain file is remade when the image or the scale change
+    float settings[2] = { spacing, heightRange };
+    uint64_t signature = converted ? 0 : hashFloats(settings, 2, fileSignature({ source }));
+    if (!terrain.open(terrainPath.c_str()) || (!converted && terrain.signature() != signature))
+    {
+        terrain.close();
+        int width = 0, depth = 0, channels = 0;
+        unsigned short* pixels = converted ? NULL : stbi_load_16(path, &width, &depth, &channels, 1);
+        if (!pixels)
+        {
+#ifdef DEBUG
+            std::cerr << "Failed to load terrain: " << path << std::endl;
+#endif
+            return false;
+        }
+        std::vector<float> heights((size_t)width * depth);
+        for (size_t i = 0; i < heights.size(); ++i)
+            heights[i] = pixels[i] * (heightRange / 65535.0f);
+        stbi_image_free(pixels);
+        if (!Terrain::write(terrainPath.c_str(), heights.data(), width, depth, spacing, -0.9f, signature) || !terrain.open(terrainPath.c_str()))
+        {
+#ifdef DEBUG
+            std::cerr << "Failed to write terrain: " << terrainPath << std::endl;
+#endif
+            terrain.close();
+            return false;
+        }
+    }
+
+    // Props keep their height above the ground, the robot stands on it
+    for (float* position : propPositions)
+        position[1] += groundHeight(position[0], position[2]) + 0.9f;
+    buildCollisionScene();
+    placeOnGround(world, groundHeight);
+    return true;
+}
+
+bool terrainActive()
+{
+    return terrain.isOpen();
+}
+
+float groundHeight(float x, float z)
+{
+    return terrain.isOpen() ? terrain.height(x, z) : -0.9f;
+}
+
+void updateTerrain(const glm::vec3& eye)
+{
+    if (!terrain.isOpen())
+        return;
+    terrain.update(vec3(eye.x, eye.y, eye.z));
+    terrainRenderer.update(terrain);
+}
+
+void terrainStatistics(size_t& resident, size_t& building, size_t& drawn, size_t& triangles)
+{
+    resident = terrain.residentChunks();
+    building = terrain.buildingChunks();
+    drawn = terrainRenderer.drawnChunks;
+    triangles = terrainRenderer.drawnTriangles;
+}
+
+// Eye position and look-at target of the camera inside the robot's head
+void computeHeadCamera(glm::vec3& eye, glm::vec3& target)
+{
+    // Calculate the robot's rotation matrix
+    glm::mat4 robotRotationMatrix = glm::rotate(glm::mat4(1.0f), glm::radians(world.robot.rotation), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    // Transform the secondary camera's position using the robot's rotation matrix
+    glm::vec4 transformedSecCamPos = robotRotationMatrix * glm::vec4(world.secCamX, world.secCamY, world.secCamZ, 1.0f);
+    glm::vec4 transformedLookDir = robotRotationMatrix * glm::vec4(
+        sin(glm::radians(world.headCamYaw)) * cos(glm::radians(world.headCamPitch)),
+        sin(glm::radians(world.headCamPitch)),
+        -cos(glm::radians(world.headCamYaw)) * cos(glm::radians(world.headCamPitch)),
+        0.0f
+    );
+
+    eye = glm::vec3(world.robot.x, world.robot.y, world.robot.z) + glm::vec3(transformedSecCamPos);
+    target = eye + glm::vec3(transformedLookDir);
+}
+
+// Eye position and look-at target of the free-flying main camera
+void computeOrbitCamera(glm::vec3& eye, glm::vec3& target)
+{
+    eye = glm::vec3(world.camX, world.camY, world.camZ);
+    target = eye + glm::vec3(sin(world.camYaw), sin(world.camPitch), -cos(world.camYaw));
+}
+
+// Renders the view on the CPU and writes its colour and depth into the
+// current viewport, so overlays, insets and depth readback work unchanged.
+// The stencil reflection has no software equivalent and is left out.
+void drawSoftwareView(const glm::vec3& eye, const glm::vec3& target, float fovY, float aspect, float nearPlane, float farPlane, bool fromHead)
+{
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLfloat clearColor[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+
+    glm::mat4 projection = glm::perspective(glm::radians(fovY), aspect, nearPlane, farPlane);
+    glm::mat4 view = glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+    Mat4 rasterProjection, rasterView;
+    memcpy(rasterProjection.m, glm::value_ptr(projection), sizeof(rasterProjection.m));
+    memcpy(rasterView.m, glm::value_ptr(view), sizeof(rasterView.m));
+    softRasterizer.begin(viewport[2], viewport[3], rasterProjection, clearColor);
+    softRasterizer.setSky(&skyboxImage, rasterView);
+
+    float planes[6][4];
+    frustumPlanes(glm::value_ptr(projection * view), planes);
+    softwareCullPlanes = planes;
+    softwareView = true;
+    softwareMatrices.assign(1, view);
+    bool headWasVisible = world.headVisible;
+    world.headVisible = headWasVisible && !fromHead;
+    renderScene();
+    world.headVisible = headWasVisible;
+    softwareView = false;
+    softwareCullPlanes = NULL;
+
+    setSoftwareSkyAmbient(view);
+    softRasterizer.setLight(softwareLight);
+    softRasterizer.render();
+
+    glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_TEXTURE_2D);
+    glDisable(GL_BLEND);
+    glWindowPos2i(viewport[0], viewport[1]);
+    glDrawPixels(viewport[2], viewport[3], GL_RGBA, GL_UNSIGNED_BYTE, softRasterizer.color());
+
+    // Depth is only written with the depth test on, so it's on and always passes
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_ALWAYS);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDrawPixels(viewport[2], viewport[3], GL_DEPTH_COMPONENT, GL_FLOAT, softRasterizer.depth());
+    glPopAttrib();
+
+    // GL drawing after the view, like the selection box, expects its matrices
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrixf(glm::value_ptr(projection));
+    glMatrixMode(GL_MODELVIEW);
+    glLoadMatrixf(glm::value_ptr(view));
+}
+
+void capturePathTraceScene(PathTracer& tracer, bool fromHead)
+{
+    tracer.clear();
+    pathTraceCapture = &tracer;
+    softwareView = true;
+    softwareMatrices.assign(1, glm::mat4(1.0f));
+    bool headWasVisible = world.headVisible;
+    world.headVisible = headWasVisible && !fromHead;
+    renderScene();
+    world.headVisible = headWasVisible;
+    softwareView = false;
+    pathTraceCapture = NULL;
+
+    // GL's light doesn't fall off with distance; scale it so the ground right
+    // below it gets the same irradiance either way
+    const float* position = softwareLight.position;
+    float height = position[3] != 0.0f ? position[1] / position[3] - groundHeight(position[0] / position[3], position[2] / position[3]) : 1.0f;
+    float scale = height > 0.0f ? height * height : 1.0f;
+    tracer.setLight(position, vec3(softwareLight.diffuse[0], softwareLight.diffuse[1], softwareLight.diffuse[2]) * scale);
+    tracer.setEnvironment(&skyboxImage);
+    tracer.build();
+}
+
+// Darkens the floor where the shadow map says it's hidden from the light:
+// one quad over the lit floor, or the terrain chunks the light's frustum
+// reaches, its alpha the shadow comparison times the shadow strength.
+// Per-vertex lighting can't take the light away per pixel, so shadows scale
+// the lit colour instead.
+void drawFloorShadow()
+{
+    if (!sceneConfig.shadows || !shadowMap.ready())
+        return;
+
+    float strength = world.shadowStrength * (sceneConfig.dimmableLight ? world.pointLightIntensity : 1.0f);
+    GLfloat shade[4] = { 0.0f, 0.0f, 0.0f, strength };
+    static const GLfloat planes[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+    static const GLenum coords[4] = { GL_S, GL_T, GL_R, GL_Q };
+
+    glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_POLYGON_BIT | GL_TEXTURE_BIT);
+    glDisable(GL_LIGHTING);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(-1.0f, -1.0f);
+
+    // The quad is drawn in world space, so object-linear texgen gives world
+    // positions and the texture matrix takes them into the map
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, shadowMap.texture);
+    glEnable(GL_TEXTURE_2D);
+    for (int i = 0; i < 4; ++i)
+    {
+        glTexGeni(coords[i], GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
+        glTexGenfv(coords[i], GL_OBJECT_PLANE, planes[i]);
+    }
+    glEnable(GL_TEXTURE_GEN_S);
+    glEnable(GL_TEXTURE_GEN_T);
+    glEnable(GL_TEXTURE_GEN_R);
+    glEnable(GL_TEXTURE_GEN_Q);
+
+    glm::mat4 bias = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)), glm::vec3(0.5f));
+    glMatrixMode(GL_TEXTURE);
+    glLoadMatrixf(glm::value_ptr(bias * shadowMatrix));
+    glMatrixMode(GL_MODELVIEW);
+
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE);
+    glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_REPLACE);
+    glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_RGB, GL_CONSTANT);
+    glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_ALPHA, GL_MODULATE);
+    glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_ALPHA, GL_TEXTURE);
+    glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE1_ALPHA, GL_CONSTANT);
+    glTexEnvfv(GL_TEXTURE_ENV, GL_TEXTURE_ENV_COLOR, shade);
+
+    if (terrainActive())
+    {
+        float planes[6][4];
+        frustumPlanes(glm::value_ptr(shadowMatrix), planes);
+        terrainRenderer.draw(terrain, planes, 6, false);
+    }
+    else
+    {
+        glBegin(GL_QUADS);
+        glVertex3f(-kFloorHalfSize, -0.9f, -kFloorHalfSize);
+        glVertex3f(-kFloorHalfSize, -0.9f, kFloorHalfSize);
+        glVertex3f(kFloorHalfSize, -0.9f, kFloorHalfSize);
+        glVertex3f(kFloorHalfSize, -0.9f, -kFloorHalfSize);
+        glEnd();
+    }
+
+    glMatrixMode(GL_TEXTURE);
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
+}
+
+// Only the per-view work happens here; camera poses and the light colours
+// are set up once per frame by the caller
+void drawView(const glm::vec3& eye, const glm::vec3& target, float fovY, float aspect, float nearPlane, float farPlane, bool fromHead)
+{
+    if (sceneConfig.softwareRaster)
+    {
+        drawSoftwareView(eye, target, fovY, aspect, nearPlane, farPlane, fromHead);
+        return;
+    }
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluPerspective(fovY, aspect, nearPlane, farPlane);
+
+    glMatrixMode(GL_MODELVIEW);
+    currentView = glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+    glLoadMatrixf(glm::value_ptr(currentView));
+
+    glPushMatrix();
+    glTranslatef(eye.x, eye.y, eye.z);
+    drawSkybox();
+    glPopMatrix();
+
+    bool headWasVisible = world.headVisible;
+    world.headVisible = headWasVisible && !fromHead;
+    if (sceneConfig.reflection && !sceneConfig.dropReflection && !terrainActive())
+    {
+        positionLight();
+        renderReflectedScene();
+    }
+    renderScene();
+    drawFloorShadow();
+    world.headVisible = headWasVisible;
+}
+
+void updateTeapotReflection(double now)
+{
+    if (!sceneConfig.teapotReflection || sceneConfig.softwareRaster)
+        return;
+    bool resized = teapotProbe.isActive() && teapotProbe.size != sceneConfig.teapotProbeSize;
+    if ((!teapotProbe.isActive() || resized) && !teapotProbe.init(sceneConfig.teapotProbeSize))
+    {
+#ifdef DEBUG
+        std::cerr << "Teapot reflection framebuffer is incomplete" << std::endl;
+#endif
+        sceneConfig.teapotReflection = false;
+        return;
+    }
+    teapotProbe.rate = sceneConfig.teapotProbeRate;
+    if (!teapotProbe.due(now))
+        return;
+
+    // The scene without the teapot itself, and without the floor reflection
+    teapotProbe.update(now, [](int face)
+    {
+        float direction[3], up[3];
+        EnvironmentProbe::faceBasis(face, direction, up);
+        glm::vec3 eye(teapotPosition[0], teapotPosition[1], teapotPosition[2]);
+
+        glMatrixMode(GL_PROJECTION);
+        glLoadIdentity();
+        gluPerspective(90.0f, 1.0f, 0.1f, 1000.0f);
+        glMatrixMode(GL_MODELVIEW);
+        currentView = glm::lookAt(eye, eye + glm::make_vec3(direction), glm::make_vec3(up));
+        glLoadMatrixf(glm::value_ptr(currentView));
+
+        glPushMatrix();
+        glTranslatef(eye.x, eye.y, eye.z);
+        drawSkybox();
+        glPopMatrix();
+
+        teapotVisible = false;
+        renderScene();
+        teapotVisible = true;
+    });
+}
+
+// The ground that gets shadows: the flat floor, or on terrain a square of
+// the same size around the robot, moved in steps of half its width so the
+// static layer isn't redrawn for every step the robot takes. corners are its
+// lowest and highest points over each of its four corners.
+void computeShadowRegion(glm::vec3& center, glm::vec3 corners[8])
+{
+    center = glm::vec3(0.0f, -0.9f, 0.0f);
+    float low = -0.9f, high = -0.9f;
+    if (terrainActive())
+    {
+        center.x = std::round(world.robot.x / kFloorHalfSize) * kFloorHalfSize;
+        center.z = std::round(world.robot.z / kFloorHalfSize) * kFloorHalfSize;
+        center.y = groundHeight(center.x, center.z);
+        terrain.heightRange(center.x - kFloorHalfSize, center.z - kFloorHalfSize, center.x + kFloorHalfSize, center.z + kFloorHalfSize, low, high);
+    }
+    for (int i = 0; i < 8; ++i)
+        corners[i] = center + glm::vec3(i & 1 ? kFloorHalfSize : -kFloorHalfSize, 0.0f, i & 2 ? kFloorHalfSize : -kFloorHalfSize);
+    for (int i = 0; i < 8; ++i)
+        corners[i].y = i & 4 ? high : low;
+}
+
+// The light's view of the floor: a perspective frustum from a point light
+// aimed at the floor's centre and just wide enough for its corners, or an
+// orthographic box along a directional light's direction
+glm::mat4 computeShadowMatrix(const glm::vec3& center, const glm::vec3 corners[8])
+{
+    bool directional = fabsf(world.lightPos[3]) < 1e-4f;
+    glm::vec3 light = glm::make_vec3(world.lightPos);
+    glm::vec3 eye = directional ? center + glm::normalize(light) * 50.0f : light / world.lightPos[3];
+    glm::vec3 axis = glm::normalize(center - eye);
+    glm::vec3 up = fabsf(axis.y) > 0.99f ? glm::vec3(0.0f, 0.0f, -1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 view = glm::lookAt(eye, center, up);
+
+    // Casters stand on the floor and reach a few units up
+    float farPlane = 1.0f, maxTangent = 0.0f, maxExtent = 0.0f;
+    for (int i = 0; i < 8; ++i)
+    {
+        glm::vec3 p = glm::vec3(view * glm::vec4(corners[i], 1.0f));
+        farPlane = std::max(farPlane, -p.z + 1.0f);
+        maxTangent = std::max(maxTangent, std::max(fabsf(p.x), fabsf(p.y)) / std::max(-p.z, 0.1f));
+        maxExtent = std::max(maxExtent, std::max(fabsf(p.x), fabsf(p.y)));
+    }
+    if (directional)
+        return glm::ortho(-maxExtent, maxExtent, -maxExtent, maxExtent, 1.0f, farPlane) * view;
+
+    float fovY = std::min(2.0f * atanf(maxTangent), glm::radians(160.0f));
+    return glm::perspective(fovY, 1.0f, 1.0f, farPlane) * view;
+}
+
+void updateShadowMap()
+{
+    if (!sceneConfig.shadows || sceneConfig.softwareRaster)
+        return;
+    if (!shadowMap.isActive() && !shadowMap.init(kShadowMapSize))
+    {
+#ifdef DEBUG
+        std::cerr << "Shadow map framebuffer is incomplete" << std::endl;
+#endif
+        sceneConfig.shadows = false;
+        return;
+    }
+
+    // Static layer: the light and the props. Dynamic layer: the robot's links
+    // plus the head's turn, which moves its eyes.
+    // With baked lighting the props' shadows are already in the floor's
+    // lightmap, and only the robot's are left for the map. Terrain has no
+    // lightmap, and its shadowed square follows the robot.
+    bool bakedProps = bakedLightingReady() && !terrainActive();
+    float baked = bakedProps ? 1.0f : 0.0f;
+    glm::vec3 center, corners[8];
+    computeShadowRegion(center, corners);
+    uint64_t staticKey = hashFloats(world.lightPos, 4);
+    for (int i = 0; i < 3; ++i)
+        staticKey = hashFloats(propPositions[i], 3, staticKey);
+    staticKey = hashFloats(&baked, 1, staticKey);
+    staticKey = hashFloats(glm::value_ptr(center), 3, staticKey);
+
+    RobotLinks links;
+    computeRobotLinks(world, links);
+    float head[3] = { world.headYaw, world.headPitch, world.headVisible ? 1.0f : 0.0f };
+    uint64_t dynamicKey = hashFloats(&links.links[0].a.x, kRobotLinkCount * sizeof(Capsule) / sizeof(float));
+    dynamicKey = hashFloats(head, 3, dynamicKey);
+
+    shadowMatrix = computeShadowMatrix(center, corners);
+    auto loadShadowMatrices = []()
+    {
+        glMatrixMode(GL_PROJECTION);
+        glLoadMatrixf(glm::value_ptr(shadowMatrix));
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+    };
+
+    depthOnlyPass = true;
+    shadowMap.update(staticKey, dynamicKey,
+        [&]()
+        {
+            loadShadowMatrices();
+            if (bakedProps)
+                return;
+            drawPlasticSphere();
+            drawTexturedCube();
+            drawMetalTeapot();
+        },
+        [&]()
+        {
+            loadShadowMatrices();
+            drawRobot();
+        });
+    depthOnlyPass = false;
+}
+
+// Everything the baked light depends on: the light, the props' materials
+// and positions, the terrain file, and the bake's settings
+uint64_t computeLightmapKey()
+{
+    float settings[4] = { (float)kFloorLightmapSize, (float)kPropLightmapSize, (float)lightmapBaker.aoRays, lightmapBaker.aoDistance };
+    uint64_t key = hashFloats(world.lightPos, 4);
+    key = hashFloats(softwareLight.ambient, 4, key);
+    key = hashFloats(softwareLight.diffuse, 4, key);
+    if (useSkyAmbient())
+        key = hashFloats(&skyAmbientMatrices[0][0], 3 * 16, key);
+    key = hashFloats(world.floorDiffuse, 4, key);
+    key = hashFloats(world.plasticDiffuse, 4, key);
+    key = hashFloats(world.cubeDiffuse, 4, key);
+    for (int i = 0; i < 3; ++i)
+        key = hashFloats(propPositions[i], 3, key);
+    if (terrainActive())
+    {
+        uint64_t signature = terrain.signature();
+        key = hashBytes(&signature, sizeof(signature), key);
+    }
+    return hashFloats(settings, 4, key);
+}
+
+// Loads the static scene into the baker: the floor and props, without the
+// robot, which moves, or the light box, which would hide the light. On
+// terrain the ground comes from the map's heights around the props and the
+// light, not the chunks streamed in so far, so the bake and its cache don't
+// depend on what had loaded when it started; only the props get lightmaps.
+void captureStaticScene()
+{
+    if (terrainActive())
+    {
+        float margin = lightmapBaker.aoDistance;
+        float minX = world.lightPos[0], maxX = world.lightPos[0];
+        float minZ = world.lightPos[2], maxZ = world.lightPos[2];
+        for (int i = 0; i < 3; ++i)
+        {
+            minX = std::min(minX, propPositions[i][0]);
+            maxX = std::max(maxX, propPositions[i][0]);
+            minZ = std::min(minZ, propPositions[i][2]);
+            maxZ = std::max(maxZ, propPositions[i][2]);
+        }
+        terrain.groundMesh(minX - margin, minZ - margin, maxX + margin, maxZ + margin, 128, bakeGround);
+    }
+
+    lightmapBaker.scene.clear();
+    pathTraceCapture = &lightmapBaker.scene;
+    softwareView = true;
+    softwareMatrices.assign(1, glm::mat4(1.0f));
+    drawFloor();
+    drawPlasticSphere();
+    drawTexturedCube();
+    drawMetalTeapot();
+    softwareView = false;
+    pathTraceCapture = NULL;
+    lightmapBaker.scene.build();
+    bakeGround = RasterMesh();
+
+    RasterMaterial floorMaterial, plasticMaterial, cubeMaterial;
+    memcpy(floorMaterial.diffuse, world.floorDiffuse, sizeof(floorMaterial.diffuse));
+    memcpy(plasticMaterial.diffuse, world.plasticDiffuse, sizeof(plasticMaterial.diffuse));
+    memcpy(cubeMaterial.diffuse, world.cubeDiffuse, sizeof(cubeMaterial.diffuse));
+    lightmapBaker.targets.clear();
+    if (!terrainActive())
+        lightmapBaker.targets.push_back(LightmapTarget::plane(vec3(-kFloorHalfSize, -0.9f, -kFloorHalfSize), vec3(2.0f * kFloorHalfSize, 0.0f, 0.0f),
+            vec3(0.0f, 0.0f, 2.0f * kFloorHalfSize), kFloorLightmapSize, kFloorLightmapSize, floorMaterial));
+    lightmapBaker.targets.push_back(LightmapTarget::normalCube(vec3(spherePosition[0], spherePosition[1], spherePosition[2]), 0.5f, kPropLightmapSize, plasticMaterial));
+    lightmapBaker.targets.push_back(LightmapTarget::normalCube(vec3(cubePosition[0], cubePosition[1], cubePosition[2]), 0.5f, kPropLightmapSize, cubeMaterial));
+}
+
+// The floor's lightmap, if it has one, comes before the props'
+void uploadLightmaps()
+{
+    size_t firstProp = lightmapBaker.targets.size() - 2;
+    if (firstProp == 1)
+    {
+        const LightmapTarget& floorTarget = lightmapBaker.targets[0];
+        if (floorLightmap == 0)
+            glGenTextures(1, &floorLightmap);
+        glBindTexture(GL_TEXTURE_2D, floorLightmap);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, floorTarget.width, floorTarget.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, floorTarget.texels.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    for (int i = 0; i < 2; ++i)
+    {
+        const LightmapTarget& target = lightmapBaker.targets[firstProp + i];
+        if (propLightmaps[i] == 0)
+            glGenTextures(1, &propLightmaps[i]);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, propLightmaps[i]);
+        for (int face = 0; face < 6; ++face)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA8, target.width, target.width, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                &target.texels[(size_t)face * target.width * target.width]);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    uploadedLightmapKey = lightmapKey;
+}
+
+// Deletes all but the kLightmapCacheFiles most recently used lightmap caches;
+// loading one touches it, so layouts still in use outlive stale ones
+void pruneLightmapCache()
+{
+    namespace fs = std::filesystem;
+    std::error_code error;
+    std::vector<std::pair<fs::file_time_type, fs::path>> files;
+    for (fs::directory_iterator it(lightmapCacheDirectory, error), end; !error && it != end; it.increment(error))
+    {
+        fs::file_time_type time = it->last_write_time(error);
+        if (!error && it->path().extension() == ".cache")
+            files.push_back(std::make_pair(time, it->path()));
+    }
+
+    if (files.size() <= (size_t)kLightmapCacheFiles)
+        return;
+    std::sort(files.begin(), files.end());
+    for (size_t i = 0; i < files.size() - kLightmapCacheFiles; ++i)
+        fs::remove(files[i].second, error);
+}
+
+void updateBakedLighting()
+{
+    if (!sceneConfig.bakedLighting || sceneConfig.softwareRaster)
+        return;
+
+    char path[256];
+    uint64_t key = computeLightmapKey();
+    snprintf(path, sizeof(path), "%s/%016llx.cache", lightmapCacheDirectory, (unsigned long long)key);
+    if (key != lightmapKey)
+    {
+        // A bake for a light that's since moved on is of no use
+        lightmapKey = key;
+        lightmapBaker.stop();
+        captureStaticScene();
+        if (lightmapBaker.load(path, key))
+        {
+            std::error_code error;
+            std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+            uploadLightmaps();
+            return;
+        }
+
+        // Same space and terms as setupLighting() gave GL, in world space
+        RasterLight light = softwareLight;
+        memcpy(light.position, world.lightPos, sizeof(light.position));
+        light.skyAmbient = useSkyAmbient();
+        if (light.skyAmbient)
+            memcpy(light.ambientMatrices, skyAmbientMatrices, sizeof(light.ambientMatrices));
+        lightmapBaker.start(light, key);
+        return;
+    }
+
+    if (uploadedLightmapKey != key && lightmapBaker.finishedKey() == key)
+    {
+        uploadLightmaps();
+        std::error_code error;
+        std::filesystem::create_directories(lightmapCacheDirectory, error);
+        if (!lightmapBaker.save(path, key))
+        {
+#ifdef DEBUG
+            std::cerr << "Failed to write lightmap cache: " << path << std::endl;
+#endif
+        }
+        pruneLightmapCache();
+    }
+}
+
+void updateLightPosition(World& state)
+{
+    state.lightPos[0] = 7.5f * cos(glm::radians(state.lightAngle));
+    state.lightPos[2] = 7.5f * sin(glm::radians(state.lightAngle));
+}
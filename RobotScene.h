@@ -0,0 +1,124 @@
+#pragma once
+
+// The scene every frontend renders: world state, prop placement, textures,
+// lighting and the draw calls for the robot, floor, props and skybox.
+// Frontends only differ in the SceneConfig they pass to configureScene().
+
+#include <GL/glew.h>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include "RobotCollision.h"
+#include "RobotWorld.h"
+
+class PathTracer;
+
+struct SceneConfig
+{
+    float spherePosition[3] = { -7.0f, 0.0f, 0.0f };
+    float cubePosition[3] = { 2.0f, 0.0f, -10.0f };
+    float teapotPosition[3] = { -4.0f, 0.0f, -1.0f };
+    bool reflection = false;        // stencil reflection of the scene in the floor, toggled from the panel
+    bool dimmableLight = false;     // the light's diffuse and specular follow pointLightIntensity
+    bool softwareRaster = false;    // draw views with the CPU rasterizer (SoftRasterizer.h) instead of GL
+    bool teapotReflection = true;   // the teapot reflects a cubemap captured from its centre (GL views only)
+    bool skyAmbient = true;         // ambient light takes its colour and direction from the skybox (SkyIrradiance.h)
+    bool shadows = true;            // props and robot cast shadows on the floor from a cached shadow map (GL views only)
+    bool bakedLighting = true;      // floor, sphere and cube take their light from textures baked on the CPU (GL views only)
+
+    // Detail, lowered by the app's quality governor when frames run long
+    int tessellation = 20;          // slices and stacks of the GL spheres and cylinders
+    int teapotProbeSize = 128;      // face size of the teapot's cubemap
+    float teapotProbeRate = 0.0f;   // cubemap faces re-rendered per second, 0 for one every frame
+    bool dropReflection = false;    // skip the floor reflection even where it's enabled
+};
+
+// All simulated state: robot pose, cameras, lighting and materials
+extern World world;
+extern SceneConfig sceneConfig;
+
+// Prop placement, shared by the draw functions and the collision scene
+extern float spherePosition[3];
+extern float cubePosition[3];
+extern float teapotPosition[3];
+extern float* propPositions[3];     // collisionScene.props order
+extern const char* propNames[3];
+extern CollisionScene collisionScene;
+
+// Places the props and builds their collision shapes. Needs no GL context.
+void configureScene(const SceneConfig& config);
+
+// Collision shapes for the props, rebuilt whenever one of them moves
+void buildCollisionScene();
+
+// The same for props at other positions, e.g. the simulation thread's copy
+void buildPropCollision(CollisionScene& scene, const float* const positions[3]);
+
+// Replaces the flat floor with terrain (Terrain.h). path is a terrain file,
+// or a greyscale heightmap that's converted into one next to it on first
+// use: spacing metres between pixels, black to white spanning heightRange
+// metres, centred on the origin with the ground there where the floor was.
+// Props and robot are set down on it. Needs no GL context; false if it
+// can't be read, leaving the flat floor.
+bool loadTerrain(const char* path, float spacing, float heightRange);
+bool terrainActive();
+
+// Height of the ground under (x, z): the terrain's, or the flat floor's.
+// Safe from any thread.
+float groundHeight(float x, float z);
+
+// Streams terrain chunks in and out around eye, picks their levels and
+// uploads the new ones; once per frame, before the views
+void updateTerrain(const glm::vec3& eye);
+
+// Terrain chunks loaded, still being built, and drawn this frame, with the
+// triangles drawn, for the panel
+void terrainStatistics(size_t& resident, size_t& building, size_t& drawn, size_t& triangles);
+
+// Loads the floor texture and skybox, and the skybox's irradiance from its
+// cache or by projecting it; needs a GL context
+void loadTextures();
+
+// Light colours, set once per frame
+void setupLighting();
+
+// Light position, set for every view since it's transformed by the modelview matrix
+void positionLight();
+
+// Re-renders one face of the teapot's environment cubemap when one is due;
+// once per frame, before the views
+void updateTeapotReflection(double now);
+
+// Redraws the shadow map's layers whose casters or light moved; once per
+// frame, before the views
+void updateShadowMap();
+
+// Bakes the static lighting for this frame's light, materials and props on
+// a background thread, or loads it from its cache, and uploads it once it's
+// done; once per frame, after setupLighting() and before updateShadowMap()
+void updateBakedLighting();
+
+// Whether the GL views use the baked lighting, and how far along its bake is
+bool bakedLightingReady();
+float bakedLightingProgress();
+
+// Orbits the light around the scene by state.lightAngle
+void updateLightPosition(World& state);
+
+void computeHeadCamera(glm::vec3& eye, glm::vec3& target);
+void computeOrbitCamera(glm::vec3& eye, glm::vec3& target);
+
+void drawSkybox();
+void renderScene();
+void renderReflectedScene();
+
+// Draws the scene from eye towards target into the current viewport and
+// framebuffer, through GL or the software rasterizer as sceneConfig says.
+// Views from inside the head (fromHead) hide it.
+void drawView(const glm::vec3& eye, const glm::vec3& target, float fovY, float aspect, float nearPlane, float farPlane, bool fromHead);
+
+// Loads the scene into a path tracer in world space: the meshes the software
+// rasterizer would draw, the light and the skybox, with the head hidden for
+// views from inside it. Needs a GL context and this frame's setupLighting().
+void capturePathTraceScene(PathTracer& tracer, bool fromHead);
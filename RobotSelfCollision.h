@@ -0,0 +1,182 @@
+#pragma once
+
+// Self-collision query for the right arm against the rest of the body.
+// The body capsules are transposed into structure-of-arrays lanes once per
+// query, then each arm capsule is tested against four body capsules at a time
+// with a branch-free SSE distance kernel (scalar fallback without SSE2).
+
+#include "RobotLinks.h"
+
+struct SelfCollisionResult
+{
+    float distance;   // signed clearance, negative when penetrating
+    int armLink;
+    int bodyLink;
+    bool colliding;
+};
+
+class SelfCollisionChecker
+{
+public:
+    // Every arm link below the shoulder can reach the legs, torso, neck and
+    // head. The shoulder joint itself is rigidly attached to the torso.
+    SelfCollisionChecker()
+    {
+        const int arm[kArmLinks] = { LINK_UPPER_ARM, LINK_ELBOW, LINK_FOREARM, LINK_WRIST, LINK_HAND };
+        const int body[kBodyLinks] =
+        {
+            LINK_LEFT_HIP, LINK_LEFT_THIGH, LINK_LEFT_KNEE, LINK_LEFT_SHIN,
+            LINK_RIGHT_HIP, LINK_RIGHT_THIGH, LINK_RIGHT_KNEE, LINK_RIGHT_SHIN,
+            LINK_PELVIS, LINK_TORSO, LINK_NECK, LINK_HEAD
+        };
+        for (int i = 0; i < kArmLinks; ++i)
+            armLinks[i] = arm[i];
+        for (int i = 0; i < kBodyLinks; ++i)
+            bodyLinks[i] = body[i];
+    }
+
+    // Clearance of the arm against the body for already computed links
+    SelfCollisionResult query(const RobotLinks& robot) const
+    {
+        // Body capsules transposed into lanes once, with the per-segment
+        // terms that don't depend on the arm link precomputed
+        BodyLanes body;
+        for (int i = 0; i < kBodyLinks; ++i)
+        {
+            const Capsule& c = robot.links[bodyLinks[i]];
+            Vec3 d = c.b - c.a;
+            float e = std::max(dot(d, d), kEpsilon);
+            body.px[i] = c.a.x; body.py[i] = c.a.y; body.pz[i] = c.a.z;
+            body.dx[i] = d.x; body.dy[i] = d.y; body.dz[i] = d.z;
+            body.e[i] = e;
+            body.invE[i] = 1.0f / e;
+            body.radius[i] = c.radius;
+        }
+
+        alignas(16) float distance[kArmLinks * kBodyLinks];
+        for (int i = 0; i < kArmLinks; ++i)
+            armDistances(robot.links[armLinks[i]], body, distance + i * kBodyLinks);
+
+        // Branch-free arg-min, the winning pair is unpredictable
+        float best = distance[0];
+        int bestPair = 0;
+        for (int i = 1; i < kArmLinks * kBodyLinks; ++i)
+        {
+            bool closer = distance[i] < best;
+            best = closer ? distance[i] : best;
+            bestPair = closer ? i : bestPair;
+        }
+
+        SelfCollisionResult result;
+        result.distance = best;
+        result.armLink = armLinks[bestPair / kBodyLinks];
+        result.bodyLink = bodyLinks[bestPair % kBodyLinks];
+        result.colliding = best < 0.0f;
+        return result;
+    }
+
+    // Convenience overload doing the forward kinematics as well
+    SelfCollisionResult query(const World& world) const
+    {
+        RobotLinks links;
+        computeRobotLinks(world, links);
+        return query(links);
+    }
+
+    bool colliding(const World& world) const { return query(world).colliding; }
+
+private:
+    static const int kArmLinks = 5;
+    static const int kBodyLinks = 12;   // multiple of the SIMD width
+    static constexpr float kEpsilon = 1e-8f;
+
+    struct BodyLanes
+    {
+        alignas(16) float px[kBodyLinks], py[kBodyLinks], pz[kBodyLinks];
+        alignas(16) float dx[kBodyLinks], dy[kBodyLinks], dz[kBodyLinks];
+        alignas(16) float e[kBodyLinks], invE[kBodyLinks], radius[kBodyLinks];
+    };
+
+    // Closest points between one arm segment and every body segment without
+    // branches: solve s on the infinite lines, clamp, solve t for that s,
+    // clamp, then re-solve s for the clamped t. Degenerate segments (the
+    // joint spheres) are guarded by an epsilon so they fall out of the same
+    // arithmetic.
+#ifdef ROBOT_SIMD_SSE
+    static void armDistances(const Capsule& arm, const BodyLanes& l, float* out)
+    {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 epsilon = _mm_set1_ps(kEpsilon);
+
+        Vec3 d1 = arm.b - arm.a;
+        float armA = std::max(dot(d1, d1), kEpsilon);
+        const __m128 p1x = _mm_set1_ps(arm.a.x), p1y = _mm_set1_ps(arm.a.y), p1z = _mm_set1_ps(arm.a.z);
+        const __m128 d1x = _mm_set1_ps(d1.x), d1y = _mm_set1_ps(d1.y), d1z = _mm_set1_ps(d1.z);
+        const __m128 a = _mm_set1_ps(armA), invA = _mm_set1_ps(1.0f / armA);
+        const __m128 r1 = _mm_set1_ps(arm.radius);
+
+        for (int i = 0; i < kBodyLinks; i += 4)
+        {
+            __m128 d2x = _mm_load_ps(l.dx + i), d2y = _mm_load_ps(l.dy + i), d2z = _mm_load_ps(l.dz + i);
+            __m128 e = _mm_load_ps(l.e + i), invE = _mm_load_ps(l.invE + i);
+            __m128 rx = _mm_sub_ps(p1x, _mm_load_ps(l.px + i));
+            __m128 ry = _mm_sub_ps(p1y, _mm_load_ps(l.py + i));
+            __m128 rz = _mm_sub_ps(p1z, _mm_load_ps(l.pz + i));
+
+            __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d1x, d2x), _mm_mul_ps(d1y, d2y)), _mm_mul_ps(d1z, d2z));
+            __m128 c = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d1x, rx), _mm_mul_ps(d1y, ry)), _mm_mul_ps(d1z, rz));
+            __m128 f = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d2x, rx), _mm_mul_ps(d2y, ry)), _mm_mul_ps(d2z, rz));
+
+            __m128 denom = _mm_sub_ps(_mm_mul_ps(a, e), _mm_mul_ps(b, b));
+            __m128 parallel = _mm_cmple_ps(denom, epsilon);
+            __m128 s = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(b, f), _mm_mul_ps(c, e)), _mm_max_ps(denom, epsilon));
+            s = _mm_andnot_ps(parallel, s);
+            s = _mm_min_ps(_mm_max_ps(s, zero), one);
+
+            __m128 t = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(b, s), f), invE);
+            t = _mm_min_ps(_mm_max_ps(t, zero), one);
+
+            s = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(b, t), c), invA);
+            s = _mm_min_ps(_mm_max_ps(s, zero), one);
+
+            __m128 dx = _mm_sub_ps(_mm_add_ps(rx, _mm_mul_ps(d1x, s)), _mm_mul_ps(d2x, t));
+            __m128 dy = _mm_sub_ps(_mm_add_ps(ry, _mm_mul_ps(d1y, s)), _mm_mul_ps(d2y, t));
+            __m128 dz = _mm_sub_ps(_mm_add_ps(rz, _mm_mul_ps(d1z, s)), _mm_mul_ps(d2z, t));
+            __m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            __m128 radius = _mm_add_ps(r1, _mm_load_ps(l.radius + i));
+
+            _mm_store_ps(out + i, _mm_sub_ps(_mm_sqrt_ps(distSq), radius));
+        }
+    }
+#else
+    static void armDistances(const Capsule& arm, const BodyLanes& l, float* out)
+    {
+        Vec3 d1 = arm.b - arm.a;
+        float a = std::max(dot(d1, d1), kEpsilon);
+        float invA = 1.0f / a;
+
+        for (int i = 0; i < kBodyLinks; ++i)
+        {
+            float rx = arm.a.x - l.px[i], ry = arm.a.y - l.py[i], rz = arm.a.z - l.pz[i];
+            float b = d1.x * l.dx[i] + d1.y * l.dy[i] + d1.z * l.dz[i];
+            float c = d1.x * rx + d1.y * ry + d1.z * rz;
+            float f = l.dx[i] * rx + l.dy[i] * ry + l.dz[i] * rz;
+
+            float denom = a * l.e[i] - b * b;
+            float s = denom > kEpsilon ? (b * f - c * l.e[i]) / denom : 0.0f;
+            s = std::min(std::max(s, 0.0f), 1.0f);
+            float t = std::min(std::max((b * s + f) * l.invE[i], 0.0f), 1.0f);
+            s = std::min(std::max((b * t - c) * invA, 0.0f), 1.0f);
+
+            float dx = rx + d1.x * s - l.dx[i] * t;
+            float dy = ry + d1.y * s - l.dy[i] * t;
+            float dz = rz + d1.z * s - l.dz[i] * t;
+            out[i] = std::sqrt(dx * dx + dy * dy + dz * dz) - arm.radius - l.radius[i];
+        }
+    }
+#endif
+
+    int armLinks[kArmLinks];
+    int bodyLinks[kBodyLinks];
+};
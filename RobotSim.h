@@ -0,0 +1,185 @@
+#pragma once
+
+// Headless robot kinematics.
+// Everything in here is plain C++ with no GL/GLUT dependency so the same
+// movement and gait code can drive the window and run stand-alone rollouts.
+
+#include <cmath>
+#include <cstdint>
+
+enum Direction
+{
+    FORWARD,
+    BACKWARD,
+    LEFT,
+    RIGHT
+};
+
+struct RobotKinematics
+{
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+    float rotation = 0.0f;
+    Direction direction = FORWARD;
+
+    bool isMoving = false;
+    float walkCycle = 0.0f;
+
+    float leftHipAngle = 0.0f, leftKneeAngle = 0.0f;
+    float rightHipAngle = 0.0f, rightKneeAngle = 0.0f;
+};
+
+// Distance covered and gait phase advanced by one key press
+const float kMoveStep = 0.1f;
+
+// Rotation applied when turning from [current][requested] direction
+const float kTurnTable[4][4] =
+{
+    //  FORWARD  BACKWARD  LEFT     RIGHT
+    {   0.0f,   -180.0f,   90.0f,  -90.0f  },  // from FORWARD
+    {   180.0f,  0.0f,    -90.0f,   90.0f  },  // from BACKWARD
+    {  -90.0f,   90.0f,    0.0f,   -180.0f },  // from LEFT
+    {   90.0f,  -90.0f,   -180.0f,  0.0f   }   // from RIGHT
+};
+
+// Movement for each direction: x/z delta and walk cycle delta
+const float kMoveTable[4][3] =
+{
+    {  0.0f,      -kMoveStep,  kMoveStep },  // FORWARD
+    {  0.0f,       kMoveStep, -kMoveStep },  // BACKWARD
+    { -kMoveStep,  0.0f,       kMoveStep },  // LEFT
+    {  kMoveStep,  0.0f,       kMoveStep }   // RIGHT
+};
+
+// Maps a movement key to a direction, returns false for any other key
+inline bool keyToDirection(unsigned char key, Direction& direction)
+{
+    switch (key)
+    {
+    case 'w': direction = FORWARD; return true;
+    case 's': direction = BACKWARD; return true;
+    case 'a': direction = LEFT; return true;
+    case 'd': direction = RIGHT; return true;
+    default: return false;
+    }
+}
+
+// Same semantics as the GLUT keyboard handler: any key marks the robot as
+// moving, w/a/s/d turn it to face the direction and step it forward.
+inline void stepKeyboard(RobotKinematics& robot, unsigned char key)
+{
+    robot.isMoving = true;
+
+    Direction direction;
+    if (!keyToDirection(key, direction))
+        return;
+
+    robot.rotation += kTurnTable[robot.direction][direction];
+    robot.direction = direction;
+
+    robot.x += kMoveTable[direction][0];
+    robot.z += kMoveTable[direction][1];
+    robot.walkCycle += kMoveTable[direction][2];
+}
+
+// Leg gait from the walk cycle. The four phases are a quarter turn apart so
+// sin(w + pi/2) = cos(w), sin(w + pi) = -sin(w), sin(w + 3pi/2) = -cos(w).
+inline void stepAnimation(RobotKinematics& robot)
+{
+    if (robot.isMoving)
+    {
+        float s = std::sin(robot.walkCycle);
+        float c = std::cos(robot.walkCycle);
+        robot.leftHipAngle = 30.0f * s;
+        robot.leftKneeAngle = 30.0f * c;
+        robot.rightHipAngle = -30.0f * s;
+        robot.rightKneeAngle = -30.0f * c;
+    }
+    else
+    {
+        robot.leftHipAngle = 0.0f;
+        robot.leftKneeAngle = 0.0f;
+        robot.rightHipAngle = 0.0f;
+        robot.rightKneeAngle = 0.0f;
+    }
+}
+
+// Held movement keys, one bit per Direction
+enum MoveInput
+{
+    INPUT_FORWARD = 1 << FORWARD,
+    INPUT_BACKWARD = 1 << BACKWARD,
+    INPUT_LEFT = 1 << LEFT,
+    INPUT_RIGHT = 1 << RIGHT
+};
+
+// Continuous movement: walking speed, turning rate and gait phase per unit walked
+const float kWalkSpeed = 3.0f;          // units per second
+const float kTurnSpeed = 540.0f;        // degrees per second
+const float kWalkCyclePerUnit = 1.0f;   // as for key presses, kMoveStep of phase per kMoveStep walked
+
+// Wraps an angle in degrees to [-180, 180)
+inline float wrapDegrees(float degrees)
+{
+    return degrees - 360.0f * std::floor((degrees + 180.0f) / 360.0f);
+}
+
+// Time-based movement from the keys held during a tick of dt seconds. The
+// robot walks at kWalkSpeed in the held direction (diagonals included) and
+// turns towards it the short way round at kTurnSpeed, rather than snapping.
+inline void stepInput(RobotKinematics& robot, unsigned input, float dt)
+{
+    float vx = 0.0f, vz = 0.0f;
+    if (input & INPUT_FORWARD) vz -= 1.0f;
+    if (input & INPUT_BACKWARD) vz += 1.0f;
+    if (input & INPUT_LEFT) vx -= 1.0f;
+    if (input & INPUT_RIGHT) vx += 1.0f;
+
+    robot.isMoving = vx != 0.0f || vz != 0.0f;
+    if (!robot.isMoving)
+        return;
+
+    float length = std::sqrt(vx * vx + vz * vz);
+    vx /= length;
+    vz /= length;
+
+    // Rotation 0 faces -z, and glRotatef turns -z towards -x for positive angles
+    float heading = std::atan2(-vx, -vz) * 57.29577951f;
+    float turn = wrapDegrees(heading - robot.rotation);
+    float maxTurn = kTurnSpeed * dt;
+    robot.rotation += std::fmax(-maxTurn, std::fmin(maxTurn, turn));
+    robot.direction = std::fabs(vz) >= std::fabs(vx) ? (vz < 0.0f ? FORWARD : BACKWARD) : (vx < 0.0f ? LEFT : RIGHT);
+
+    float distance = kWalkSpeed * dt;
+    robot.x += vx * distance;
+    robot.z += vz * distance;
+    robot.walkCycle += distance * kWalkCyclePerUnit;
+}
+
+// One simulation tick: optional key press (0 for none) then the gait update
+inline void stepRobot(RobotKinematics& robot, unsigned char key)
+{
+    if (key != 0)
+        stepKeyboard(robot, key);
+    stepAnimation(robot);
+}
+
+// Steps a robot through a repeating key script without any rendering.
+// Returns the number of steps taken, the final state is left in robot.
+inline uint64_t runHeadless(RobotKinematics& robot, const unsigned char* keys, uint64_t keyCount, uint64_t steps)
+{
+    if (keyCount == 0)
+    {
+        for (uint64_t i = 0; i < steps; ++i)
+            stepAnimation(robot);
+        return steps;
+    }
+
+    uint64_t k = 0;
+    for (uint64_t i = 0; i < steps; ++i)
+    {
+        stepRobot(robot, keys[k]);
+        if (++k == keyCount)
+            k = 0;
+    }
+    return steps;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+// The whole simulated world in one flat, trivially copyable struct.
+// Nothing in here owns memory or GL objects, so a snapshot is a single
+// memcpy and planners can branch from a state as often as they like.
+
+#include "RobotSim.h"
+
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+struct World
+{
+    // Robot parts transformations
+    RobotKinematics robot;
+    float shoulderPitch = 0.0f, shoulderYaw = 0.0f, shoulderRoll = 0.0f;
+    float elbowPitch = 0.0f, elbowYaw = 0.0f, elbowRoll = 0.0f;
+    float wristPitch = 0.0f, wristYaw = 0.0f, wristRoll = 0.0f;
+    float headYaw = 0.0f, headPitch = 0.0f;
+
+    // Camera parameters
+    float camX = 0.0f, camY = 5.0f, camZ = 20.0f;
+    float camPitch = 0.0f, camYaw = 0.0f;
+
+    // Secondary camera (inside robot head)
+    float headCamYaw = 0.0f, headCamPitch = 0.0f;
+    float secCamX = 0.0f, secCamY = 1.5f, secCamZ = 0.0f;
+    bool useHeadCam = false;
+    bool headVisible = true;
+
+    // Lighting parameters
+    float lightPos[4] = { 1.2f, 7.5f, 2.0f, 1.0f };
+    float ambientStrength = 0.25f;
+    float pointLightIntensity = 1.0f;
+    float lightAngle = 0.0f;
+    float shadowStrength = 0.5f;        // fraction of the lit floor colour taken away in shadow
+    bool enableReflection = false;
+
+    // Material properties
+    float floorSpecular[4] = { 0.9f, 0.9f, 0.9f, 1.0f };
+    float floorShininess = 100.0f;
+    float floorDiffuse[4] = { 0.5f, 0.5f, 0.5f, 1.0f };
+
+    float cubeDiffuse[4] = { 0.6f, 0.2f, 0.3f, 1.0f };
+    float cubeSpecular[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    float cubeShininess = 64.0f;
+
+    float plasticDiffuse[4] = { 0.9f, 0.8f, 0.1f, 1.0f };
+    float plasticSpecular[4] = { 0.3f, 0.3f, 0.3f, 1.0f };
+    float plasticShininess = 5.0f;
+
+    float teapotDiffuse[4] = { 0.804f, 0.498f, 0.196f, 1.0f };
+    float teapotSpecular[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    float teapotShininess = 200.0f;
+    float teapotReflectivity = 0.5f;    // how much of the environment cubemap shows over the lit colour
+
+    float robotDiffuse[4] = { 0.7f, 0.7f, 0.7f, 1.0f };
+    float robotSpecular[4] = { 0.9f, 0.9f, 0.9f, 1.0f };
+    float robotShininess = 128.0f;
+};
+
+static_assert(std::is_trivially_copyable<World>::value, "World must stay memcpy-able for snapshots");
+
+// Copies the right arm's joint angles, e.g. to undo a rejected arm move
+inline void copyArmPose(World& dst, const World& src)
+{
+    dst.shoulderPitch = src.shoulderPitch; dst.shoulderYaw = src.shoulderYaw; dst.shoulderRoll = src.shoulderRoll;
+    dst.elbowPitch = src.elbowPitch; dst.elbowYaw = src.elbowYaw; dst.elbowRoll = src.elbowRoll;
+    dst.wristPitch = src.wristPitch; dst.wristYaw = src.wristYaw; dst.wristRoll = src.wristRoll;
+}
+
+// Fixed pool of reusable snapshot slots. Saving and restoring are a memcpy,
+// acquiring and releasing a slot are a push/pop on the free list, and
+// nothing allocates after construction unless the pool has to grow.
+class WorldSnapshotPool
+{
+public:
+    explicit WorldSnapshotPool(size_t capacity = 1024) { reserve(capacity); }
+
+    size_t capacity() const { return slots.size(); }
+    size_t used() const { return slots.size() - freeSlots.size(); }
+
+    void reserve(size_t capacity)
+    {
+        size_t old = slots.size();
+        if (capacity <= old)
+            return;
+        slots.resize(capacity);
+        for (size_t i = capacity; i > old; --i)
+            freeSlots.push_back((int)(i - 1));
+    }
+
+    // Copies world into a free slot and returns its handle
+    int save(const World& world)
+    {
+        if (freeSlots.empty())
+            reserve(slots.empty() ? 64 : slots.size() * 2);
+        int slot = freeSlots.back();
+        freeSlots.pop_back();
+        std::memcpy(&slots[slot], &world, sizeof(World));
+        return slot;
+    }
+
+    // Overwrites an already held slot, e.g. to move a branch point forward
+    void overwrite(int slot, const World& world)
+    {
+        std::memcpy(&slots[slot], &world, sizeof(World));
+    }
+
+    void restore(int slot, World& world) const
+    {
+        std::memcpy(&world, &slots[slot], sizeof(World));
+    }
+
+    const World& peek(int slot) const { return slots[slot]; }
+
+    void release(int slot) { freeSlots.push_back(slot); }
+
+    void releaseAll()
+    {
+        freeSlots.clear();
+        for (size_t i = slots.size(); i > 0; --i)
+            freeSlots.push_back((int)(i - 1));
+    }
+
+private:
+    std::vector<World> slots;
+    std::vector<int> freeSlots;
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+// Depth map of the scene as seen from the light, cached across frames.
+// Casters are split into two layers: a static one (props) that is only
+// re-rendered when the light or a prop moves, and a dynamic one (the robot)
+// drawn over a copy of it whenever its own pose changes. Frames where
+// nothing moved cost nothing.
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+class ShadowMap
+{
+public:
+    bool init(int mapSize)
+    {
+        shutdown();
+        size = mapSize;
+
+        glGenRenderbuffers(1, &staticDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, staticDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        // Sampled with hardware comparison; the result lands in alpha, 1 where
+        // the reference is farther than the stored depth, i.e. in shadow.
+        // Outside the map the border depth leaves everything lit.
+        GLfloat border[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_GREATER);
+        glTexParameteri(GL_TEXTURE_2D, GL_DEPTH_TEXTURE_MODE, GL_ALPHA);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &staticFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, staticFbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, staticDepth);
+        bool complete = completeDepthOnly();
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+        complete = completeDepthOnly() && complete;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (!complete)
+        {
+            shutdown();
+            return false;
+        }
+
+        hasKeys = false;
+        staticRenders = dynamicRenders = 0;
+        return true;
+    }
+
+    void shutdown()
+    {
+        if (fbo == 0 && staticFbo == 0)
+            return;
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteFramebuffers(1, &staticFbo);
+        glDeleteRenderbuffers(1, &staticDepth);
+        glDeleteTextures(1, &texture);
+        fbo = staticFbo = staticDepth = texture = 0;
+    }
+
+    bool isActive() const { return fbo != 0; }
+
+    bool ready() const { return isActive() && dynamicRenders > 0; }
+
+    // Brings the map up to date. staticKey covers the light and the static
+    // casters, dynamicKey the dynamic ones (see hashFloats()); a layer is only
+    // redrawn when a key it depends on changed. The draw callbacks get a
+    // depth-only framebuffer and set up the light's matrices themselves.
+    void update(uint64_t staticKey, uint64_t dynamicKey, const std::function<void()>& drawStatic, const std::function<void()>& drawDynamic)
+    {
+        bool staticChanged = !hasKeys || staticKey != lastStaticKey;
+        bool dynamicChanged = staticChanged || dynamicKey != lastDynamicKey;
+        if (!dynamicChanged)
+            return;
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glPushAttrib(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_POLYGON_BIT | GL_ENABLE_BIT);
+        glViewport(0, 0, size, size);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+
+        if (staticChanged)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, staticFbo);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            drawStatic();
+            ++staticRenders;
+        }
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, staticFbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+        glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        drawDynamic();
+        ++dynamicRenders;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glPopAttrib();
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+        lastStaticKey = staticKey;
+        lastDynamicKey = dynamicKey;
+        hasKeys = true;
+    }
+
+    GLuint texture = 0;
+    int size = 0;
+    unsigned long long staticRenders = 0, dynamicRenders = 0;
+
+private:
+    // GL 4.1 and ARB_ES2_compatibility drivers take a framebuffer without
+    // colour buffers as it is; older ones want its draw and read buffers
+    // turned off. Only doing that when needed also sidesteps Mesa losing the
+    // colour of fixed-function draws into the next colour framebuffer.
+    static bool completeDepthOnly()
+    {
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE)
+            return true;
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    }
+
+    GLuint fbo = 0, staticFbo = 0, staticDepth = 0;
+    uint64_t lastStaticKey = 0, lastDynamicKey = 0;
+    bool hasKeys = false;
+};
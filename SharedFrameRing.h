@@ -0,0 +1,299 @@
+#pragma once
+
+// Shared-memory ring buffer of fixed-size frames.
+// One producer (the simulator) writes frames into a named shared-memory
+// region; any number of local consumer processes map the same region and
+// read the newest frame in place. Every slot carries a sequence counter used
+// as a seqlock: it's odd while the producer is writing the slot, so readers
+// can tell when a frame they were looking at has been overwritten.
+//
+// Layout: SharedFrameHeader, then slotCount x (SharedFrameSlot + pixels),
+// each slot padded to a multiple of 64 bytes.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const uint32_t kSharedFrameMagic = 0x52424652;  // "RFBR"
+const uint32_t kSharedFrameVersion = 1;
+
+struct SharedFrameHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width, height, bytesPerPixel;
+    uint32_t slotCount;
+    uint64_t frameBytes;    // width * height * bytesPerPixel
+    uint64_t slotStride;    // bytes from one slot header to the next
+    std::atomic<uint64_t> latest;   // frame number of the newest complete frame, 0 if none
+};
+
+struct SharedFrameSlot
+{
+    std::atomic<uint64_t> sequence; // odd while being written
+    uint64_t frameNumber;
+    double timestamp;               // seconds, producer clock
+    uint64_t reserved[5];
+};
+
+static_assert(sizeof(SharedFrameSlot) == 64, "slot header should be one cache line");
+
+inline size_t sharedFrameHeaderSize() { return (sizeof(SharedFrameHeader) + 63) & ~(size_t)63; }
+inline size_t sharedFrameSlotStride(size_t frameBytes) { return (sizeof(SharedFrameSlot) + frameBytes + 63) & ~(size_t)63; }
+
+// Maps and unmaps a named shared-memory region
+class SharedMemoryRegion
+{
+public:
+    SharedMemoryRegion() {}
+    ~SharedMemoryRegion() { close(); }
+
+    SharedMemoryRegion(const SharedMemoryRegion&) = delete;
+    SharedMemoryRegion& operator=(const SharedMemoryRegion&) = delete;
+
+    // create = true makes (or resizes) the region, false opens an existing one
+    bool open(const char* name, size_t size, bool create)
+    {
+        close();
+#ifdef _WIN32
+        if (create)
+            handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, name);
+        else
+            handle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+        if (handle == NULL)
+            return false;
+        data = (uint8_t*)MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+        if (data == NULL)
+        {
+            CloseHandle(handle);
+            handle = NULL;
+            return false;
+        }
+#else
+        int fd = shm_open(name, create ? (O_CREAT | O_RDWR) : O_RDWR, 0666);
+        if (fd < 0)
+            return false;
+        if (create && ftruncate(fd, (off_t)size) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        if (!create)
+        {
+            struct stat info;
+            if (fstat(fd, &info) != 0 || (size_t)info.st_size < size)
+            {
+                ::close(fd);
+                return false;
+            }
+        }
+        void* mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+        data = (uint8_t*)mapped;
+#endif
+        bytes = size;
+        return true;
+    }
+
+    void close()
+    {
+        if (data == NULL)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+        CloseHandle(handle);
+        handle = NULL;
+#else
+        munmap(data, bytes);
+#endif
+        data = NULL;
+        bytes = 0;
+    }
+
+    static void unlink(const char* name)
+    {
+#ifndef _WIN32
+        shm_unlink(name);
+#else
+        (void)name;
+#endif
+    }
+
+    uint8_t* data = NULL;
+    size_t bytes = 0;
+
+private:
+#ifdef _WIN32
+    HANDLE handle = NULL;
+#endif
+};
+
+// Producer side
+class SharedFrameWriter
+{
+public:
+    bool create(const char* name, uint32_t width, uint32_t height, uint32_t bytesPerPixel, uint32_t slotCount)
+    {
+        uint64_t frameBytes = (uint64_t)width * height * bytesPerPixel;
+        size_t stride = sharedFrameSlotStride(frameBytes);
+        if (!region.open(name, sharedFrameHeaderSize() + stride * slotCount, true))
+            return false;
+
+        std::memset(region.data, 0, region.bytes);
+        header = new (region.data) SharedFrameHeader();
+        header->width = width;
+        header->height = height;
+        header->bytesPerPixel = bytesPerPixel;
+        header->slotCount = slotCount;
+        header->frameBytes = frameBytes;
+        header->slotStride = stride;
+        header->latest.store(0, std::memory_order_relaxed);
+        for (uint32_t i = 0; i < slotCount; ++i)
+            new (slotHeader(i)) SharedFrameSlot();
+
+        // Written last so readers never see a half-initialised header
+        header->version = kSharedFrameVersion;
+        std::atomic_thread_fence(std::memory_order_release);
+        header->magic = kSharedFrameMagic;
+
+        nextFrame = 1;
+        regionName = name;
+        return true;
+    }
+
+    void destroy()
+    {
+        if (header == NULL)
+            return;
+        region.close();
+        SharedMemoryRegion::unlink(regionName.c_str());
+        header = NULL;
+    }
+
+    bool isOpen() const { return header != NULL; }
+
+    // Returns the pixel storage of the next slot; fill it, then call endWrite()
+    uint8_t* beginWrite()
+    {
+        writingSlot = slotHeader((uint32_t)(nextFrame % header->slotCount));
+        writingSlot->sequence.fetch_add(1, std::memory_order_acq_rel);
+        std::atomic_thread_fence(std::memory_order_release);
+        return (uint8_t*)(writingSlot + 1);
+    }
+
+    void endWrite(double timestamp)
+    {
+        writingSlot->frameNumber = nextFrame;
+        writingSlot->timestamp = timestamp;
+        writingSlot->sequence.fetch_add(1, std::memory_order_release);
+        header->latest.store(nextFrame, std::memory_order_release);
+        ++nextFrame;
+    }
+
+    uint64_t framesWritten() const { return nextFrame - 1; }
+    const SharedFrameHeader* info() const { return header; }
+
+private:
+    SharedFrameSlot* slotHeader(uint32_t slot) const
+    {
+        return (SharedFrameSlot*)(region.data + sharedFrameHeaderSize() + slot * header->slotStride);
+    }
+
+    SharedMemoryRegion region;
+    SharedFrameHeader* header = NULL;
+    SharedFrameSlot* writingSlot = NULL;
+    uint64_t nextFrame = 1;
+    std::string regionName;
+};
+
+// Consumer side. Frames are read in place: peekLatest() hands out a pointer
+// into shared memory and isStillValid() confirms the producer hasn't lapped
+// the ring while the consumer was using it.
+class SharedFrameReader
+{
+public:
+    bool open(const char* name)
+    {
+        // Map the header alone first to learn the full size
+        SharedMemoryRegion probe;
+        if (!probe.open(name, sharedFrameHeaderSize(), false))
+            return false;
+        const SharedFrameHeader* h = (const SharedFrameHeader*)probe.data;
+        if (h->magic != kSharedFrameMagic || h->version != kSharedFrameVersion)
+            return false;
+        size_t size = sharedFrameHeaderSize() + h->slotStride * h->slotCount;
+        probe.close();
+
+        if (!region.open(name, size, false))
+            return false;
+        header = (const SharedFrameHeader*)region.data;
+        return true;
+    }
+
+    const SharedFrameHeader* info() const { return header; }
+
+    // Newest complete frame, or NULL if there is none yet or the slot is being
+    // rewritten right now. sequence must be passed back to isStillValid().
+    const uint8_t* peekLatest(uint64_t& frameNumber, double& timestamp, uint64_t& sequence) const
+    {
+        uint64_t latest = header->latest.load(std::memory_order_acquire);
+        if (latest == 0)
+            return NULL;
+        const SharedFrameSlot* slot = slotHeader((uint32_t)(latest % header->slotCount));
+        sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence & 1)
+            return NULL;
+        frameNumber = slot->frameNumber;
+        timestamp = slot->timestamp;
+        return (const uint8_t*)(slot + 1);
+    }
+
+    bool isStillValid(uint64_t frameNumber, uint64_t sequence) const
+    {
+        const SharedFrameSlot* slot = slotHeader((uint32_t)(frameNumber % header->slotCount));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot->sequence.load(std::memory_order_relaxed) == sequence;
+    }
+
+    // Copies the newest frame out, retrying if it was overwritten mid-copy
+    bool readLatest(void* destination, uint64_t& frameNumber, double& timestamp) const
+    {
+        for (int attempt = 0; attempt < 4; ++attempt)
+        {
+            uint64_t sequence;
+            const uint8_t* pixels = peekLatest(frameNumber, timestamp, sequence);
+            if (pixels == NULL)
+                continue;
+            std::memcpy(destination, pixels, header->frameBytes);
+            if (isStillValid(frameNumber, sequence))
+                return true;
+        }
+        return false;
+    }
+
+private:
+    const SharedFrameSlot* slotHeader(uint32_t slot) const
+    {
+        return (const SharedFrameSlot*)(region.data + sharedFrameHeaderSize() + slot * header->slotStride);
+    }
+
+    SharedMemoryRegion region;
+    const SharedFrameHeader* header = NULL;
+};
@@ -0,0 +1,165 @@
+#pragma once
+
+// Minimal vector and rigid transform math for the headless simulation code.
+// The renderer keeps using glm; these types only exist so the collision and
+// sensor code stays free of GL and compiles to tight loops.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// SSE2 is the SIMD baseline for the CPU kernels, with scalar fallbacks
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ROBOT_SIMD_SSE 1
+#include <emmintrin.h>
+#endif
+
+struct Vec3
+{
+    float x, y, z;
+};
+
+inline Vec3 vec3(float x, float y, float z) { Vec3 v = { x, y, z }; return v; }
+inline Vec3 operator+(const Vec3& a, const Vec3& b) { return vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline Vec3 operator-(const Vec3& a, const Vec3& b) { return vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline Vec3 operator-(const Vec3& a) { return vec3(-a.x, -a.y, -a.z); }
+inline Vec3 operator*(const Vec3& a, float s) { return vec3(a.x * s, a.y * s, a.z * s); }
+inline Vec3 operator*(float s, const Vec3& a) { return a * s; }
+inline Vec3 mul(const Vec3& a, const Vec3& b) { return vec3(a.x * b.x, a.y * b.y, a.z * b.z); }
+inline float dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vec3 cross(const Vec3& a, const Vec3& b) { return vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+inline float length(const Vec3& a) { return std::sqrt(dot(a, a)); }
+inline Vec3 normalize(const Vec3& a) { float l = length(a); return l > 0.0f ? a * (1.0f / l) : a; }
+inline Vec3 vmin(const Vec3& a, const Vec3& b) { return vec3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)); }
+inline Vec3 vmax(const Vec3& a, const Vec3& b) { return vec3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)); }
+
+inline float toRadians(float degrees) { return degrees * 0.017453292519943295f; }
+
+// Row-major 3x3 rotation
+struct Mat3
+{
+    float m[3][3];
+};
+
+inline Mat3 mat3Identity()
+{
+    Mat3 r = { { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } } };
+    return r;
+}
+
+// Same conventions as glRotatef about the X, Y and Z axes, angles in degrees
+inline Mat3 rotationX(float degrees)
+{
+    float c = std::cos(toRadians(degrees)), s = std::sin(toRadians(degrees));
+    Mat3 r = { { { 1, 0, 0 }, { 0, c, -s }, { 0, s, c } } };
+    return r;
+}
+
+inline Mat3 rotationY(float degrees)
+{
+    float c = std::cos(toRadians(degrees)), s = std::sin(toRadians(degrees));
+    Mat3 r = { { { c, 0, s }, { 0, 1, 0 }, { -s, 0, c } } };
+    return r;
+}
+
+inline Mat3 rotationZ(float degrees)
+{
+    float c = std::cos(toRadians(degrees)), s = std::sin(toRadians(degrees));
+    Mat3 r = { { { c, -s, 0 }, { s, c, 0 }, { 0, 0, 1 } } };
+    return r;
+}
+
+inline Mat3 operator*(const Mat3& a, const Mat3& b)
+{
+    Mat3 r;
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+            r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j];
+    return r;
+}
+
+inline Vec3 operator*(const Mat3& a, const Vec3& v)
+{
+    return vec3(a.m[0][0] * v.x + a.m[0][1] * v.y + a.m[0][2] * v.z,
+                a.m[1][0] * v.x + a.m[1][1] * v.y + a.m[1][2] * v.z,
+                a.m[2][0] * v.x + a.m[2][1] * v.y + a.m[2][2] * v.z);
+}
+
+// The yaw * pitch * roll quaternion order the arm joints use in drawRightArm()
+inline Mat3 rotationYXZ(float yaw, float pitch, float roll)
+{
+    return rotationY(yaw) * rotationX(pitch) * rotationZ(roll);
+}
+
+// Rigid transform, applied as rotation then translation
+struct Transform
+{
+    Mat3 rotation;
+    Vec3 translation;
+};
+
+inline Transform transformIdentity()
+{
+    Transform t = { mat3Identity(), vec3(0, 0, 0) };
+    return t;
+}
+
+inline Vec3 operator*(const Transform& t, const Vec3& p) { return t.rotation * p + t.translation; }
+
+inline Transform operator*(const Transform& a, const Transform& b)
+{
+    Transform r = { a.rotation * b.rotation, a * b.translation };
+    return r;
+}
+
+// Equivalent of glTranslatef followed by glRotatef on the current matrix
+inline Transform translated(const Transform& t, float x, float y, float z)
+{
+    Transform r = { t.rotation, t * vec3(x, y, z) };
+    return r;
+}
+
+inline Transform rotated(const Transform& t, const Mat3& rotation)
+{
+    Transform r = { t.rotation * rotation, t.translation };
+    return r;
+}
+
+struct Aabb
+{
+    Vec3 min, max;
+};
+
+inline bool overlaps(const Aabb& a, const Aabb& b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+           a.min.y <= b.max.y && a.max.y >= b.min.y &&
+           a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+inline Aabb merge(const Aabb& a, const Aabb& b)
+{
+    Aabb r = { vmin(a.min, b.min), vmax(a.max, b.max) };
+    return r;
+}
+
+// FNV-1a over some bytes, chained through seed, for cache and redraw keys
+const uint64_t kHashSeed = 14695981039346656037ull;
+
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = kHashSeed)
+{
+    uint64_t hash = seed;
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline uint64_t hashFloats(const float* values, size_t count, uint64_t seed = kHashSeed)
+{
+    return hashBytes(values, count * sizeof(float), seed);
+}
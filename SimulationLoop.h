@@ -0,0 +1,75 @@
+#pragma once
+
+// Fixed-rate control loop on its own thread. Every tick gets the same dt,
+// so the simulation advances at a steady rate however long frames take to
+// render. Late ticks run back to back to catch up, unless the loop is so far
+// behind (a debugger break, a suspended process) that it just starts over
+// from now.
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+class SimulationLoop
+{
+public:
+    ~SimulationLoop() { stop(); }
+
+    // Calls tick(1 / ticksPerSecond) ticksPerSecond times a second until stop()
+    void start(float ticksPerSecond, const std::function<void(float dt)>& tickFunction)
+    {
+        stop();
+        rate = ticksPerSecond;
+        tick = tickFunction;
+        quit = false;
+        busy = true;
+        worker = std::thread(&SimulationLoop::run, this);
+    }
+
+    void stop()
+    {
+        if (!worker.joinable())
+            return;
+        quit = true;
+        worker.join();
+    }
+
+    bool running() const { return busy; }
+
+    float rate = 120.0f;
+    int maxCatchUp = 8;                             // ticks behind before giving up on catching up
+    std::atomic<unsigned long long> ticks{ 0 };
+    std::atomic<unsigned long long> lateTicks{ 0 }; // started after their slot
+    std::atomic<double> tickSeconds{ 0.0 };         // how long the last tick took
+
+private:
+    void run()
+    {
+        typedef std::chrono::steady_clock Clock;
+        Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+        float dt = 1.0f / rate;
+        Clock::time_point next = Clock::now();
+        while (!quit)
+        {
+            Clock::time_point begin = Clock::now();
+            if (begin > next + period)
+            {
+                ++lateTicks;
+                if (begin > next + period * maxCatchUp)
+                    next = begin;
+            }
+            tick(dt);
+            tickSeconds = std::chrono::duration<double>(Clock::now() - begin).count();
+            ++ticks;
+
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+        busy = false;
+    }
+
+    std::function<void(float)> tick;
+    std::thread worker;
+    std::atomic<bool> quit{ false }, busy{ false };
+};
@@ -0,0 +1,253 @@
+#pragma once
+
+// Image-based ambient light from the skybox. The cubemap is projected once,
+// at load time, into second-order spherical harmonics: nine coefficients
+// per colour channel. Irradiance for a normal then takes a few multiply-adds
+// through Ramamoorthi and Hanrahan's quadratic form E(n) = n^T M n, with n
+// extended to (x, y, z, 1), and no texture fetches. The projection runs four
+// texels at a time with SSE, and the coefficients are cached in a small
+// file next to the cubemap's images. No GL in here.
+
+#include "SoftRasterizer.h"
+
+#include <sys/stat.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct SkyIrradiance
+{
+    float coefficients[9][3] = {};  // radiance, bands 0 to 2 in the usual (l, m) order, RGB
+    bool valid = false;
+
+    // Projects the sky's base levels, weighting every texel by its solid angle
+    void project(const RasterCubemap& sky)
+    {
+        double sums[9][3] = {};
+        double totalWeight = 0.0;
+        for (int face = 0; face < 6; ++face)
+        {
+            if (sky.faces[face].empty())
+            {
+                valid = false;
+                return;
+            }
+            const RasterTexture::Level& level = sky.faces[face].levels[0];
+            const float (*axes)[3] = RasterCubemap::kFaceAxes[face];
+            float texelArea = 4.0f / ((float)level.width * level.height);
+
+            for (int y = 0; y < level.height; ++y)
+            {
+                float t = 2.0f * (y + 0.5f) / level.height - 1.0f;
+                const uint32_t* row = &level.texels[(size_t)y * level.width];
+                float rowSums[9][3] = {};
+                float rowWeight = 0.0f;
+                int x = 0;
+#ifdef ROBOT_SIMD_SSE
+                __m128 acc[9][3];
+                for (int k = 0; k < 9; ++k)
+                    acc[k][0] = acc[k][1] = acc[k][2] = _mm_setzero_ps();
+                __m128 weightAcc = _mm_setzero_ps();
+                __m128 vt = _mm_set1_ps(t), area = _mm_set1_ps(texelArea), one = _mm_set1_ps(1.0f);
+                __m128 toS = _mm_set1_ps(2.0f / level.width), sOffset = _mm_set1_ps(1.0f / level.width - 1.0f);
+                __m128i byteMask = _mm_set1_epi32(255);
+                __m128 toUnit = _mm_set1_ps(1.0f / 255.0f);
+                for (; x + 4 <= level.width; x += 4)
+                {
+                    __m128 s = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f)), toS), sOffset);
+                    __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(one, _mm_add_ps(_mm_mul_ps(s, s), _mm_mul_ps(vt, vt)))));
+                    __m128 weight = _mm_mul_ps(area, _mm_mul_ps(invLength, _mm_mul_ps(invLength, invLength)));
+                    __m128 d[3];
+                    for (int i = 0; i < 3; ++i)
+                        d[i] = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(axes[0][i]), _mm_add_ps(_mm_mul_ps(s, _mm_set1_ps(axes[1][i])), _mm_mul_ps(vt, _mm_set1_ps(axes[2][i])))), invLength);
+
+                    __m128 basis[9];
+                    shBasis4(d[0], d[1], d[2], basis);
+                    __m128i texels = _mm_loadu_si128((const __m128i*)(row + x));
+                    __m128 color[3] =
+                    {
+                        _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(texels, byteMask)), toUnit),
+                        _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texels, 8), byteMask)), toUnit),
+                        _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texels, 16), byteMask)), toUnit),
+                    };
+                    for (int c = 0; c < 3; ++c)
+                        color[c] = _mm_mul_ps(color[c], weight);
+                    for (int k = 0; k < 9; ++k)
+                        for (int c = 0; c < 3; ++c)
+                            acc[k][c] = _mm_add_ps(acc[k][c], _mm_mul_ps(basis[k], color[c]));
+                    weightAcc = _mm_add_ps(weightAcc, weight);
+                }
+                float lanes[4];
+                for (int k = 0; k < 9; ++k)
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        _mm_storeu_ps(lanes, acc[k][c]);
+                        rowSums[k][c] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+                    }
+                _mm_storeu_ps(lanes, weightAcc);
+                rowWeight = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+                for (; x < level.width; ++x)
+                {
+                    float s = 2.0f * (x + 0.5f) / level.width - 1.0f;
+                    float invLength = 1.0f / std::sqrt(1.0f + s * s + t * t);
+                    float weight = texelArea * invLength * invLength * invLength;
+                    float d[3];
+                    for (int i = 0; i < 3; ++i)
+                        d[i] = (axes[0][i] + s * axes[1][i] + t * axes[2][i]) * invLength;
+                    float basis[9];
+                    shBasis(d[0], d[1], d[2], basis);
+                    uint32_t texel = row[x];
+                    float color[3] = { (texel & 255) / 255.0f, (texel >> 8 & 255) / 255.0f, (texel >> 16 & 255) / 255.0f };
+                    for (int k = 0; k < 9; ++k)
+                        for (int c = 0; c < 3; ++c)
+                            rowSums[k][c] += basis[k] * color[c] * weight;
+                    rowWeight += weight;
+                }
+
+                for (int k = 0; k < 9; ++k)
+                    for (int c = 0; c < 3; ++c)
+                        sums[k][c] += rowSums[k][c];
+                totalWeight += rowWeight;
+            }
+        }
+
+        // The texel solid angles add up to 4 pi up to rounding; make it exact
+        double normalize = totalWeight > 0.0 ? 4.0 * 3.14159265358979 / totalWeight : 0.0;
+        for (int k = 0; k < 9; ++k)
+            for (int c = 0; c < 3; ++c)
+                coefficients[k][c] = (float)(sums[k][c] * normalize);
+        valid = true;
+    }
+
+    // Per-channel 4x4 matrices, column-major, with E(n) = n^T M n for a unit
+    // normal n extended to (x, y, z, 1). scale multiplies the result.
+    void matrices(float m[3][16], float scale = 1.0f) const
+    {
+        const float c1 = 0.429043f, c2 = 0.511664f, c3 = 0.743125f, c4 = 0.886227f, c5 = 0.247708f;
+        for (int c = 0; c < 3; ++c)
+        {
+            float l00 = coefficients[0][c], l1m1 = coefficients[1][c], l10 = coefficients[2][c], l11 = coefficients[3][c];
+            float l2m2 = coefficients[4][c], l2m1 = coefficients[5][c], l20 = coefficients[6][c], l21 = coefficients[7][c], l22 = coefficients[8][c];
+            float r[16] =
+            {
+                c1 * l22,  c1 * l2m2, c1 * l21,  c2 * l11,
+                c1 * l2m2, -c1 * l22, c1 * l2m1, c2 * l1m1,
+                c1 * l21,  c1 * l2m1, c3 * l20,  c2 * l10,
+                c2 * l11,  c2 * l1m1, c2 * l10,  c4 * l00 - c5 * l20,
+            };
+            for (int i = 0; i < 16; ++i)
+                m[c][i] = r[i] * scale;
+        }
+    }
+
+    Vec3 evaluate(const Vec3& n, float scale = 1.0f) const
+    {
+        float m[3][16];
+        matrices(m, scale);
+        return vec3(quadraticForm(m[0], n), quadraticForm(m[1], n), quadraticForm(m[2], n));
+    }
+
+    // Irradiance averaged over all normal directions
+    Vec3 average() const
+    {
+        const float a0 = 3.14159265f * 0.282095f;
+        return vec3(coefficients[0][0] * a0, coefficients[0][1] * a0, coefficients[0][2] * a0);
+    }
+
+    // The cache holds a signature of the source images, so edited or
+    // replaced images are projected again rather than read back stale
+    bool load(const char* path, uint64_t signature)
+    {
+        FILE* file = fopen(path, "rb");
+        if (file == NULL)
+            return false;
+        CacheHeader header;
+        float stored[9][3];
+        bool ok = fread(&header, sizeof(header), 1, file) == 1 && fread(stored, sizeof(stored), 1, file) == 1;
+        fclose(file);
+        if (!ok || memcmp(header.magic, "SHI1", 4) != 0 || header.signature != signature)
+            return false;
+        memcpy(coefficients, stored, sizeof(coefficients));
+        valid = true;
+        return true;
+    }
+
+    bool save(const char* path, uint64_t signature) const
+    {
+        FILE* file = fopen(path, "wb");
+        if (file == NULL)
+            return false;
+        CacheHeader header;
+        memcpy(header.magic, "SHI1", 4);
+        header.signature = signature;
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(coefficients, sizeof(coefficients), 1, file) == 1;
+        return fclose(file) == 0 && ok;
+    }
+
+    static float quadraticForm(const float* m, const Vec3& n)
+    {
+        float v[4] = { n.x, n.y, n.z, 1.0f };
+        float e = 0.0f;
+        for (int i = 0; i < 4; ++i)
+            e += v[i] * (m[i * 4] * v[0] + m[i * 4 + 1] * v[1] + m[i * 4 + 2] * v[2] + m[i * 4 + 3] * v[3]);
+        return e;
+    }
+
+    // Real spherical harmonics up to band 2 for a unit direction
+    static void shBasis(float x, float y, float z, float* basis)
+    {
+        basis[0] = 0.282095f;
+        basis[1] = 0.488603f * y;
+        basis[2] = 0.488603f * z;
+        basis[3] = 0.488603f * x;
+        basis[4] = 1.092548f * x * y;
+        basis[5] = 1.092548f * y * z;
+        basis[6] = 0.315392f * (3.0f * z * z - 1.0f);
+        basis[7] = 1.092548f * x * z;
+        basis[8] = 0.546274f * (x * x - y * y);
+    }
+
+#ifdef ROBOT_SIMD_SSE
+    static void shBasis4(__m128 x, __m128 y, __m128 z, __m128* basis)
+    {
+        __m128 k1 = _mm_set1_ps(0.488603f), k2 = _mm_set1_ps(1.092548f);
+        basis[0] = _mm_set1_ps(0.282095f);
+        basis[1] = _mm_mul_ps(k1, y);
+        basis[2] = _mm_mul_ps(k1, z);
+        basis[3] = _mm_mul_ps(k1, x);
+        basis[4] = _mm_mul_ps(k2, _mm_mul_ps(x, y));
+        basis[5] = _mm_mul_ps(k2, _mm_mul_ps(y, z));
+        basis[6] = _mm_mul_ps(_mm_set1_ps(0.315392f), _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.0f), _mm_mul_ps(z, z)), _mm_set1_ps(1.0f)));
+        basis[7] = _mm_mul_ps(k2, _mm_mul_ps(x, z));
+        basis[8] = _mm_mul_ps(_mm_set1_ps(0.546274f), _mm_sub_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+    }
+#endif
+
+private:
+    struct CacheHeader
+    {
+        char magic[4];
+        uint32_t reserved = 0;
+        uint64_t signature;
+    };
+};
+
+// Hash of the files' sizes and modification times, 0 if any is missing
+inline uint64_t fileSignature(const std::vector<std::string>& paths)
+{
+    uint64_t hash = kHashSeed;
+    for (const std::string& path : paths)
+    {
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0)
+            return 0;
+        uint64_t values[2] = { (uint64_t)info.st_size, (uint64_t)info.st_mtime };
+        hash = hashBytes(values, sizeof(values), hash);
+    }
+    return hash;
+}
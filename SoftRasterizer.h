@@ -0,0 +1,940 @@
+#pragma once
+
+// CPU rasterizer for machines without a GPU, where the fixed-function path
+// lands on a slow generic software fallback. It draws RasterMeshes with the
+// fixed-function pipeline's lighting: one light, per-vertex Blinn-Phong
+// with GL's light model defaults and modulate texturing, over a cubemap
+// background.
+//
+// Draws are queued, then render() runs three phases: draws are transformed,
+// lit, clipped and set up in parallel; their triangles are binned into
+// 64x64 screen tiles in submission order; and tiles are handed out one at a
+// time, largest bin first, so busy tiles don't hold up an idle thread. Each
+// tile is rasterized in cache-resident buffers four pixels at a time with
+// SSE2. The result is bottom-up RGBA and window-space depth, ready for
+// glDrawPixels.
+
+#include "JobSystem.h"
+#include "RasterMeshes.h"
+#include "SimMath.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Column-major 4x4 matrix with OpenGL's conventions
+struct Mat4
+{
+    float m[16];
+};
+
+inline Mat4 mat4Identity()
+{
+    Mat4 r = {};
+    r.m[0] = r.m[5] = r.m[10] = r.m[15] = 1.0f;
+    return r;
+}
+
+inline Mat4 operator*(const Mat4& a, const Mat4& b)
+{
+    Mat4 r;
+    for (int c = 0; c < 4; ++c)
+        for (int row = 0; row < 4; ++row)
+            r.m[c * 4 + row] = a.m[row] * b.m[c * 4] + a.m[4 + row] * b.m[c * 4 + 1] + a.m[8 + row] * b.m[c * 4 + 2] + a.m[12 + row] * b.m[c * 4 + 3];
+    return r;
+}
+
+inline Mat4 mat4Translation(float x, float y, float z)
+{
+    Mat4 r = mat4Identity();
+    r.m[12] = x;
+    r.m[13] = y;
+    r.m[14] = z;
+    return r;
+}
+
+inline Mat4 mat4Scaling(float x, float y, float z)
+{
+    Mat4 r = mat4Identity();
+    r.m[0] = x;
+    r.m[5] = y;
+    r.m[10] = z;
+    return r;
+}
+
+// glRotatef
+inline Mat4 mat4Rotation(float degrees, float x, float y, float z)
+{
+    Vec3 a = normalize(vec3(x, y, z));
+    float c = std::cos(toRadians(degrees)), s = std::sin(toRadians(degrees)), t = 1.0f - c;
+    Mat4 r = mat4Identity();
+    r.m[0] = a.x * a.x * t + c;        r.m[4] = a.x * a.y * t - a.z * s;  r.m[8] = a.x * a.z * t + a.y * s;
+    r.m[1] = a.y * a.x * t + a.z * s;  r.m[5] = a.y * a.y * t + c;        r.m[9] = a.y * a.z * t - a.x * s;
+    r.m[2] = a.z * a.x * t - a.y * s;  r.m[6] = a.z * a.y * t + a.x * s;  r.m[10] = a.z * a.z * t + c;
+    return r;
+}
+
+// gluPerspective
+inline Mat4 mat4Perspective(float fovY, float aspect, float nearPlane, float farPlane)
+{
+    float f = 1.0f / std::tan(toRadians(fovY) * 0.5f);
+    Mat4 r = {};
+    r.m[0] = f / aspect;
+    r.m[5] = f;
+    r.m[10] = (farPlane + nearPlane) / (nearPlane - farPlane);
+    r.m[11] = -1.0f;
+    r.m[14] = 2.0f * farPlane * nearPlane / (nearPlane - farPlane);
+    return r;
+}
+
+// gluLookAt
+inline Mat4 mat4LookAt(const Vec3& eye, const Vec3& target, const Vec3& up)
+{
+    Vec3 f = normalize(target - eye);
+    Vec3 s = normalize(cross(f, up));
+    Vec3 u = cross(s, f);
+    Mat4 r = mat4Identity();
+    r.m[0] = s.x;  r.m[4] = s.y;  r.m[8] = s.z;   r.m[12] = -dot(s, eye);
+    r.m[1] = u.x;  r.m[5] = u.y;  r.m[9] = u.z;   r.m[13] = -dot(u, eye);
+    r.m[2] = -f.x; r.m[6] = -f.y; r.m[10] = -f.z; r.m[14] = dot(f, eye);
+    return r;
+}
+
+inline Vec3 transformPoint(const Mat4& a, const Vec3& p)
+{
+    return vec3(a.m[0] * p.x + a.m[4] * p.y + a.m[8] * p.z + a.m[12],
+                a.m[1] * p.x + a.m[5] * p.y + a.m[9] * p.z + a.m[13],
+                a.m[2] * p.x + a.m[6] * p.y + a.m[10] * p.z + a.m[14]);
+}
+
+// Inverse transpose of the upper 3x3, for transforming normals. The
+// determinant's sign is kept so mirroring transforms are still detectable.
+inline Mat3 normalMatrix(const Mat4& a, float* determinant = NULL)
+{
+    float m00 = a.m[0], m01 = a.m[4], m02 = a.m[8];
+    float m10 = a.m[1], m11 = a.m[5], m12 = a.m[9];
+    float m20 = a.m[2], m21 = a.m[6], m22 = a.m[10];
+    Mat3 r = { { { m11 * m22 - m12 * m21, m12 * m20 - m10 * m22, m10 * m21 - m11 * m20 },
+                 { m02 * m21 - m01 * m22, m00 * m22 - m02 * m20, m01 * m20 - m00 * m21 },
+                 { m01 * m12 - m02 * m11, m02 * m10 - m00 * m12, m00 * m11 - m01 * m10 } } };
+    float det = m00 * r.m[0][0] + m01 * r.m[0][1] + m02 * r.m[0][2];
+    if (determinant)
+        *determinant = det;
+    float inv = det != 0.0f ? 1.0f / det : 0.0f;
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+            r.m[i][j] *= inv;
+    return r;
+}
+
+// glMaterial state for GL_FRONT, starting from GL's defaults
+struct RasterMaterial
+{
+    float ambient[4] = { 0.2f, 0.2f, 0.2f, 1.0f };
+    float diffuse[4] = { 0.8f, 0.8f, 0.8f, 1.0f };
+    float specular[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    float emission[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    float shininess = 0.0f;
+};
+
+// GL_LIGHT0 and the light model's global ambient
+struct RasterLight
+{
+    float position[4] = { 0.0f, 0.0f, 1.0f, 0.0f };     // eye space, w = 0 for a directional light
+    float ambient[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    float diffuse[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    float specular[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    float globalAmbient[4] = { 0.2f, 0.2f, 0.2f, 1.0f };
+
+    // With skyAmbient the light's ambient varies with the normal instead:
+    // n^T M n per channel, for n = (eye-space normal, 1) (SkyIrradiance.h)
+    bool skyAmbient = false;
+    float ambientMatrices[3][16] = {};
+};
+
+// Fixed-function vertex lighting with a non-local viewer, clamped like GL's
+// primary colour
+inline Vec3 lightVertex(const RasterLight& light, const RasterMaterial& material, const Vec3& position, const Vec3& normal)
+{
+    Vec3 l = light.position[3] != 0.0f ? normalize(vec3(light.position[0], light.position[1], light.position[2]) - position)
+                                       : normalize(vec3(light.position[0], light.position[1], light.position[2]));
+    float diffuse = std::max(dot(normal, l), 0.0f);
+    float specular = 0.0f;
+    if (diffuse > 0.0f)
+    {
+        float nh = std::max(dot(normal, normalize(l + vec3(0.0f, 0.0f, 1.0f))), 0.0f);
+        specular = material.shininess > 0.0f ? std::pow(nh, material.shininess) : 1.0f;
+    }
+    float ambient[3] = { light.ambient[0], light.ambient[1], light.ambient[2] };
+    if (light.skyAmbient)
+    {
+        float n[4] = { normal.x, normal.y, normal.z, 1.0f };
+        for (int i = 0; i < 3; ++i)
+        {
+            const float* m = light.ambientMatrices[i];
+            ambient[i] = 0.0f;
+            for (int j = 0; j < 4; ++j)
+                ambient[i] += n[j] * (m[j * 4] * n[0] + m[j * 4 + 1] * n[1] + m[j * 4 + 2] * n[2] + m[j * 4 + 3] * n[3]);
+        }
+    }
+    float c[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        float v = material.emission[i] + material.ambient[i] * (light.globalAmbient[i] + ambient[i]) +
+            diffuse * material.diffuse[i] * light.diffuse[i] + specular * material.specular[i] * light.specular[i];
+        c[i] = std::min(std::max(v, 0.0f), 1.0f);
+    }
+    return vec3(c[0], c[1], c[2]);
+}
+
+inline uint32_t packRgba(float r, float g, float b)
+{
+    return (uint32_t)(r * 255.0f + 0.5f) | (uint32_t)(g * 255.0f + 0.5f) << 8 | (uint32_t)(b * 255.0f + 0.5f) << 16 | 0xff000000u;
+}
+
+// RGBA8 texture with a box-filtered mip chain. Rows stay in upload order,
+// so t = 0 is the image's first row as it is for glTexImage2D.
+struct RasterTexture
+{
+    struct Level
+    {
+        int width = 0, height = 0;
+        std::vector<uint32_t> texels;
+    };
+    std::vector<Level> levels;
+
+    bool empty() const { return levels.empty(); }
+
+    void setImage(const unsigned char* pixels, int width, int height, int channels, bool mipmaps)
+    {
+        levels.assign(1, Level());
+        levels[0].width = width;
+        levels[0].height = height;
+        levels[0].texels.resize((size_t)width * height);
+        for (size_t i = 0; i < levels[0].texels.size(); ++i)
+        {
+            const unsigned char* p = pixels + i * channels;
+            uint32_t r = p[0], g = channels >= 3 ? p[1] : p[0], b = channels >= 3 ? p[2] : p[0];
+            uint32_t a = channels == 4 ? p[3] : channels == 2 ? p[1] : 255;
+            levels[0].texels[i] = r | g << 8 | b << 16 | a << 24;
+        }
+
+        while (mipmaps && (levels.back().width > 1 || levels.back().height > 1))
+        {
+            const Level& src = levels.back();
+            Level dst;
+            dst.width = std::max(src.width / 2, 1);
+            dst.height = std::max(src.height / 2, 1);
+            dst.texels.resize((size_t)dst.width * dst.height);
+            for (int y = 0; y < dst.height; ++y)
+                for (int x = 0; x < dst.width; ++x)
+                {
+                    int x0 = std::min(x * 2, src.width - 1), x1 = std::min(x * 2 + 1, src.width - 1);
+                    int y0 = std::min(y * 2, src.height - 1), y1 = std::min(y * 2 + 1, src.height - 1);
+                    uint32_t t[4] = { src.texels[(size_t)y0 * src.width + x0], src.texels[(size_t)y0 * src.width + x1],
+                                      src.texels[(size_t)y1 * src.width + x0], src.texels[(size_t)y1 * src.width + x1] };
+                    uint32_t out = 0;
+                    for (int c = 0; c < 32; c += 8)
+                        out |= (((t[0] >> c & 255) + (t[1] >> c & 255) + (t[2] >> c & 255) + (t[3] >> c & 255) + 2) / 4) << c;
+                    dst.texels[(size_t)y * dst.width + x] = out;
+                }
+            levels.push_back(std::move(dst));
+        }
+    }
+
+    // Bilinear sample of one mip level into 0..1 floats, with GL_REPEAT or
+    // GL_CLAMP_TO_EDGE wrapping
+    void sample(float s, float t, int level, bool repeat, float* rgba) const
+    {
+        const Level& l = levels[std::min(std::max(level, 0), (int)levels.size() - 1)];
+        float x = s * l.width - 0.5f, y = t * l.height - 0.5f;
+        float fx = std::floor(x), fy = std::floor(y);
+        int x0 = (int)fx, y0 = (int)fy;
+        float ax = x - fx, ay = y - fy;
+        int xs[2] = { x0, x0 + 1 }, ys[2] = { y0, y0 + 1 };
+        for (int i = 0; i < 2; ++i)
+        {
+            if (repeat)
+            {
+                xs[i] %= l.width;
+                xs[i] += xs[i] < 0 ? l.width : 0;
+                ys[i] %= l.height;
+                ys[i] += ys[i] < 0 ? l.height : 0;
+            }
+            else
+            {
+                xs[i] = std::min(std::max(xs[i], 0), l.width - 1);
+                ys[i] = std::min(std::max(ys[i], 0), l.height - 1);
+            }
+        }
+        uint32_t t00 = l.texels[(size_t)ys[0] * l.width + xs[0]], t10 = l.texels[(size_t)ys[0] * l.width + xs[1]];
+        uint32_t t01 = l.texels[(size_t)ys[1] * l.width + xs[0]], t11 = l.texels[(size_t)ys[1] * l.width + xs[1]];
+        for (int c = 0; c < 4; ++c)
+        {
+            int shift = c * 8;
+            float top = (t00 >> shift & 255) + ((float)(t10 >> shift & 255) - (t00 >> shift & 255)) * ax;
+            float bottom = (t01 >> shift & 255) + ((float)(t11 >> shift & 255) - (t01 >> shift & 255)) * ax;
+            rgba[c] = (top + (bottom - top) * ay) * (1.0f / 255.0f);
+        }
+    }
+
+#ifdef ROBOT_SIMD_SSE
+    // Four bilinear samples at once, RGB only. Wrapping and texel addressing
+    // stay in float, which is exact for textures up to 4096x4096.
+    void sample4(__m128 s, __m128 t, int level, bool repeat, __m128* rgb) const
+    {
+        const Level& l = levels[std::min(std::max(level, 0), (int)levels.size() - 1)];
+        const __m128 one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f), zero = _mm_setzero_ps();
+        const __m128 width = _mm_set1_ps((float)l.width), height = _mm_set1_ps((float)l.height);
+        if (repeat)
+        {
+            s = _mm_sub_ps(s, floor4(s));
+            t = _mm_sub_ps(t, floor4(t));
+        }
+        __m128 x = _mm_sub_ps(_mm_mul_ps(s, width), half), y = _mm_sub_ps(_mm_mul_ps(t, height), half);
+        __m128 x0 = floor4(x), y0 = floor4(y);
+        __m128 ax = _mm_sub_ps(x, x0), ay = _mm_sub_ps(y, y0);
+        __m128 x1 = _mm_add_ps(x0, one), y1 = _mm_add_ps(y0, one);
+        if (repeat)
+        {
+            x0 = _mm_add_ps(x0, _mm_and_ps(_mm_cmplt_ps(x0, zero), width));
+            y0 = _mm_add_ps(y0, _mm_and_ps(_mm_cmplt_ps(y0, zero), height));
+            x1 = _mm_sub_ps(x1, _mm_and_ps(_mm_cmpge_ps(x1, width), width));
+            y1 = _mm_sub_ps(y1, _mm_and_ps(_mm_cmpge_ps(y1, height), height));
+        }
+        else
+        {
+            __m128 maxX = _mm_sub_ps(width, one), maxY = _mm_sub_ps(height, one);
+            x0 = _mm_min_ps(_mm_max_ps(x0, zero), maxX);
+            y0 = _mm_min_ps(_mm_max_ps(y0, zero), maxY);
+            x1 = _mm_min_ps(_mm_max_ps(x1, zero), maxX);
+            y1 = _mm_min_ps(_mm_max_ps(y1, zero), maxY);
+        }
+
+        alignas(16) int index[4][4];
+        _mm_store_si128((__m128i*)index[0], _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(y0, width), x0)));
+        _mm_store_si128((__m128i*)index[1], _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(y0, width), x1)));
+        _mm_store_si128((__m128i*)index[2], _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(y1, width), x0)));
+        _mm_store_si128((__m128i*)index[3], _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(y1, width), x1)));
+        __m128i texel[4];
+        for (int i = 0; i < 4; ++i)
+            texel[i] = _mm_setr_epi32((int)l.texels[index[i][0]], (int)l.texels[index[i][1]], (int)l.texels[index[i][2]], (int)l.texels[index[i][3]]);
+
+        const __m128i byte = _mm_set1_epi32(255);
+        const __m128 normalize = _mm_set1_ps(1.0f / 255.0f);
+        for (int c = 0; c < 3; ++c)
+        {
+            __m128 v[4];
+            for (int i = 0; i < 4; ++i)
+                v[i] = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texel[i], c * 8), byte));
+            __m128 top = _mm_add_ps(v[0], _mm_mul_ps(_mm_sub_ps(v[1], v[0]), ax));
+            __m128 bottom = _mm_add_ps(v[2], _mm_mul_ps(_mm_sub_ps(v[3], v[2]), ax));
+            rgb[c] = _mm_mul_ps(_mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), ay)), normalize);
+        }
+    }
+
+    static __m128 floor4(__m128 x)
+    {
+        __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+        return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.0f)));
+    }
+#endif
+};
+
+// Six faces in GL's order: +X, -X, +Y, -Y, +Z, -Z
+struct RasterCubemap
+{
+    RasterTexture faces[6];
+
+    // Face directions as GL picks faces: d = axis + s * sAxis + t * tAxis,
+    // s and t in [-1, 1] across the face's columns and rows
+    static constexpr float kFaceAxes[6][3][3] =
+    {
+        { { 1, 0, 0 }, { 0, 0, -1 }, { 0, -1, 0 } },
+        { { -1, 0, 0 }, { 0, 0, 1 }, { 0, -1, 0 } },
+        { { 0, 1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } },
+        { { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, -1 } },
+        { { 0, 0, 1 }, { 1, 0, 0 }, { 0, -1, 0 } },
+        { { 0, 0, -1 }, { -1, 0, 0 }, { 0, -1, 0 } },
+    };
+
+    bool empty() const { return faces[0].empty(); }
+
+    // GL's face selection, bilinear within the face and clamped at its edges
+    void sample(const Vec3& r, float* rgba) const
+    {
+        float ax = std::fabs(r.x), ay = std::fabs(r.y), az = std::fabs(r.z);
+        int face;
+        float sc, tc, ma;
+        if (ax >= ay && ax >= az)
+        {
+            face = r.x > 0.0f ? 0 : 1;
+            sc = r.x > 0.0f ? -r.z : r.z;
+            tc = -r.y;
+            ma = ax;
+        }
+        else if (ay >= az)
+        {
+            face = r.y > 0.0f ? 2 : 3;
+            sc = r.x;
+            tc = r.y > 0.0f ? r.z : -r.z;
+            ma = ay;
+        }
+        else
+        {
+            face = r.z > 0.0f ? 4 : 5;
+            sc = r.z > 0.0f ? r.x : -r.x;
+            tc = -r.y;
+            ma = az;
+        }
+        float inv = 0.5f / ma;
+        faces[face].sample(sc * inv + 0.5f, tc * inv + 0.5f, 0, false, rgba);
+    }
+
+#ifdef ROBOT_SIMD_SSE
+    // Four directions at once. Neighbouring pixels nearly always look at the
+    // same face; the rare groups straddling an edge go one lane at a time.
+    void sample4(__m128 x, __m128 y, __m128 z, __m128* rgb) const
+    {
+        alignas(16) float rx[4], ry[4], rz[4];
+        _mm_store_ps(rx, x);
+        _mm_store_ps(ry, y);
+        _mm_store_ps(rz, z);
+        int face[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            float ax = std::fabs(rx[i]), ay = std::fabs(ry[i]), az = std::fabs(rz[i]);
+            face[i] = ax >= ay && ax >= az ? (rx[i] > 0.0f ? 0 : 1) : ay >= az ? (ry[i] > 0.0f ? 2 : 3) : (rz[i] > 0.0f ? 4 : 5);
+        }
+
+        if (face[0] == face[1] && face[0] == face[2] && face[0] == face[3])
+        {
+            const __m128 zero = _mm_setzero_ps(), half = _mm_set1_ps(0.5f);
+            __m128 sc, tc, ma;
+            switch (face[0])
+            {
+            case 0: sc = _mm_sub_ps(zero, z); tc = _mm_sub_ps(zero, y); ma = x; break;
+            case 1: sc = z; tc = _mm_sub_ps(zero, y); ma = _mm_sub_ps(zero, x); break;
+            case 2: sc = x; tc = z; ma = y; break;
+            case 3: sc = x; tc = _mm_sub_ps(zero, z); ma = _mm_sub_ps(zero, y); break;
+            case 4: sc = x; tc = _mm_sub_ps(zero, y); ma = z; break;
+            default: sc = _mm_sub_ps(zero, x); tc = _mm_sub_ps(zero, y); ma = _mm_sub_ps(zero, z); break;
+            }
+            __m128 inv = _mm_div_ps(half, ma);
+            faces[face[0]].sample4(_mm_add_ps(_mm_mul_ps(sc, inv), half), _mm_add_ps(_mm_mul_ps(tc, inv), half), 0, false, rgb);
+            return;
+        }
+
+        alignas(16) float lanes[3][4];
+        for (int i = 0; i < 4; ++i)
+        {
+            float rgba[4];
+            sample(vec3(rx[i], ry[i], rz[i]), rgba);
+            lanes[0][i] = rgba[0];
+            lanes[1][i] = rgba[1];
+            lanes[2][i] = rgba[2];
+        }
+        for (int c = 0; c < 3; ++c)
+            rgb[c] = _mm_load_ps(lanes[c]);
+    }
+#endif
+};
+
+class SoftRasterizer
+{
+public:
+    static const int kTileSize = 64;
+
+    // Starts a frame: sets the target size and projection and drops the
+    // previous frame's draws. Pixels nothing covers get the sky, or
+    // clearColor without one.
+    void begin(int width, int height, const Mat4& projection, const float* clearColor)
+    {
+        frameWidth = width;
+        frameHeight = height;
+        this->projection = projection;
+        clear = packRgba(clearColor[0], clearColor[1], clearColor[2]);
+        drawCount = 0;
+        sky = NULL;
+        tilesX = (width + kTileSize - 1) / kTileSize;
+        tilesY = (height + kTileSize - 1) / kTileSize;
+        bins.resize((size_t)tilesX * tilesY);
+        colorBuffer.resize((size_t)width * height);
+        depthBuffer.resize((size_t)width * height);
+    }
+
+    void setLight(const RasterLight& light) { this->light = light; }
+
+    // Background seen through view's rotation, behind all geometry
+    void setSky(const RasterCubemap* cubemap, const Mat4& view)
+    {
+        sky = cubemap && !cubemap->empty() ? cubemap : NULL;
+        skyRight = vec3(view.m[0], view.m[4], view.m[8]) * (1.0f / projection.m[0]);
+        skyUp = vec3(view.m[1], view.m[5], view.m[9]) * (1.0f / projection.m[5]);
+        skyForward = -vec3(view.m[2], view.m[6], view.m[10]);
+    }
+
+    // Queues a mesh. The material is copied; the mesh and texture are only
+    // referenced, so they must outlive render().
+    void draw(const RasterMesh& mesh, const Mat4& modelView, const RasterMaterial& material, const RasterTexture* texture)
+    {
+        if (drawCount == draws.size())
+            draws.emplace_back();
+        DrawCall& call = draws[drawCount++];
+        call.mesh = &mesh;
+        call.modelView = modelView;
+        call.material = material;
+        call.texture = texture && !texture->empty() && !mesh.uvs.empty() ? texture : NULL;
+    }
+
+    void render()
+    {
+        JobSystem& jobs = JobSystem::shared();
+
+        // Geometry: one draw at a time per thread
+        std::atomic<size_t> nextDraw(0);
+        jobs.parallelFor(jobs.threadCount(), [&](size_t, size_t)
+        {
+            for (size_t i = nextDraw++; i < drawCount; i = nextDraw++)
+                processDraw(draws[i]);
+        }, 1);
+
+        // Binning in submission order keeps depth ties resolving like GL's
+        triangles = 0;
+        for (std::vector<const RasterTriangle*>& bin : bins)
+            bin.clear();
+        for (size_t i = 0; i < drawCount; ++i)
+            for (const RasterTriangle& t : draws[i].triangles)
+            {
+                for (int ty = t.minY / kTileSize; ty <= t.maxY / kTileSize; ++ty)
+                    for (int tx = t.minX / kTileSize; tx <= t.maxX / kTileSize; ++tx)
+                        bins[(size_t)ty * tilesX + tx].push_back(&t);
+                ++triangles;
+            }
+
+        tileOrder.resize(bins.size());
+        for (size_t i = 0; i < tileOrder.size(); ++i)
+            tileOrder[i] = (int)i;
+        std::stable_sort(tileOrder.begin(), tileOrder.end(), [this](int a, int b) { return bins[a].size() > bins[b].size(); });
+
+        std::atomic<size_t> nextTile(0);
+        jobs.parallelFor(jobs.threadCount(), [&](size_t, size_t)
+        {
+            alignas(16) uint32_t tileColor[kTileSize * kTileSize];
+            alignas(16) float tileDepth[kTileSize * kTileSize];
+            for (size_t i = nextTile++; i < tileOrder.size(); i = nextTile++)
+                renderTile(tileOrder[i], tileColor, tileDepth);
+        }, 1);
+    }
+
+    int width() const { return frameWidth; }
+    int height() const { return frameHeight; }
+    size_t triangleCount() const { return triangles; }
+
+    // Bottom-up rows, like glReadPixels and glDrawPixels
+    const uint32_t* color() const { return colorBuffer.data(); }
+    const float* depth() const { return depthBuffer.data(); }
+
+private:
+    // Depth, 1/w and the perspective-divided colour and texture coordinates
+    enum { kDepth, kInvW, kRed, kGreen, kBlue, kU, kV, kAttributes };
+
+    struct ClipVertex
+    {
+        float x, y, z, w;
+        float r, g, b;
+        float u, v;
+        int outside;                    // bit per clip plane the vertex is behind
+    };
+
+    // A vertex after the perspective divide, in pixels
+    struct ScreenVertex
+    {
+        float x, y;
+        float values[kAttributes];
+    };
+
+    struct RasterTriangle
+    {
+        float edge[3][3];               // A, B, C: inside where A x + B y + C >= 0 at pixel centres
+        float plane[kAttributes][3];    // value = A x + B y + C
+        int minX, minY, maxX, maxY;     // pixel bounds, inclusive
+        const RasterTexture* texture;
+        int level;
+    };
+
+    struct DrawCall
+    {
+        const RasterMesh* mesh = NULL;
+        Mat4 modelView;
+        RasterMaterial material;
+        const RasterTexture* texture = NULL;
+        std::vector<ClipVertex> vertices;
+        std::vector<ScreenVertex> screen;
+        std::vector<RasterTriangle> triangles;
+    };
+
+    void processDraw(DrawCall& call)
+    {
+        const RasterMesh& mesh = *call.mesh;
+        float determinant;
+        Mat3 normals = normalMatrix(call.modelView, &determinant);
+        Mat4 clip = projection * call.modelView;
+
+        // Vertices are shared by several triangles, so lighting and the
+        // perspective divide happen once per vertex
+        call.vertices.resize(mesh.positions.size());
+        call.screen.resize(mesh.positions.size());
+        for (size_t i = 0; i < mesh.positions.size(); ++i)
+        {
+            const Vec3& p = mesh.positions[i];
+            Vec3 color = lightVertex(light, call.material, transformPoint(call.modelView, p), normalize(normals * mesh.normals[i]));
+            ClipVertex& v = call.vertices[i];
+            v.x = clip.m[0] * p.x + clip.m[4] * p.y + clip.m[8] * p.z + clip.m[12];
+            v.y = clip.m[1] * p.x + clip.m[5] * p.y + clip.m[9] * p.z + clip.m[13];
+            v.z = clip.m[2] * p.x + clip.m[6] * p.y + clip.m[10] * p.z + clip.m[14];
+            v.w = clip.m[3] * p.x + clip.m[7] * p.y + clip.m[11] * p.z + clip.m[15];
+            v.r = color.x;
+            v.g = color.y;
+            v.b = color.z;
+            v.u = call.texture ? mesh.uvs[i * 2] : 0.0f;
+            v.v = call.texture ? mesh.uvs[i * 2 + 1] : 0.0f;
+            v.outside = 0;
+            for (int plane = 0; plane < 5; ++plane)
+                v.outside |= (clipDistance(v, plane) < 0.0f) << plane;
+            if (!v.outside)
+                call.screen[i] = project(v);
+        }
+
+        // A mirroring transform turns outward faces clockwise on screen
+        int culled = !mesh.closed ? 0 : determinant < 0.0f ? -1 : 1;
+        call.triangles.clear();
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            uint32_t a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+            int outside = call.vertices[a].outside | call.vertices[b].outside | call.vertices[c].outside;
+            if (call.vertices[a].outside & call.vertices[b].outside & call.vertices[c].outside)
+                continue;
+            if (outside)
+                clipTriangle(call, call.vertices[a], call.vertices[b], call.vertices[c], outside, culled);
+            else
+                setupTriangle(call, call.screen[a], call.screen[b], call.screen[c], culled);
+        }
+    }
+
+    static float clipDistance(const ClipVertex& v, int plane)
+    {
+        switch (plane)
+        {
+        case 0: return v.z + v.w;                   // near
+        case 1: return v.x + v.w * kGuardBand;      // left, right, bottom and top, with a guard band so
+        case 2: return v.w * kGuardBand - v.x;      // only triangles far off screen need clipping
+        case 3: return v.y + v.w * kGuardBand;
+        default: return v.w * kGuardBand - v.y;
+        }
+    }
+
+    ScreenVertex project(const ClipVertex& v) const
+    {
+        // Snapped to 1/16 pixel so shared edges rasterize the same from both sides
+        ScreenVertex s;
+        float iw = 1.0f / v.w;
+        s.x = std::floor((v.x * iw * 0.5f + 0.5f) * frameWidth * 16.0f + 0.5f) * (1.0f / 16.0f);
+        s.y = std::floor((v.y * iw * 0.5f + 0.5f) * frameHeight * 16.0f + 0.5f) * (1.0f / 16.0f);
+        s.values[kDepth] = v.z * iw * 0.5f + 0.5f;
+        s.values[kInvW] = iw;
+        s.values[kRed] = v.r * iw;
+        s.values[kGreen] = v.g * iw;
+        s.values[kBlue] = v.b * iw;
+        s.values[kU] = v.u * iw;
+        s.values[kV] = v.v * iw;
+        return s;
+    }
+
+    // Sutherland-Hodgman against each plane the triangle crosses
+    void clipTriangle(DrawCall& call, const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, int outside, int culled)
+    {
+        ClipVertex polygon[2][9];
+        int count = 3;
+        polygon[0][0] = a;
+        polygon[0][1] = b;
+        polygon[0][2] = c;
+        int current = 0;
+        for (int plane = 0; plane < 5 && count >= 3; ++plane)
+        {
+            if (!(outside & 1 << plane))
+                continue;
+            const ClipVertex* in = polygon[current];
+            ClipVertex* out = polygon[current ^ 1];
+            int outCount = 0;
+            for (int i = 0; i < count; ++i)
+            {
+                const ClipVertex& p = in[i];
+                const ClipVertex& q = in[(i + 1) % count];
+                float dp = clipDistance(p, plane), dq = clipDistance(q, plane);
+                if (dp >= 0.0f)
+                    out[outCount++] = p;
+                if ((dp >= 0.0f) != (dq >= 0.0f))
+                {
+                    float t = dp / (dp - dq);
+                    const float* fp = &p.x;
+                    const float* fq = &q.x;
+                    float* fo = &out[outCount++].x;
+                    for (int k = 0; k < 9; ++k)
+                        fo[k] = fp[k] + (fq[k] - fp[k]) * t;
+                }
+            }
+            count = outCount;
+            current ^= 1;
+        }
+        if (count < 3)
+            return;
+        ScreenVertex projected[9];
+        for (int i = 0; i < count; ++i)
+            projected[i] = project(polygon[current][i]);
+        for (int i = 1; i + 1 < count; ++i)
+            setupTriangle(call, projected[0], projected[i], projected[i + 1], culled);
+    }
+
+    void setupTriangle(DrawCall& call, const ScreenVertex& a, const ScreenVertex& b, const ScreenVertex& c, int culled)
+    {
+        // Counter-clockwise in window space is front facing
+        const ScreenVertex* v[3] = { &a, &b, &c };
+        float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+        if (area == 0.0f || area * culled < 0.0f)
+            return;
+        if (area < 0.0f)
+        {
+            std::swap(v[1], v[2]);
+            area = -area;
+        }
+
+        RasterTriangle t;
+        t.minX = std::max((int)std::floor(std::min(a.x, std::min(b.x, c.x))), 0);
+        t.minY = std::max((int)std::floor(std::min(a.y, std::min(b.y, c.y))), 0);
+        t.maxX = std::min((int)std::ceil(std::max(a.x, std::max(b.x, c.x))), frameWidth - 1);
+        t.maxY = std::min((int)std::ceil(std::max(a.y, std::max(b.y, c.y))), frameHeight - 1);
+        if (t.minX > t.maxX || t.minY > t.maxY)
+            return;
+
+        // Edge i runs between the two vertices other than i, so it's that vertex's barycentric weight times area
+        for (int i = 0; i < 3; ++i)
+        {
+            const ScreenVertex& j = *v[(i + 1) % 3];
+            const ScreenVertex& k = *v[(i + 2) % 3];
+            t.edge[i][0] = j.y - k.y;
+            t.edge[i][1] = k.x - j.x;
+            t.edge[i][2] = -(t.edge[i][0] * j.x + t.edge[i][1] * j.y);
+        }
+        float invArea = 1.0f / area;
+        int attributes = call.texture ? kAttributes : kU;
+        for (int k = 0; k < attributes; ++k)
+            for (int e = 0; e < 3; ++e)
+                t.plane[k][e] = (v[0]->values[k] * t.edge[0][e] + v[1]->values[k] * t.edge[1][e] + v[2]->values[k] * t.edge[2][e]) * invArea;
+
+        // One mip level per triangle, from GL's scale factor at its centroid:
+        // the longer of the texel footprints of a pixel step in x and in y
+        t.texture = call.texture;
+        t.level = 0;
+        if (t.texture)
+        {
+            const RasterTexture::Level& base = t.texture->levels[0];
+            float cx = (a.x + b.x + c.x) * (1.0f / 3.0f), cy = (a.y + b.y + c.y) * (1.0f / 3.0f);
+            float iw = t.plane[kInvW][0] * cx + t.plane[kInvW][1] * cy + t.plane[kInvW][2];
+            float u = (t.plane[kU][0] * cx + t.plane[kU][1] * cy + t.plane[kU][2]) / iw;
+            float w = (t.plane[kV][0] * cx + t.plane[kV][1] * cy + t.plane[kV][2]) / iw;
+            float dudx = (t.plane[kU][0] - u * t.plane[kInvW][0]) / iw * base.width;
+            float dvdx = (t.plane[kV][0] - w * t.plane[kInvW][0]) / iw * base.height;
+            float dudy = (t.plane[kU][1] - u * t.plane[kInvW][1]) / iw * base.width;
+            float dvdy = (t.plane[kV][1] - w * t.plane[kInvW][1]) / iw * base.height;
+            float rho2 = std::max(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy);
+            if (rho2 > 1.0f)
+                t.level = std::min((int)(0.5f * std::log2(rho2) + 0.5f), (int)t.texture->levels.size() - 1);
+        }
+        call.triangles.push_back(t);
+    }
+
+    void renderTile(int tile, uint32_t* tileColor, float* tileDepth)
+    {
+        int originX = tile % tilesX * kTileSize, originY = tile / tilesX * kTileSize;
+        int tileWidth = std::min(kTileSize, frameWidth - originX), tileHeight = std::min(kTileSize, frameHeight - originY);
+        std::fill(tileDepth, tileDepth + kTileSize * kTileSize, 1.0f);
+
+        for (const RasterTriangle* t : bins[tile])
+        {
+            // The span starts on a four pixel group; pixels outside the bounds fail the edge tests
+            int x0 = (std::max(t->minX, originX) - originX) & ~3;
+            int x1 = std::min(t->maxX, originX + tileWidth - 1) - originX;
+            int y0 = std::max(t->minY, originY) - originY;
+            int y1 = std::min(t->maxY, originY + tileHeight - 1) - originY;
+            for (int y = y0; y <= y1; ++y)
+                rasterizeRow(*t, originX, originY + y, x0, x1, tileColor + y * kTileSize, tileDepth + y * kTileSize);
+        }
+
+        for (int y = 0; y < tileHeight; ++y)
+        {
+            uint32_t* color = tileColor + y * kTileSize;
+            const float* depth = tileDepth + y * kTileSize;
+            fillSky(originX, originY + y, tileWidth, color, depth);
+            memcpy(&colorBuffer[(size_t)(originY + y) * frameWidth + originX], color, tileWidth * sizeof(uint32_t));
+            memcpy(&depthBuffer[(size_t)(originY + y) * frameWidth + originX], depth, tileWidth * sizeof(float));
+        }
+    }
+
+    // Depth tests and shades pixels [x0, x1] of one tile row, four at a time
+    void rasterizeRow(const RasterTriangle& t, int originX, int py, int x0, int x1, uint32_t* color, float* depth) const
+    {
+        float cy = py + 0.5f;
+        int x = x0;
+#ifdef ROBOT_SIMD_SSE
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), scale = _mm_set1_ps(255.0f);
+        const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        __m128 rowValue[3 + kAttributes], dx[3 + kAttributes];
+        for (int i = 0; i < 3; ++i)
+        {
+            rowValue[i] = _mm_set1_ps(t.edge[i][1] * cy + t.edge[i][2]);
+            dx[i] = _mm_set1_ps(t.edge[i][0]);
+        }
+        int attributes = t.texture ? kAttributes : kU;
+        for (int k = 0; k < attributes; ++k)
+        {
+            rowValue[3 + k] = _mm_set1_ps(t.plane[k][1] * cy + t.plane[k][2]);
+            dx[3 + k] = _mm_set1_ps(t.plane[k][0]);
+        }
+        for (; x <= x1; x += 4)
+        {
+            __m128 cx = _mm_add_ps(_mm_set1_ps((float)(originX + x)), offsets);
+            __m128 e0 = _mm_add_ps(rowValue[0], _mm_mul_ps(dx[0], cx));
+            __m128 e1 = _mm_add_ps(rowValue[1], _mm_mul_ps(dx[1], cx));
+            __m128 e2 = _mm_add_ps(rowValue[2], _mm_mul_ps(dx[2], cx));
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+            if (_mm_movemask_ps(inside) == 0)
+                continue;
+
+            __m128 z = _mm_add_ps(rowValue[3 + kDepth], _mm_mul_ps(dx[3 + kDepth], cx));
+            __m128 oldDepth = _mm_load_ps(depth + x);
+            __m128 mask = _mm_and_ps(inside, _mm_cmplt_ps(z, oldDepth));
+            int lanes = _mm_movemask_ps(mask);
+            if (lanes == 0)
+                continue;
+
+            __m128 w = _mm_div_ps(one, _mm_add_ps(rowValue[3 + kInvW], _mm_mul_ps(dx[3 + kInvW], cx)));
+            __m128 channel[3];
+            for (int c = 0; c < 3; ++c)
+                channel[c] = _mm_mul_ps(_mm_add_ps(rowValue[3 + kRed + c], _mm_mul_ps(dx[3 + kRed + c], cx)), w);
+
+            if (t.texture)
+            {
+                // Lanes outside the triangle sample texel 0 instead of extrapolated coordinates
+                __m128 u = _mm_and_ps(mask, _mm_mul_ps(_mm_add_ps(rowValue[3 + kU], _mm_mul_ps(dx[3 + kU], cx)), w));
+                __m128 v = _mm_and_ps(mask, _mm_mul_ps(_mm_add_ps(rowValue[3 + kV], _mm_mul_ps(dx[3 + kV], cx)), w));
+                __m128 texel[3];
+                t.texture->sample4(u, v, t.level, true, texel);
+                for (int c = 0; c < 3; ++c)
+                    channel[c] = _mm_mul_ps(channel[c], texel[c]);
+            }
+
+            __m128i packed = _mm_set1_epi32((int)0xff000000u);
+            for (int c = 0; c < 3; ++c)
+            {
+                __m128 clamped = _mm_min_ps(_mm_max_ps(channel[c], zero), one);
+                packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_cvtps_epi32(_mm_mul_ps(clamped, scale)), c * 8));
+            }
+            __m128i keep = _mm_castps_si128(mask);
+            __m128i oldColor = _mm_load_si128((const __m128i*)(color + x));
+            _mm_store_si128((__m128i*)(color + x), _mm_or_si128(_mm_and_si128(keep, packed), _mm_andnot_si128(keep, oldColor)));
+            _mm_store_ps(depth + x, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, oldDepth)));
+        }
+#endif
+        for (; x <= x1; ++x)
+        {
+            float cx = originX + x + 0.5f;
+            if (t.edge[0][0] * cx + t.edge[0][1] * cy + t.edge[0][2] < 0.0f ||
+                t.edge[1][0] * cx + t.edge[1][1] * cy + t.edge[1][2] < 0.0f ||
+                t.edge[2][0] * cx + t.edge[2][1] * cy + t.edge[2][2] < 0.0f)
+                continue;
+            float value[kAttributes];
+            for (int k = 0; k < (t.texture ? kAttributes : kU); ++k)
+                value[k] = t.plane[k][0] * cx + t.plane[k][1] * cy + t.plane[k][2];
+            if (value[kDepth] >= depth[x])
+                continue;
+
+            float w = 1.0f / value[kInvW];
+            float rgba[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+            if (t.texture)
+                t.texture->sample(value[kU] * w, value[kV] * w, t.level, true, rgba);
+            float channel[3];
+            for (int c = 0; c < 3; ++c)
+                channel[c] = std::min(std::max(value[kRed + c] * w * rgba[c], 0.0f), 1.0f);
+            color[x] = packRgba(channel[0], channel[1], channel[2]);
+            depth[x] = value[kDepth];
+        }
+    }
+
+    // Fills the pixels of a tile row that no triangle covered
+    void fillSky(int originX, int py, int count, uint32_t* color, const float* depth) const
+    {
+        float ndcY = (py + 0.5f) * 2.0f / frameHeight - 1.0f;
+        Vec3 row = skyForward + skyUp * ndcY;
+        Vec3 step = skyRight * (2.0f / frameWidth);
+        Vec3 start = row + skyRight * ((originX + 0.5f) * 2.0f / frameWidth - 1.0f);
+        int x = 0;
+#ifdef ROBOT_SIMD_SSE
+        if (sky)
+        {
+            const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps(), scale = _mm_set1_ps(255.0f);
+            const __m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+            for (; x < count; x += 4)
+            {
+                __m128 mask = _mm_cmpge_ps(_mm_load_ps(depth + x), one);
+                if (_mm_movemask_ps(mask) == 0)
+                    continue;
+                __m128 offset = _mm_add_ps(_mm_set1_ps((float)x), lane);
+                __m128 rgb[3];
+                sky->sample4(_mm_add_ps(_mm_set1_ps(start.x), _mm_mul_ps(_mm_set1_ps(step.x), offset)),
+                             _mm_add_ps(_mm_set1_ps(start.y), _mm_mul_ps(_mm_set1_ps(step.y), offset)),
+                             _mm_add_ps(_mm_set1_ps(start.z), _mm_mul_ps(_mm_set1_ps(step.z), offset)), rgb);
+                __m128i packed = _mm_set1_epi32((int)0xff000000u);
+                for (int c = 0; c < 3; ++c)
+                    packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(rgb[c], zero), one), scale)), c * 8));
+                __m128i keep = _mm_castps_si128(mask);
+                __m128i old = _mm_load_si128((const __m128i*)(color + x));
+                _mm_store_si128((__m128i*)(color + x), _mm_or_si128(_mm_and_si128(keep, packed), _mm_andnot_si128(keep, old)));
+            }
+        }
+#endif
+        for (; x < count; ++x)
+        {
+            if (depth[x] < 1.0f)
+                continue;
+            if (!sky)
+            {
+                color[x] = clear;
+                continue;
+            }
+            float rgba[4];
+            sky->sample(start + step * (float)x, rgba);
+            color[x] = packRgba(rgba[0], rgba[1], rgba[2]);
+        }
+    }
+
+    static constexpr float kGuardBand = 4.0f;
+
+    int frameWidth = 0, frameHeight = 0;
+    int tilesX = 0, tilesY = 0;
+    Mat4 projection = mat4Identity();
+    RasterLight light;
+    uint32_t clear = 0xff000000u;
+    const RasterCubemap* sky = NULL;
+    Vec3 skyRight, skyUp, skyForward;
+
+    std::vector<DrawCall> draws;
+    size_t drawCount = 0;
+    std::vector<std::vector<const RasterTriangle*> > bins;
+    std::vector<int> tileOrder;
+    size_t triangles = 0;
+    std::vector<uint32_t> colorBuffer;
+    std::vector<float> depthBuffer;
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+// Lock-free state exchange between the simulation thread and the render
+// thread. TripleBuffer hands a whole state from one producer to one
+// consumer: the producer always has a slot of its own to fill, the
+// consumer always reads a complete one, and neither ever waits for the
+// other. StateEdits carries changes the other way, for state the panel
+// edits in place: it diffs the consumer's copy word by word, and replays
+// the changed words over newer states until the producer confirms it has
+// applied them, so an edit neither flickers back nor gets lost.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+template <typename T>
+class TripleBuffer
+{
+public:
+    static_assert(std::is_trivially_copyable<T>::value, "TripleBuffer slots are overwritten wholesale");
+
+    // Producer: the slot being filled. It holds an older state, not the last
+    // published one, so fill all of it before publish().
+    T& back() { return slots[backIndex].value; }
+
+    // Producer: makes back() the newest state and takes another slot
+    void publish()
+    {
+        backIndex = middle.exchange(backIndex | kFresh, std::memory_order_acq_rel) & kIndexMask;
+    }
+
+    // Consumer: switches front() to the newest published state, if there's
+    // one it hasn't seen. States published in between are skipped.
+    bool update()
+    {
+        if (!(middle.load(std::memory_order_acquire) & kFresh))
+            return false;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & kIndexMask;
+        return true;
+    }
+
+    const T& front() const { return slots[frontIndex].value; }
+
+private:
+    static constexpr unsigned kIndexMask = 3, kFresh = 4;
+
+    // A cache line each, so the two threads never share one
+    struct alignas(64) Slot
+    {
+        T value;
+    };
+
+    Slot slots[3];
+    alignas(64) std::atomic<unsigned> middle{ 1 };
+    unsigned backIndex = 0;
+    alignas(64) unsigned frontIndex = 2;
+};
+
+// Word-granular edits to a T, tagged with serial numbers. The consumer
+// records what it changed, sends message() to the producer through another
+// TripleBuffer, and overlays the edits the producer hasn't confirmed yet on
+// every state it receives. Words are 4 bytes, so a float is always taken
+// whole from one side.
+template <typename T>
+class StateEdits
+{
+public:
+    static_assert(std::is_trivially_copyable<T>::value && sizeof(T) % 4 == 0, "StateEdits diffs T as 32-bit words");
+    static constexpr size_t kWords = sizeof(T) / 4;
+
+    struct Message
+    {
+        T values;
+        uint8_t edited[kWords];
+        uint64_t serial = 0;
+    };
+
+    // Consumer: replays unconfirmed edits over a freshly received state.
+    // applied is the last serial the producer has folded into it.
+    void overlay(T& state, uint64_t applied)
+    {
+        confirmed = applied;
+        for (size_t i = 0; i < kWords; ++i)
+            if (wordSerials[i] > confirmed)
+                copyWord(&state, &edits, i);
+    }
+
+    // Consumer: records the words that differ between base and edited as a
+    // new edit. True if there were any.
+    bool record(const T& base, const T& edited)
+    {
+        const unsigned char* before = reinterpret_cast<const unsigned char*>(&base);
+        const unsigned char* after = reinterpret_cast<const unsigned char*>(&edited);
+        bool changed = false;
+        for (size_t i = 0; i < kWords; ++i)
+            if (memcmp(before + i * 4, after + i * 4, 4) != 0)
+            {
+                if (!changed)
+                    ++serial;
+                changed = true;
+                copyWord(&edits, &edited, i);
+                wordSerials[i] = serial;
+            }
+        return changed;
+    }
+
+    // Consumer: every unconfirmed edit, for the producer
+    void message(Message& out) const
+    {
+        memcpy(&out.values, &edits, sizeof(T));
+        for (size_t i = 0; i < kWords; ++i)
+            out.edited[i] = wordSerials[i] > confirmed;
+        out.serial = serial;
+    }
+
+    // Producer: applies a message newer than applied and moves applied up.
+    // True if it changed anything.
+    static bool apply(const Message& message, T& state, uint64_t& applied)
+    {
+        if (message.serial <= applied)
+            return false;
+        for (size_t i = 0; i < kWords; ++i)
+            if (message.edited[i])
+                copyWord(&state, &message.values, i);
+        applied = message.serial;
+        return true;
+    }
+
+    bool pending() const { return serial > confirmed; }
+
+private:
+    static void copyWord(T* to, const T* from, size_t i)
+    {
+        memcpy(reinterpret_cast<unsigned char*>(to) + i * 4, reinterpret_cast<const unsigned char*>(from) + i * 4, 4);
+    }
+
+    T edits;
+    uint64_t wordSerials[kWords] = {};
+    uint64_t serial = 0, confirmed = 0;
+};
@@ -0,0 +1,766 @@
+#pragma once
+
+// Heightfield terrain for outdoor sites kilometres across. A heightmap is
+// converted once into a terrain file: 16-bit heights cut into square
+// chunks, each chunk's samples stored together with its border row and
+// column repeated, so a chunk is one contiguous run of the file and can be
+// paged in and out on its own. The file is memory-mapped; chunks near the
+// eye are built into meshes on the shared JobSystem and dropped again,
+// pages and all, once the eye has moved on. Every chunk is drawn at a
+// geomipmap level picked from its distance, neighbours are kept at most one
+// level apart, and an edge next to a coarser neighbour skips its odd
+// vertices so the seam has no cracks. height() is a bilinear lookup straight
+// from the mapping, cheap enough for every foot on every tick. No GL in here.
+//
+// Layout: TerrainFileHeader, chunksX * chunksZ height ranges (two floats,
+// metres), then from kTerrainTileAlign on the chunks' tiles row by row, each
+// (chunkSize + 1)^2 uint16 samples.
+
+#include "JobSystem.h"
+#include "RasterMeshes.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct TerrainFileHeader
+{
+    char magic[4];                      // "TRN1"
+    int32_t chunkSize;                  // quads along a chunk's side, a power of two
+    int32_t chunksX, chunksZ;
+    float spacing;                      // metres between samples
+    float heightScale, heightOffset;    // metres = heightOffset + heightScale * sample
+    float originX, originZ;             // world position of sample (0, 0)
+    uint32_t reserved;
+    uint64_t signature;                 // of the heightmap it was made from
+};
+
+const size_t kTerrainTileAlign = 4096;
+
+// Edges of a chunk, for TerrainChunk::seams
+enum TerrainEdge
+{
+    TERRAIN_EDGE_MIN_X = 1,
+    TERRAIN_EDGE_MAX_X = 2,
+    TERRAIN_EDGE_MIN_Z = 4,
+    TERRAIN_EDGE_MAX_Z = 8
+};
+
+struct TerrainChunk
+{
+    enum State
+    {
+        UNLOADED,
+        BUILDING,       // a job is filling mesh
+        READY
+    };
+
+    std::atomic<int> state{ UNLOADED };
+    RasterMesh mesh;            // world space; see Terrain::prepareMesh() for indices
+    Aabb bounds;                // known before the chunk is loaded
+    int lod = -1;               // each level doubles the step between vertices; -1 until placed by update()
+    unsigned seams = 0;         // edges next to a coarser chunk
+    unsigned generation = 0;    // bumped by every build, so a renderer can tell a new mesh
+    int meshIndices = -1;       // lod * 16 + seams mesh.indices holds
+};
+
+// The six planes of a clip-space frustum, from a column-major matrix taking
+// world space to clip space; points inside have a.x + b.y + c.z + d >= 0
+inline void frustumPlanes(const float* m, float planes[6][4])
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        int row = i / 2;
+        float sign = i % 2 ? -1.0f : 1.0f;
+        for (int c = 0; c < 4; ++c)
+            planes[i][c] = m[c * 4 + 3] + sign * m[c * 4 + row];
+    }
+}
+
+// False if box is entirely outside one of the planes
+inline bool insidePlanes(const Aabb& box, const float (*planes)[4], int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        const float* p = planes[i];
+        // The corner farthest along the plane's normal
+        float x = p[0] >= 0.0f ? box.max.x : box.min.x;
+        float y = p[1] >= 0.0f ? box.max.y : box.min.y;
+        float z = p[2] >= 0.0f ? box.max.z : box.min.z;
+        if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+class Terrain
+{
+public:
+    float loadRadius = 512.0f;          // chunks closer than this to the eye are streamed in
+    float unloadFactor = 1.25f;         // and dropped beyond this multiple of it
+    float lodDistance = 40.0f;          // level 1 starts this far out, each further level twice as far
+    int maxBuildsPerUpdate = 16;        // nearest first
+
+    Terrain() {}
+    ~Terrain() { close(); }
+
+    Terrain(const Terrain&) = delete;
+    Terrain& operator=(const Terrain&) = delete;
+
+    // Converts depth rows of width heights in metres into a terrain file.
+    // The map is cropped to whole chunks, centred on the world origin and
+    // raised or lowered so the ground there is at centreHeight.
+    static bool write(const char* path, const float* heights, int width, int depth, float spacing,
+                      float centreHeight, uint64_t signature, int chunkSize = 64)
+    {
+        while (chunkSize > 1 && (chunkSize >= width || chunkSize >= depth))
+            chunkSize /= 2;
+        int chunksX = (width - 1) / chunkSize, chunksZ = (depth - 1) / chunkSize;
+        if (chunksX < 1 || chunksZ < 1 || spacing <= 0.0f)
+            return false;
+
+        int samplesX = chunksX * chunkSize + 1, samplesZ = chunksZ * chunkSize + 1;
+        float shift = centreHeight - heights[(size_t)(samplesZ / 2) * width + samplesX / 2];
+        float low = FLT_MAX, high = -FLT_MAX;
+        for (int z = 0; z < samplesZ; ++z)
+            for (int x = 0; x < samplesX; ++x)
+            {
+                low = std::min(low, heights[(size_t)z * width + x]);
+                high = std::max(high, heights[(size_t)z * width + x]);
+            }
+
+        TerrainFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "TRN1", 4);
+        header.chunkSize = chunkSize;
+        header.chunksX = chunksX;
+        header.chunksZ = chunksZ;
+        header.spacing = spacing;
+        header.heightScale = high > low ? (high - low) / 65535.0f : 1.0f;
+        header.heightOffset = low + shift;
+        header.originX = -0.5f * (samplesX - 1) * spacing;
+        header.originZ = -0.5f * (samplesZ - 1) * spacing;
+        header.signature = signature;
+
+        int row = chunkSize + 1;
+        std::vector<float> ranges((size_t)chunksX * chunksZ * 2);
+        std::vector<uint16_t> tiles((size_t)chunksX * chunksZ * row * row);
+        for (int cz = 0; cz < chunksZ; ++cz)
+            for (int cx = 0; cx < chunksX; ++cx)
+            {
+                size_t index = (size_t)cz * chunksX + cx;
+                uint16_t* tile = &tiles[index * row * row];
+                uint16_t lowSample = 65535, highSample = 0;
+                for (int j = 0; j < row; ++j)
+                    for (int i = 0; i < row; ++i)
+                    {
+                        float h = heights[(size_t)(cz * chunkSize + j) * width + cx * chunkSize + i];
+                        uint16_t sample = (uint16_t)std::min(std::max((h - low) / header.heightScale + 0.5f, 0.0f), 65535.0f);
+                        tile[j * row + i] = sample;
+                        lowSample = std::min(lowSample, sample);
+                        highSample = std::max(highSample, sample);
+                    }
+                ranges[index * 2] = header.heightOffset + header.heightScale * lowSample;
+                ranges[index * 2 + 1] = header.heightOffset + header.heightScale * highSample;
+            }
+
+        FILE* file = fopen(path, "wb");
+        if (!file)
+            return false;
+        size_t head = sizeof(header) + ranges.size() * sizeof(float);
+        std::vector<char> padding(tileOffset(chunksX, chunksZ) - head, 0);
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(ranges.data(), sizeof(float), ranges.size(), file) == ranges.size() &&
+            fwrite(padding.data(), 1, padding.size(), file) == padding.size() &&
+            fwrite(tiles.data(), sizeof(uint16_t), tiles.size(), file) == tiles.size();
+        return fclose(file) == 0 && ok;
+    }
+
+    bool open(const char* path)
+    {
+        close();
+        size_t size = 0;
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER length;
+        if (GetFileSizeEx(file, &length))
+            size = (size_t)length.QuadPart;
+        mapping = size ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+        CloseHandle(file);
+        if (mapping == NULL)
+            return false;
+        data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (data == NULL)
+        {
+            CloseHandle(mapping);
+            mapping = NULL;
+            return false;
+        }
+#else
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) == 0)
+            size = (size_t)info.st_size;
+        void* mapped = size ? mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+        data = (const uint8_t*)mapped;
+        // Nothing is read ahead; chunks are paged in as they're built
+        madvise(mapped, size, MADV_RANDOM);
+#endif
+        bytes = size;
+
+        if (bytes < sizeof(TerrainFileHeader))
+        {
+            close();
+            return false;
+        }
+        memcpy(&header, data, sizeof(header));
+        int cs = header.chunkSize;
+        if (memcmp(header.magic, "TRN1", 4) != 0 || cs < 1 || (cs & (cs - 1)) != 0 || header.chunksX < 1 || header.chunksZ < 1 ||
+            bytes < tileOffset(header.chunksX, header.chunksZ) + (size_t)header.chunksX * header.chunksZ * tileBytes())
+        {
+            close();
+            return false;
+        }
+
+        levels = 1;
+        while ((cs >> (levels - 1)) > 1)
+            ++levels;
+        buildIndexLists();
+
+        int count = chunkCount();
+        chunks.reset(new TerrainChunk[count]);
+        const float* ranges = (const float*)(data + sizeof(TerrainFileHeader));
+        float width = cs * header.spacing;
+        for (int i = 0; i < count; ++i)
+        {
+            float x = header.originX + (i % header.chunksX) * width, z = header.originZ + (i / header.chunksX) * width;
+            chunks[i].bounds.min = vec3(x, ranges[i * 2], z);
+            chunks[i].bounds.max = vec3(x + width, ranges[i * 2 + 1], z + width);
+        }
+        placedLevels.assign(count, -1);
+        return true;
+    }
+
+    // Waits for chunks being built, then unmaps the file
+    void close()
+    {
+        finishBuilds();
+        chunks.reset();
+        active.clear();
+        placedLevels.clear();
+        lists.clear();
+        if (data == NULL)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+        CloseHandle(mapping);
+        mapping = NULL;
+#else
+        munmap((void*)data, bytes);
+#endif
+        data = NULL;
+        bytes = 0;
+    }
+
+    bool isOpen() const { return data != NULL; }
+    uint64_t signature() const { return header.signature; }
+    int chunkSize() const { return header.chunkSize; }
+    int chunksX() const { return header.chunksX; }
+    int chunksZ() const { return header.chunksZ; }
+    int chunkCount() const { return header.chunksX * header.chunksZ; }
+    int levelCount() const { return levels; }
+    TerrainChunk& chunk(int index) { return chunks[index]; }
+    const TerrainChunk& chunk(int index) const { return chunks[index]; }
+
+    // The whole terrain
+    Aabb bounds() const
+    {
+        Aabb box = chunks[0].bounds;
+        for (int i = 1; i < chunkCount(); ++i)
+            box = merge(box, chunks[i].bounds);
+        return box;
+    }
+
+    // Ground height at (x, z), bilinear between the four samples around it.
+    // Outside the terrain the nearest edge carries on. Safe from any thread.
+    float height(float x, float z) const
+    {
+        int cs = header.chunkSize;
+        float fx = std::min(std::max((x - header.originX) / header.spacing, 0.0f), (float)(header.chunksX * cs));
+        float fz = std::min(std::max((z - header.originZ) / header.spacing, 0.0f), (float)(header.chunksZ * cs));
+        int cx = std::min((int)fx / cs, header.chunksX - 1), cz = std::min((int)fz / cs, header.chunksZ - 1);
+        float lx = fx - cx * cs, lz = fz - cz * cs;
+        int ix = std::min((int)lx, cs - 1), iz = std::min((int)lz, cs - 1);
+        float tx = lx - ix, tz = lz - iz;
+        const uint16_t* s = tile(cx, cz) + iz * (cs + 1) + ix;
+        float h0 = s[0] + (s[1] - (float)s[0]) * tx;
+        float h1 = s[cs + 1] + (s[cs + 2] - (float)s[cs + 1]) * tx;
+        return header.heightOffset + header.heightScale * (h0 + (h1 - h0) * tz);
+    }
+
+    // Lowest and highest ground over a rectangle, from the chunks' ranges
+    void heightRange(float minX, float minZ, float maxX, float maxZ, float& low, float& high) const
+    {
+        low = FLT_MAX;
+        high = -FLT_MAX;
+        int x0, z0, x1, z1;
+        chunkRange(minX, minZ, maxX, maxZ, x0, z0, x1, z1);
+        for (int cz = z0; cz <= z1; ++cz)
+            for (int cx = x0; cx <= x1; ++cx)
+            {
+                const Aabb& box = chunks[cz * header.chunksX + cx].bounds;
+                low = std::min(low, box.min.y);
+                high = std::max(high, box.max.y);
+            }
+    }
+
+    // The ground over a rectangle, read straight from the map however much of
+    // it is streamed in, e.g. for a bake. Samples are skipped to keep at most
+    // maxCells quads along a side. Empty off the map; safe from any thread.
+    void groundMesh(float minX, float minZ, float maxX, float maxZ, int maxCells, RasterMesh& mesh) const
+    {
+        mesh = RasterMesh();
+        int cs = header.chunkSize;
+        int gx0 = std::max((int)std::floor((minX - header.originX) / header.spacing), 0);
+        int gz0 = std::max((int)std::floor((minZ - header.originZ) / header.spacing), 0);
+        int gx1 = std::min((int)std::ceil((maxX - header.originX) / header.spacing), header.chunksX * cs);
+        int gz1 = std::min((int)std::ceil((maxZ - header.originZ) / header.spacing), header.chunksZ * cs);
+        if (gx1 <= gx0 || gz1 <= gz0 || maxCells < 1)
+            return;
+        int stride = std::max((std::max(gx1 - gx0, gz1 - gz0) + maxCells - 1) / maxCells, 1);
+        int nx = (gx1 - gx0 + stride - 1) / stride, nz = (gz1 - gz0 + stride - 1) / stride;
+
+        mesh.positions.resize((size_t)(nx + 1) * (nz + 1));
+        mesh.normals.resize(mesh.positions.size());
+        mesh.uvs.resize(mesh.positions.size() * 2);
+        for (int j = 0; j <= nz; ++j)
+            for (int i = 0; i <= nx; ++i)
+            {
+                int gx = std::min(gx0 + i * stride, gx1), gz = std::min(gz0 + j * stride, gz1);
+                size_t v = (size_t)j * (nx + 1) + i;
+                float x = header.originX + gx * header.spacing, z = header.originZ + gz * header.spacing;
+                mesh.positions[v] = vec3(x, sampleHeight(gx, gz), z);
+                float dx = sampleHeight(gx + stride, gz) - sampleHeight(gx - stride, gz);
+                float dz = sampleHeight(gx, gz + stride) - sampleHeight(gx, gz - stride);
+                mesh.normals[v] = normalize(vec3(-dx, 2.0f * stride * header.spacing, -dz));
+                mesh.uvs[v * 2] = x;
+                mesh.uvs[v * 2 + 1] = z;
+            }
+
+        // Two triangles a quad, wound to face up like the chunks'
+        mesh.indices.reserve((size_t)nx * nz * 6);
+        for (int j = 0; j < nz; ++j)
+            for (int i = 0; i < nx; ++i)
+            {
+                uint32_t v00 = (uint32_t)(j * (nx + 1) + i), v10 = v00 + 1;
+                uint32_t v01 = v00 + (uint32_t)(nx + 1), v11 = v01 + 1;
+                uint32_t quad[6] = { v00, v11, v10, v00, v01, v11 };
+                mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+            }
+    }
+
+    // Streams chunks in and out around eye and places every loaded one at a
+    // level. Call it from one thread, before anything reads lod or seams.
+    void update(const Vec3& eye)
+    {
+        if (!isOpen())
+            return;
+
+        // Drop what the eye has left behind. Chunks still building go once
+        // they're done.
+        float unloadRadius = loadRadius * unloadFactor;
+        size_t kept = 0;
+        for (int index : active)
+        {
+            TerrainChunk& c = chunks[index];
+            if (c.state.load(std::memory_order_acquire) == TerrainChunk::READY && distance(c.bounds, eye) > unloadRadius)
+                release(index);
+            else
+                active[kept++] = index;
+        }
+        active.resize(kept);
+
+        // Start building the nearest missing chunks
+        candidates.clear();
+        int x0, z0, x1, z1;
+        chunkRange(eye.x - loadRadius, eye.z - loadRadius, eye.x + loadRadius, eye.z + loadRadius, x0, z0, x1, z1);
+        for (int cz = z0; cz <= z1; ++cz)
+            for (int cx = x0; cx <= x1; ++cx)
+            {
+                int index = cz * header.chunksX + cx;
+                float d = distance(chunks[index].bounds, eye);
+                if (d <= loadRadius && chunks[index].state.load(std::memory_order_acquire) == TerrainChunk::UNLOADED)
+                    candidates.push_back(std::make_pair(d, index));
+            }
+        size_t starts = std::min(candidates.size(), (size_t)std::max(maxBuildsPerUpdate, 0));
+        std::partial_sort(candidates.begin(), candidates.begin() + starts, candidates.end());
+        for (size_t i = 0; i < starts; ++i)
+        {
+            int index = candidates[i].second;
+            chunks[index].state.store(TerrainChunk::BUILDING, std::memory_order_relaxed);
+            active.push_back(index);
+            JobSystem::shared().run([this, index]() { buildChunk(index); }, &building);
+        }
+
+        // Levels from distance, then lowered until no two neighbours are
+        // more than one apart
+        for (int index : active)
+        {
+            TerrainChunk& c = chunks[index];
+            bool ready = c.state.load(std::memory_order_acquire) == TerrainChunk::READY;
+            placedLevels[index] = ready ? (int8_t)levelAt(distance(c.bounds, eye)) : -1;
+        }
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            for (int index : active)
+            {
+                int level = placedLevels[index];
+                if (level < 0)
+                    continue;
+                for (int edge = 0; edge < 4; ++edge)
+                {
+                    int n = neighbour(index, edge);
+                    if (n >= 0 && placedLevels[n] >= 0 && level > placedLevels[n] + 1)
+                        level = placedLevels[n] + 1;
+                }
+                if (level != placedLevels[index])
+                {
+                    placedLevels[index] = (int8_t)level;
+                    changed = true;
+                }
+            }
+        }
+        for (int index : active)
+        {
+            TerrainChunk& c = chunks[index];
+            c.lod = placedLevels[index];
+            c.seams = 0;
+            for (int edge = 0; c.lod >= 0 && edge < 4; ++edge)
+            {
+                int n = neighbour(index, edge);
+                if (n >= 0 && placedLevels[n] > c.lod)
+                    c.seams |= 1u << edge;
+            }
+        }
+    }
+
+    // Waits for every chunk update() has started building
+    void finishBuilds() { JobSystem::shared().wait(building); }
+
+    // Triangles of a chunk at level with seams stitched, indexing a built
+    // chunk's (chunkSize + 1)^2 vertices
+    const std::vector<uint32_t>& indices(int level, unsigned seams) const
+    {
+        return lists[std::min(std::max(level, 0), levels - 1) * 16 + (seams & 15)];
+    }
+
+    // Fills a placed chunk's mesh.indices for its current level and seams.
+    // False if the chunk isn't placed, i.e. not to be drawn this frame.
+    bool prepareMesh(TerrainChunk& c) const
+    {
+        if (c.lod < 0 || c.state.load(std::memory_order_acquire) != TerrainChunk::READY)
+            return false;
+        int key = c.lod * 16 + (int)c.seams;
+        if (c.meshIndices != key)
+        {
+            c.mesh.indices = indices(c.lod, c.seams);
+            c.meshIndices = key;
+        }
+        return true;
+    }
+
+    // Chunks that aren't UNLOADED, the only ones update() places
+    const std::vector<int>& activeChunks() const { return active; }
+
+    // Chunks loaded and still being built, for the panel
+    size_t residentChunks() const { return active.size(); }
+    size_t buildingChunks() const
+    {
+        size_t count = 0;
+        for (int index : active)
+            count += chunks[index].state.load(std::memory_order_relaxed) == TerrainChunk::BUILDING;
+        return count;
+    }
+
+private:
+    static size_t tileOffset(int chunksX, int chunksZ)
+    {
+        size_t head = sizeof(TerrainFileHeader) + (size_t)chunksX * chunksZ * 2 * sizeof(float);
+        return (head + kTerrainTileAlign - 1) / kTerrainTileAlign * kTerrainTileAlign;
+    }
+
+    size_t tileBytes() const
+    {
+        size_t row = (size_t)header.chunkSize + 1;
+        return row * row * sizeof(uint16_t);
+    }
+
+    const uint16_t* tile(int cx, int cz) const
+    {
+        size_t index = (size_t)cz * header.chunksX + cx;
+        return (const uint16_t*)(data + tileOffset(header.chunksX, header.chunksZ) + index * tileBytes());
+    }
+
+    // Sample (gx, gz) of the whole map in metres, clamped to its edges
+    float sampleHeight(int gx, int gz) const
+    {
+        int cs = header.chunkSize;
+        gx = std::min(std::max(gx, 0), header.chunksX * cs);
+        gz = std::min(std::max(gz, 0), header.chunksZ * cs);
+        int cx = std::min(gx / cs, header.chunksX - 1), cz = std::min(gz / cs, header.chunksZ - 1);
+        return header.heightOffset + header.heightScale * tile(cx, cz)[(gz - cz * cs) * (cs + 1) + gx - cx * cs];
+    }
+
+    // Chunks overlapping a rectangle, clamped to the terrain
+    void chunkRange(float minX, float minZ, float maxX, float maxZ, int& x0, int& z0, int& x1, int& z1) const
+    {
+        float width = header.chunkSize * header.spacing;
+        x0 = std::max((int)std::floor((minX - header.originX) / width), 0);
+        z0 = std::max((int)std::floor((minZ - header.originZ) / width), 0);
+        x1 = std::min((int)std::floor((maxX - header.originX) / width), header.chunksX - 1);
+        z1 = std::min((int)std::floor((maxZ - header.originZ) / width), header.chunksZ - 1);
+    }
+
+    // Horizontal distance from p to a chunk, 0 inside it
+    static float distance(const Aabb& box, const Vec3& p)
+    {
+        float dx = std::max(std::max(box.min.x - p.x, p.x - box.max.x), 0.0f);
+        float dz = std::max(std::max(box.min.z - p.z, p.z - box.max.z), 0.0f);
+        return std::sqrt(dx * dx + dz * dz);
+    }
+
+    int levelAt(float d) const
+    {
+        if (d < lodDistance)
+            return 0;
+        return std::min((int)std::log2(d / lodDistance) + 1, levels - 1);
+    }
+
+    // The chunk across an edge (bit index of TerrainEdge), -1 off the map
+    int neighbour(int index, int edge) const
+    {
+        int cx = index % header.chunksX, cz = index / header.chunksX;
+        static const int offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+        cx += offsets[edge][0];
+        cz += offsets[edge][1];
+        if (cx < 0 || cz < 0 || cx >= header.chunksX || cz >= header.chunksZ)
+            return -1;
+        return cz * header.chunksX + cx;
+    }
+
+    // Pages a chunk's tile in ahead of a build, or lets the kernel drop it.
+    // Only pages entirely inside the range are dropped; the neighbours' share
+    // the rest.
+    void advise(size_t offset, size_t length, bool needed) const
+    {
+#ifndef _WIN32
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t begin = needed ? offset / page * page : (offset + page - 1) / page * page;
+        size_t end = needed ? std::min((offset + length + page - 1) / page * page, bytes) : (offset + length) / page * page;
+        if (end > begin)
+            madvise((void*)(data + begin), end - begin, needed ? MADV_WILLNEED : MADV_DONTNEED);
+#else
+        (void)offset;
+        (void)length;
+        (void)needed;
+#endif
+    }
+
+    void adviseChunk(int index, bool needed) const
+    {
+        advise(tileOffset(header.chunksX, header.chunksZ) + (size_t)index * tileBytes(), tileBytes(), needed);
+    }
+
+    // Runs as a job: positions, normals and texture coordinates of every
+    // sample of the chunk. Texture coordinates are world x and z, so the
+    // floor texture repeats every metre as it does on the flat floor.
+    void buildChunk(int index)
+    {
+        TerrainChunk& c = chunks[index];
+        adviseChunk(index, true);
+        int cs = header.chunkSize, row = cs + 1;
+        int gx0 = (index % header.chunksX) * cs, gz0 = (index / header.chunksX) * cs;
+        const uint16_t* samples = tile(gx0 / cs, gz0 / cs);
+        RasterMesh& mesh = c.mesh;
+        mesh.positions.resize((size_t)row * row);
+        mesh.normals.resize((size_t)row * row);
+        mesh.uvs.resize((size_t)row * row * 2);
+        for (int j = 0; j < row; ++j)
+            for (int i = 0; i < row; ++i)
+            {
+                int gx = gx0 + i, gz = gz0 + j;
+                size_t v = (size_t)j * row + i;
+                float x = header.originX + gx * header.spacing, z = header.originZ + gz * header.spacing;
+                mesh.positions[v] = vec3(x, header.heightOffset + header.heightScale * samples[v], z);
+                // Central differences, reaching into the neighbours at the border
+                float dx = sampleHeight(gx + 1, gz) - sampleHeight(gx - 1, gz);
+                float dz = sampleHeight(gx, gz + 1) - sampleHeight(gx, gz - 1);
+                mesh.normals[v] = normalize(vec3(-dx, 2.0f * header.spacing, -dz));
+                mesh.uvs[v * 2] = x;
+                mesh.uvs[v * 2 + 1] = z;
+            }
+        ++c.generation;
+        c.state.store(TerrainChunk::READY, std::memory_order_release);
+    }
+
+    void release(int index)
+    {
+        TerrainChunk& c = chunks[index];
+        c.mesh = RasterMesh();
+        c.meshIndices = -1;
+        c.lod = -1;
+        placedLevels[index] = -1;
+        adviseChunk(index, false);
+        c.state.store(TerrainChunk::UNLOADED, std::memory_order_release);
+    }
+
+    // Vertex (i, j) of level's grid, in the chunk's full-resolution vertices
+    uint32_t vertex(int level, int i, int j) const
+    {
+        return (uint32_t)(((size_t)j << level) * (header.chunkSize + 1) + ((size_t)i << level));
+    }
+
+    // Adds a triangle of level's grid, wound to face up
+    void addTriangle(std::vector<uint32_t>& list, int level, const int (&a)[2], const int (&b)[2], const int (&c)[2]) const
+    {
+        int cross = (b[1] - a[1]) * (c[0] - a[0]) - (b[0] - a[0]) * (c[1] - a[1]);
+        list.push_back(vertex(level, a[0], a[1]));
+        if (cross > 0)
+        {
+            list.push_back(vertex(level, b[0], b[1]));
+            list.push_back(vertex(level, c[0], c[1]));
+        }
+        else
+        {
+            list.push_back(vertex(level, c[0], c[1]));
+            list.push_back(vertex(level, b[0], b[1]));
+        }
+    }
+
+    // Every level's triangles for every combination of stitched edges. The
+    // interior is a regular grid; each edge is a strip from its outer row to
+    // the first inner one. A stitched strip fans each pair of outer quads
+    // from their even vertices, which is all the coarser neighbour has.
+    void buildIndexLists()
+    {
+        lists.assign((size_t)levels * 16, std::vector<uint32_t>());
+        for (int level = 0; level < levels; ++level)
+        {
+            int n = header.chunkSize >> level;
+            for (unsigned seams = 0; seams < 16; ++seams)
+            {
+                std::vector<uint32_t>& list = lists[level * 16 + seams];
+                if (n == 1)
+                {
+                    int corners[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+                    addTriangle(list, level, corners[0], corners[1], corners[2]);
+                    addTriangle(list, level, corners[0], corners[2], corners[3]);
+                    continue;
+                }
+                for (int j = 1; j < n - 1; ++j)
+                    for (int i = 1; i < n - 1; ++i)
+                    {
+                        int q[4][2] = { { i, j }, { i + 1, j }, { i + 1, j + 1 }, { i, j + 1 } };
+                        addTriangle(list, level, q[0], q[1], q[2]);
+                        addTriangle(list, level, q[0], q[2], q[3]);
+                    }
+                for (int edge = 0; edge < 4; ++edge)
+                    addEdgeStrip(list, level, n, edge, (seams >> edge & 1) != 0);
+            }
+        }
+    }
+
+    // One edge's strip. Along k and in by d it is laid out the same for
+    // every edge, turned to face it; outer vertices are O(k) = (k, 0), inner
+    // ones I(k) = (k, 1) for k in [1, n - 1].
+    void addEdgeStrip(std::vector<uint32_t>& list, int level, int n, int edge, bool stitched) const
+    {
+        auto at = [&](int k, int d, int (&out)[2])
+        {
+            switch (edge)
+            {
+            case 0: out[0] = d; out[1] = n - k; break;      // TERRAIN_EDGE_MIN_X
+            case 1: out[0] = n - d; out[1] = k; break;      // TERRAIN_EDGE_MAX_X
+            case 2: out[0] = k; out[1] = d; break;          // TERRAIN_EDGE_MIN_Z
+            default: out[0] = n - k; out[1] = n - d; break; // TERRAIN_EDGE_MAX_Z
+            }
+        };
+        int a[2], b[2], c[2];
+        if (!stitched)
+        {
+            for (int k = 0; k < n; ++k)
+            {
+                at(k, 0, a);
+                at(k + 1, 0, b);
+                at(std::min(k + 1, n - 1), 1, c);
+                addTriangle(list, level, a, b, c);
+                if (k >= 1 && k <= n - 2)
+                {
+                    at(k + 1, 1, b);
+                    at(k, 1, c);
+                    addTriangle(list, level, a, b, c);
+                }
+            }
+            return;
+        }
+        for (int k = 0; k + 2 <= n; k += 2)
+        {
+            at(k, 0, a);
+            at(k + 2, 0, b);
+            at(k + 1, 1, c);
+            addTriangle(list, level, a, b, c);
+            if (k >= 2)
+            {
+                at(k, 1, b);
+                addTriangle(list, level, a, c, b);
+            }
+            if (k + 2 <= n - 1)
+            {
+                at(k + 2, 0, a);
+                at(k + 2, 1, b);
+                addTriangle(list, level, a, b, c);
+            }
+        }
+    }
+
+    const uint8_t* data = NULL;
+    size_t bytes = 0;
+#ifdef _WIN32
+    HANDLE mapping = NULL;
+#endif
+    TerrainFileHeader header = {};
+    int levels = 0;
+    std::unique_ptr<TerrainChunk[]> chunks;
+    std::vector<std::vector<uint32_t>> lists;   // level * 16 + seams
+    std::vector<int> active;                    // chunks not UNLOADED
+    std::vector<int8_t> placedLevels;           // per chunk, -1 unless placed
+    std::vector<std::pair<float, int>> candidates;
+    JobCounter building;
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+// Draws a Terrain's chunks from GL buffers: a vertex buffer per loaded
+// chunk, uploaded a few a frame as their builds finish and deleted once the
+// terrain drops them, and one index buffer holding every level's triangle
+// lists, shared by all chunks. Chunks outside the given planes are skipped.
+
+#include <GL/glew.h>
+
+#include "Terrain.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class TerrainRenderer
+{
+public:
+    int maxUploadsPerFrame = 8;
+
+    // Drawn by every draw() since the last update(), for the panel
+    size_t drawnChunks = 0, drawnTriangles = 0;
+
+    // Frees the buffers of chunks the terrain dropped or rebuilt and uploads
+    // the newly built ones, nearest first as the terrain built them; once a
+    // frame, after Terrain::update()
+    void update(const Terrain& terrain)
+    {
+        drawnChunks = drawnTriangles = 0;
+        if (!terrain.isOpen())
+            return;
+        if (indexBuffer == 0)
+            uploadIndices(terrain);
+        if (buffers.size() != (size_t)terrain.chunkCount())
+        {
+            buffers.assign(terrain.chunkCount(), 0);
+            generations.assign(terrain.chunkCount(), 0);
+        }
+
+        size_t kept = 0;
+        for (int index : uploaded)
+        {
+            const TerrainChunk& chunk = terrain.chunk(index);
+            if (chunk.state.load(std::memory_order_acquire) != TerrainChunk::READY || chunk.generation != generations[index])
+            {
+                glDeleteBuffers(1, &buffers[index]);
+                buffers[index] = 0;
+            }
+            else
+                uploaded[kept++] = index;
+        }
+        uploaded.resize(kept);
+
+        int uploads = 0;
+        for (int index : terrain.activeChunks())
+        {
+            const TerrainChunk& chunk = terrain.chunk(index);
+            if (uploads == maxUploadsPerFrame)
+                break;
+            if (buffers[index] != 0 || chunk.state.load(std::memory_order_acquire) != TerrainChunk::READY)
+                continue;
+            const RasterMesh& mesh = chunk.mesh;
+            size_t vertexBytes = mesh.positions.size() * sizeof(Vec3);
+            glGenBuffers(1, &buffers[index]);
+            glBindBuffer(GL_ARRAY_BUFFER, buffers[index]);
+            glBufferData(GL_ARRAY_BUFFER, vertexBytes * 2 + mesh.uvs.size() * sizeof(float), NULL, GL_STATIC_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, vertexBytes, mesh.positions.data());
+            glBufferSubData(GL_ARRAY_BUFFER, vertexBytes, vertexBytes, mesh.normals.data());
+            glBufferSubData(GL_ARRAY_BUFFER, vertexBytes * 2, mesh.uvs.size() * sizeof(float), mesh.uvs.data());
+            generations[index] = chunk.generation;
+            uploaded.push_back(index);
+            ++uploads;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Draws the uploaded chunks the terrain placed, in world space, unless
+    // they're outside one of the planes. shaded adds normals and texture
+    // coordinates; without it only positions are sent, e.g. under texgen.
+    void draw(const Terrain& terrain, const float (*planes)[4], int planeCount, bool shaded)
+    {
+        if (indexBuffer == 0)
+            return;
+        glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        if (shaded)
+        {
+            glEnableClientState(GL_NORMAL_ARRAY);
+            glClientActiveTexture(GL_TEXTURE0);
+            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        for (int index : uploaded)
+        {
+            const TerrainChunk& chunk = terrain.chunk(index);
+            if (chunk.lod < 0 || !insidePlanes(chunk.bounds, planes, planeCount))
+                continue;
+            size_t vertexBytes = chunk.mesh.positions.size() * sizeof(Vec3);
+            glBindBuffer(GL_ARRAY_BUFFER, buffers[index]);
+            glVertexPointer(3, GL_FLOAT, sizeof(Vec3), (const void*)0);
+            if (shaded)
+            {
+                glNormalPointer(GL_FLOAT, sizeof(Vec3), (const void*)vertexBytes);
+                glTexCoordPointer(2, GL_FLOAT, 0, (const void*)(vertexBytes * 2));
+            }
+            int list = chunk.lod * 16 + (int)chunk.seams;
+            glDrawElements(GL_TRIANGLES, (GLsizei)listCounts[list], GL_UNSIGNED_INT, (const void*)(listOffsets[list] * sizeof(uint32_t)));
+            ++drawnChunks;
+            drawnTriangles += listCounts[list] / 3;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glPopClientAttrib();
+    }
+
+    void shutdown()
+    {
+        for (int index : uploaded)
+            glDeleteBuffers(1, &buffers[index]);
+        uploaded.clear();
+        buffers.clear();
+        generations.clear();
+        if (indexBuffer != 0)
+            glDeleteBuffers(1, &indexBuffer);
+        indexBuffer = 0;
+    }
+
+private:
+    void uploadIndices(const Terrain& terrain)
+    {
+        std::vector<uint32_t> indices;
+        int lists = terrain.levelCount() * 16;
+        listOffsets.resize(lists);
+        listCounts.resize(lists);
+        for (int i = 0; i < lists; ++i)
+        {
+            const std::vector<uint32_t>& list = terrain.indices(i / 16, (unsigned)i % 16);
+            listOffsets[i] = indices.size();
+            listCounts[i] = list.size();
+            indices.insert(indices.end(), list.begin(), list.end());
+        }
+        glGenBuffers(1, &indexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    GLuint indexBuffer = 0;
+    std::vector<size_t> listOffsets, listCounts;    // level * 16 + seams
+    std::vector<GLuint> buffers;                    // per chunk, 0 if not uploaded
+    std::vector<unsigned> generations;              // of the mesh each buffer holds
+    std::vector<int> uploaded;
+};
@@ -0,0 +1,179 @@
+#pragma once
+
+// Background Y4M video encoder.
+// The render thread hands over raw RGBA frames and never waits: frames are
+// copied into one of a fixed set of buffers and queued for a worker thread
+// that converts them to 4:2:0 YCbCr and writes them to disk. If every buffer
+// is still queued the frame is dropped and counted instead of stalling the
+// caller. No GL in here; FrameRecorder feeds it from pixel buffer objects.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Converts a bottom-up RGBA image (as glReadPixels returns it) to top-down
+// planar I420 with BT.601 studio-range coefficients. width and height must be
+// even; stride is the source row length in bytes.
+inline void rgbaToI420(const uint8_t* rgba, int width, int height, size_t stride, uint8_t* yPlane, uint8_t* uPlane, uint8_t* vPlane)
+{
+    for (int y = 0; y < height; y += 2)
+    {
+        const uint8_t* row0 = rgba + (size_t)(height - 1 - y) * stride;
+        const uint8_t* row1 = row0 - stride;
+        uint8_t* y0 = yPlane + (size_t)y * width;
+        uint8_t* y1 = y0 + width;
+        uint8_t* u = uPlane + (size_t)(y / 2) * (width / 2);
+        uint8_t* v = vPlane + (size_t)(y / 2) * (width / 2);
+
+        for (int x = 0; x < width; x += 2)
+        {
+            const uint8_t* p[4] = { row0 + x * 4, row0 + x * 4 + 4, row1 + x * 4, row1 + x * 4 + 4 };
+            int r = 0, g = 0, b = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                int luma = ((66 * p[i][0] + 129 * p[i][1] + 25 * p[i][2] + 128) >> 8) + 16;
+                (i < 2 ? y0 : y1)[x + (i & 1)] = (uint8_t)luma;
+                r += p[i][0];
+                g += p[i][1];
+                b += p[i][2];
+            }
+            r = (r + 2) >> 2;
+            g = (g + 2) >> 2;
+            b = (b + 2) >> 2;
+            u[x / 2] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            v[x / 2] = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+}
+
+class VideoEncoder
+{
+public:
+    ~VideoEncoder() { close(); }
+
+    // Starts the encoder thread and writes the stream header. The frame rate
+    // is rateNumerator / rateDenominator. Odd frame sizes are cropped by a
+    // pixel since 4:2:0 needs even dimensions.
+    bool open(const char* path, int frameWidth, int frameHeight, int rateNumerator, int rateDenominator, int bufferCount = 8)
+    {
+        close();
+        file = fopen(path, "wb");
+        if (file == NULL)
+            return false;
+
+        sourceWidth = frameWidth;
+        sourceHeight = frameHeight;
+        width = frameWidth & ~1;
+        height = frameHeight & ~1;
+        fprintf(file, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C420jpeg\n", width, height, rateNumerator, rateDenominator);
+
+        buffers.assign(bufferCount, std::vector<uint8_t>((size_t)sourceWidth * sourceHeight * 4));
+        freeBuffers.clear();
+        for (int i = 0; i < bufferCount; ++i)
+            freeBuffers.push_back(i);
+        queued.clear();
+        framesWritten = 0;
+        framesDropped = 0;
+        quit = false;
+        worker = std::thread(&VideoEncoder::encodeLoop, this);
+        return true;
+    }
+
+    // Drains the queue, then stops the thread and closes the file
+    void close()
+    {
+        if (file == NULL)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_one();
+        worker.join();
+        fclose(file);
+        file = NULL;
+    }
+
+    bool isOpen() const { return file != NULL; }
+
+    // Copies a bottom-up RGBA frame of the size passed to open() into a free
+    // buffer and queues it. Returns false, without waiting, if none is free.
+    bool submit(const uint8_t* rgba)
+    {
+        int index;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (freeBuffers.empty())
+            {
+                ++framesDropped;
+                return false;
+            }
+            index = freeBuffers.back();
+            freeBuffers.pop_back();
+        }
+
+        std::memcpy(buffers[index].data(), rgba, buffers[index].size());
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued.push_back(index);
+        }
+        wake.notify_one();
+        return true;
+    }
+
+    int width = 0, height = 0;
+    std::atomic<uint64_t> framesWritten{ 0 };
+    std::atomic<uint64_t> framesDropped{ 0 };
+
+private:
+    void encodeLoop()
+    {
+        std::vector<uint8_t> planes((size_t)width * height * 3 / 2);
+        uint8_t* yPlane = planes.data();
+        uint8_t* uPlane = yPlane + (size_t)width * height;
+        uint8_t* vPlane = uPlane + (size_t)width * height / 4;
+
+        for (;;)
+        {
+            int index;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return quit || !queued.empty(); });
+                if (queued.empty())
+                    return;
+                index = queued.front();
+                queued.pop_front();
+            }
+
+            // Skip the odd bottom row, if any, so the crop comes off the bottom
+            const uint8_t* rgba = buffers[index].data() + (size_t)(sourceHeight - height) * sourceWidth * 4;
+            rgbaToI420(rgba, width, height, (size_t)sourceWidth * 4, yPlane, uPlane, vPlane);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                freeBuffers.push_back(index);
+            }
+
+            fputs("FRAME\n", file);
+            fwrite(planes.data(), 1, planes.size(), file);
+            ++framesWritten;
+        }
+    }
+
+    FILE* file = NULL;
+    int sourceWidth = 0, sourceHeight = 0;
+    std::vector<std::vector<uint8_t>> buffers;
+    std::vector<int> freeBuffers;
+    std::deque<int> queued;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool quit = false;
+    std::thread worker;
+};